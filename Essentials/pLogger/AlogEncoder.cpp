@@ -0,0 +1,209 @@
+/*
+ *  AlogEncoder.cpp
+ *  MOOS
+ *
+ */
+
+#include "AlogEncoder.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+//how much room to leave for a typical batch of mail
+#define ENCODER_INITIAL_RESERVE (64*1024)
+
+//largest precision handled without snprintf
+#define MAX_FAST_PRECISION 9
+
+//scaled values must be exactly representable as integers
+#define MAX_FAST_SCALED 4503599627370496.0 /* 2^52 */
+
+static const double POWERS_OF_TEN[MAX_FAST_PRECISION+1] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+
+CAlogEncoder::CAlogEncoder()
+{
+	m_Buffer.reserve(ENCODER_INITIAL_RESERVE);
+}
+
+void CAlogEncoder::Clear()
+{
+	m_Buffer.clear();
+}
+
+const std::string & CAlogEncoder::GetBuffer() const
+{
+	return m_Buffer;
+}
+
+size_t CAlogEncoder::Size() const
+{
+	return m_Buffer.size();
+}
+
+void CAlogEncoder::Append(const std::string & sStr)
+{
+	m_Buffer.append(sStr);
+}
+
+void CAlogEncoder::Append(const char * sStr)
+{
+	m_Buffer.append(sStr);
+}
+
+void CAlogEncoder::Append(const char * pData, size_t nBytes)
+{
+	m_Buffer.append(pData, nBytes);
+}
+
+void CAlogEncoder::Append(char c)
+{
+	m_Buffer.push_back(c);
+}
+
+void CAlogEncoder::AppendPadded(const std::string & sStr, int nWidth)
+{
+	size_t nStart = m_Buffer.size();
+	m_Buffer.append(sStr);
+	PadFrom(nStart, nWidth);
+}
+
+void CAlogEncoder::PadFrom(size_t nStart, int nWidth)
+{
+	size_t nUsed = m_Buffer.size()-nStart;
+	if(nWidth>0 && nUsed<(size_t)nWidth)
+	{
+		m_Buffer.append((size_t)nWidth-nUsed, ' ');
+	}
+}
+
+void CAlogEncoder::AppendInteger(long long nVal)
+{
+	char Digits[24];
+	int n = sizeof(Digits);
+
+	unsigned long long nMag = nVal<0 ? 0ULL-(unsigned long long)nVal : (unsigned long long)nVal;
+	do
+	{
+		Digits[--n] = (char)('0'+nMag%10);
+		nMag/=10;
+	}while(nMag!=0);
+
+	if(nVal<0)
+		Digits[--n] = '-';
+
+	m_Buffer.append(Digits+n, sizeof(Digits)-n);
+}
+
+void CAlogEncoder::AppendFixed(double dfVal, int nWidth, int nPrecision)
+{
+	size_t nStart = m_Buffer.size();
+
+	//printf keeps the sign of negative numbers (and -0) even if they round to zero
+	unsigned long long nBits;
+	memcpy(&nBits, &dfVal, sizeof(nBits));
+	bool bNegative = (nBits>>63)!=0;
+	double dfMag = std::fabs(dfVal);
+
+	bool bFast = nPrecision>=0 && nPrecision<=MAX_FAST_PRECISION && dfMag==dfMag;
+
+	double dfScaled = 0;
+	if(bFast)
+	{
+		dfScaled = dfMag*POWERS_OF_TEN[nPrecision];
+		bFast = dfScaled<MAX_FAST_SCALED;
+	}
+
+	unsigned long long nRounded = 0;
+	if(bFast)
+	{
+		//the product is within half an ulp of the exact value so unless the fraction is
+		//right next to a half we know exactly which way printf would have rounded
+		double dfWhole = std::floor(dfScaled);
+		double dfFraction = dfScaled-dfWhole;
+		double dfError = dfScaled*2.3e-16+1e-300;
+
+		if(std::fabs(dfFraction-0.5)<=dfError)
+		{
+			bFast = false;
+		}
+		else
+		{
+			nRounded = (unsigned long long)dfWhole + (dfFraction>0.5 ? 1 : 0);
+		}
+	}
+
+	if(!bFast)
+	{
+		AppendFixedFallback(dfVal, nPrecision);
+		PadFrom(nStart, nWidth);
+		return;
+	}
+
+	unsigned long long nScale = (unsigned long long)POWERS_OF_TEN[nPrecision];
+	unsigned long long nWhole = nRounded/nScale;
+	unsigned long long nFraction = nRounded%nScale;
+
+	char Digits[48];
+	int n = sizeof(Digits);
+
+	//fractional digits including leading zeros...
+	for(int i = 0;i<nPrecision;i++)
+	{
+		Digits[--n] = (char)('0'+nFraction%10);
+		nFraction/=10;
+	}
+	if(nPrecision>0)
+		Digits[--n] = '.';
+
+	//...then the integer part
+	do
+	{
+		Digits[--n] = (char)('0'+nWhole%10);
+		nWhole/=10;
+	}while(nWhole!=0);
+
+	if(bNegative)
+		Digits[--n] = '-';
+
+	m_Buffer.append(Digits+n, sizeof(Digits)-n);
+	PadFrom(nStart, nWidth);
+}
+
+void CAlogEncoder::AppendGeneral(double dfVal, int nWidth, int nPrecision)
+{
+	//a double in %g never needs more than this
+	char Tmp[64];
+	int nWritten = snprintf(Tmp, sizeof(Tmp), "%-*.*g", nWidth<48 ? nWidth : 48, nPrecision<17 ? nPrecision : 17, dfVal);
+
+	if(nWritten<0)
+		return;
+
+	size_t nStart = m_Buffer.size();
+	m_Buffer.append(Tmp, (size_t)nWritten<sizeof(Tmp) ? nWritten : sizeof(Tmp)-1);
+	PadFrom(nStart, nWidth);
+}
+
+void CAlogEncoder::AppendFixedFallback(double dfVal, int nPrecision)
+{
+	char Tmp[512];
+	int nWritten = snprintf(Tmp, sizeof(Tmp), "%.*f", nPrecision, dfVal);
+
+	if(nWritten<0)
+		return;
+
+	if((size_t)nWritten<sizeof(Tmp))
+	{
+		m_Buffer.append(Tmp, nWritten);
+	}
+	else
+	{
+		//enormous number or precision - pay for an allocation
+		std::string sTmp(nWritten+1, '\0');
+		snprintf(&sTmp[0], sTmp.size(), "%.*f", nPrecision, dfVal);
+		m_Buffer.append(sTmp.data(), nWritten);
+	}
+}
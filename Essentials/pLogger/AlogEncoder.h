@@ -0,0 +1,94 @@
+/*
+ *  AlogEncoder.h
+ *  MOOS
+ *
+ */
+
+#ifndef CALOGENCODERH
+#define CALOGENCODERH
+
+#include <string>
+
+
+/*!
+    @class   CAlogEncoder
+    @abstract    A reusable text buffer with the handful of formatting operations an alog line needs
+    @discussion  Replaces a std::stringstream per message. The buffer is cleared, not freed, between
+				 batches so once it has grown to the size of a typical batch formatting costs no heap
+				 allocation. Output is byte for byte what the equivalent iostream manipulators
+				 (left, fixed, setw, setprecision) produce.
+*/
+
+class CAlogEncoder
+	{
+	public:
+		CAlogEncoder();
+
+		/*!
+		 @function   Clear
+		 @abstract   empty the buffer but keep its memory
+		 */
+		void Clear();
+
+		/*!
+		 @function   GetBuffer
+		 @abstract   everything appended since the last Clear()
+		 */
+		const std::string & GetBuffer() const;
+
+		/*!
+		 @function   Size
+		 @abstract   number of bytes in the buffer
+		 */
+		size_t Size() const;
+
+		/*!
+		 @function   AppendFixed
+		 @abstract   append a double as printf("%-*.*f") would
+		 @param dfVal the number
+		 @param nWidth minimum field width (left justified, space padded)
+		 @param nPrecision number of digits after the decimal point
+		 */
+		void AppendFixed(double dfVal, int nWidth, int nPrecision);
+
+		/*!
+		 @function   AppendGeneral
+		 @abstract   append a double as printf("%-*.*g") would (the iostream default format)
+		 @param nWidth minimum field width (left justified, space padded)
+		 @param nPrecision number of significant digits
+		 */
+		void AppendGeneral(double dfVal, int nWidth, int nPrecision);
+
+		/*!
+		 @function   AppendPadded
+		 @abstract   append a string left justified in a field of at least nWidth characters
+		 */
+		void AppendPadded(const std::string & sStr, int nWidth);
+
+		/*!
+		 @function   PadFrom
+		 @abstract   pad with spaces so everything appended since nStart is at least nWidth wide
+		 @discussion lets a field be built from several pieces and then justified
+		 */
+		void PadFrom(size_t nStart, int nWidth);
+
+		/*!
+		 @function   AppendInteger
+		 @abstract   append a (possibly negative) integer in decimal
+		 */
+		void AppendInteger(long long nVal);
+
+		void Append(const std::string & sStr);
+		void Append(const char * sStr);
+		void Append(const char * pData, size_t nBytes);
+		void Append(char c);
+
+	protected:
+
+		/** the slow but always correct route via snprintf */
+		void AppendFixedFallback(double dfVal, int nPrecision);
+
+		std::string m_Buffer;
+	};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ *  AlogIndex.cpp
+ *  MOOS
+ *
+ */
+
+#include "AlogIndex.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+
+
+CAlogIndex::CAlogIndex()
+{
+	m_bOpen = false;
+	m_nInterval = 0;
+	m_nNextIndexedOffset = 0;
+}
+
+CAlogIndex::~CAlogIndex()
+{
+	Close();
+}
+
+bool CAlogIndex::IsOpen()
+{
+	return m_bOpen;
+}
+
+bool CAlogIndex::Open(const std::string & sIndexFileName, const std::string & sLogFileName, unsigned long long nInterval)
+{
+	if(m_bOpen)
+		Close();
+
+	if(!m_Writer.Start(sIndexFileName))
+		return false;
+
+	m_nInterval = nInterval;
+	m_nNextIndexedOffset = 0;
+	m_Variables.clear();
+
+	m_Writer.Push(MOOSFormat("%%%% ALOG INDEX\n%%%% LOG FILE: %s\n%%%% INTERVAL %llu\n",
+		sLogFileName.c_str(),
+		m_nInterval));
+
+	m_bOpen = true;
+	return true;
+}
+
+bool CAlogIndex::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	std::string sTable;
+	std::map<std::string, VariableExtent>::iterator q;
+	for(q = m_Variables.begin();q!=m_Variables.end();q++)
+	{
+		sTable+=MOOSFormat("V %s %llu %llu %llu\n",
+			q->first.c_str(),
+			q->second.nFirst,
+			q->second.nLast,
+			q->second.nCount);
+	}
+	m_Writer.Push(sTable);
+
+	m_bOpen = false;
+	return m_Writer.Stop();
+}
+
+void CAlogIndex::AddEntry(double dfTime, const std::string & sKey, unsigned long long nOffset)
+{
+	if(!m_bOpen)
+		return;
+
+	std::map<std::string, VariableExtent>::iterator q = m_Variables.find(sKey);
+	if(q==m_Variables.end())
+	{
+		VariableExtent Extent;
+		Extent.nFirst = nOffset;
+		Extent.nCount = 0;
+		q = m_Variables.insert(std::make_pair(sKey, Extent)).first;
+	}
+	q->second.nLast = nOffset;
+	q->second.nCount++;
+
+	if(nOffset>=m_nNextIndexedOffset)
+	{
+		m_Writer.Push(MOOSFormat("T %.3f %llu\n", dfTime, nOffset));
+		m_nNextIndexedOffset = nOffset+m_nInterval;
+	}
+}
+
+void CAlogIndex::AddRestartPoint(unsigned long long nOffset, unsigned long long nCompressedOffset)
+{
+	if(!m_bOpen)
+		return;
+
+	m_Writer.Push(MOOSFormat("Z %llu %llu\n", nOffset, nCompressedOffset));
+}
+
+void CAlogIndex::AddMemberStart(unsigned long long nOffset, unsigned long long nCompressedOffset)
+{
+	if(!m_bOpen)
+		return;
+
+	m_Writer.Push(MOOSFormat("M %llu %llu\n", nOffset, nCompressedOffset));
+}
@@ -0,0 +1,98 @@
+/*
+ *  AlogIndex.h
+ *  MOOS
+ *
+ */
+
+#ifndef CALOGINDEXH
+#define CALOGINDEXH
+
+#include <map>
+#include <string>
+#include "LogWriter.h"
+
+
+/*!
+    @class   CAlogIndex
+    @abstract    Maintains a sidecar seek index (.aidx) for an alog as it is written
+    @discussion  The index is a small text file of lines
+
+				 T time offset
+						every Interval bytes of alog: the time of the entry starting at
+						that (uncompressed) byte offset. Binary search these to seek by time
+				 Z offset compressed-offset
+						compressed alogs only: a point at which the deflate stream was fully
+						flushed. A raw inflate (no header, windowBits -15) started at
+						compressed-offset produces the alog from offset onwards
+				 M offset compressed-offset
+						block compressed (or zstd/lz4) alogs only: a new member - gzip member
+						or zstd/lz4 frame - starts at compressed-offset and decompresses to the
+						alog from offset onwards
+				 V name first-offset last-offset count
+						written when the alog is closed: where each variable first and last
+						appears and how many entries it has
+
+				 T and V lines come from the mail thread, Z and M lines from the zipper, so
+				 all writes go through a (thread safe) CLogWriter.
+*/
+
+class CAlogIndex
+	{
+	public:
+		CAlogIndex();
+		~CAlogIndex();
+
+		/*!
+		 @function   Open
+		 @abstract   start a new index
+		 @param sIndexFileName name of the .aidx file
+		 @param sLogFileName name of the log being indexed (recorded in the header)
+		 @param nInterval how many bytes of alog between time records
+		 */
+		bool Open(const std::string & sIndexFileName, const std::string & sLogFileName, unsigned long long nInterval);
+
+		/*!
+		 @function   Close
+		 @abstract   write the per variable table and close the index
+		 */
+		bool Close();
+
+		bool IsOpen();
+
+		/*!
+		 @function   AddEntry
+		 @abstract   called for every alog entry with the offset at which it starts
+		 */
+		void AddEntry(double dfTime, const std::string & sKey, unsigned long long nOffset);
+
+		/*!
+		 @function   AddRestartPoint
+		 @abstract   record a point from which a compressed alog can be decompressed (thread safe)
+		 */
+		void AddRestartPoint(unsigned long long nOffset, unsigned long long nCompressedOffset);
+
+		/*!
+		 @function   AddMemberStart
+		 @abstract   record where an independently compressed member begins (thread safe)
+		 */
+		void AddMemberStart(unsigned long long nOffset, unsigned long long nCompressedOffset);
+
+	protected:
+
+		struct VariableExtent
+		{
+			unsigned long long nFirst;
+			unsigned long long nLast;
+			unsigned long long nCount;
+		};
+
+		CLogWriter m_Writer;
+		bool m_bOpen;
+
+		unsigned long long m_nInterval;
+		unsigned long long m_nNextIndexedOffset;
+
+		std::map<std::string, VariableExtent> m_Variables;
+	};
+
+#endif
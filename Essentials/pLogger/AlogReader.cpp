@@ -0,0 +1,985 @@
+/*
+ *  AlogReader.cpp
+ *  MOOS
+ *
+ */
+
+#include "AlogReader.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#ifdef ZLIB_FOUND
+	#include <zlib.h>
+#endif
+
+//inflated alog is read in pieces this big (a longer line makes it grow)
+#define READER_BUFFER_SIZE (1024*1024)
+//compressed alog is read in pieces this big
+#define READER_INPUT_SIZE (256*1024)
+//mail is logged as it arrives, not quite in time order, so time filters allow this much (seconds)
+#define READER_TIME_SLACK 5.0
+//how binary entries begin
+#define READER_BINARY_TAG "<MOOS_BINARY>"
+
+static const double POWERS_OF_TEN[23] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+CMappedFile::CMappedFile()
+{
+	m_pData = NULL;
+	m_nSize = 0;
+	m_bOpen = false;
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(const std::string & sFileName, bool bSequential)
+{
+	Close();
+
+#ifdef _WIN32
+	(void)bSequential;
+	std::ifstream In(sFileName.c_str(), std::ios::binary);
+	if(!In.is_open())
+		return false;
+
+	In.seekg(0, std::ios::end);
+	m_nSize = (unsigned long long)In.tellg();
+	In.seekg(0, std::ios::beg);
+	m_Contents.resize((size_t)m_nSize);
+	if(m_nSize>0 && !In.read(&m_Contents[0], (std::streamsize)m_nSize))
+	{
+		m_Contents.clear();
+		m_nSize = 0;
+		return false;
+	}
+	m_pData = m_nSize>0 ? &m_Contents[0] : NULL;
+#else
+	int nFile = open(sFileName.c_str(), O_RDONLY);
+	if(nFile<0)
+		return false;
+
+	struct stat Status;
+	if(fstat(nFile, &Status)!=0)
+	{
+		close(nFile);
+		return false;
+	}
+
+	m_nSize = (unsigned long long)Status.st_size;
+	if(m_nSize>0)
+	{
+		void * pMap = mmap(NULL, (size_t)m_nSize, PROT_READ, MAP_SHARED, nFile, 0);
+		if(pMap==MAP_FAILED)
+		{
+			close(nFile);
+			m_nSize = 0;
+			return false;
+		}
+		if(bSequential)
+			madvise(pMap, (size_t)m_nSize, MADV_SEQUENTIAL);
+		m_pData = (const char *)pMap;
+	}
+
+	//the mapping holds the file open
+	close(nFile);
+#endif
+
+	m_sFileName = sFileName;
+	m_bOpen = true;
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if(!m_bOpen)
+		return;
+
+#ifdef _WIN32
+	m_Contents.clear();
+#else
+	if(m_pData!=NULL)
+		munmap((void *)m_pData, (size_t)m_nSize);
+#endif
+
+	m_pData = NULL;
+	m_nSize = 0;
+	m_sFileName.clear();
+	m_bOpen = false;
+}
+
+bool CMappedFile::IsOpen() const
+{
+	return m_bOpen;
+}
+
+const char * CMappedFile::GetData() const
+{
+	return m_pData;
+}
+
+unsigned long long CMappedFile::GetSize() const
+{
+	return m_nSize;
+}
+
+const std::string & CMappedFile::GetFileName() const
+{
+	return m_sFileName;
+}
+
+
+bool CAlogReader::View::operator==(const std::string & sOther) const
+{
+	return nSize==sOther.size() && memcmp(pData, sOther.data(), nSize)==0;
+}
+
+CAlogReader::Entry::Entry()
+{
+	dfTime = 0;
+	dfReceiveTime = -1;
+	eType = STRING;
+	nOffset = 0;
+	nBlogOffset = 0;
+	nBlogBytes = 0;
+}
+
+double CAlogReader::Entry::GetDouble() const
+{
+	double dfVal;
+	if(eType==BINARY || !ParseDouble(Value.pData, Value.nSize, dfVal))
+		return 0;
+	return dfVal;
+}
+
+CAlogReader::iterator & CAlogReader::iterator::operator++()
+{
+	if(m_pReader!=NULL && !m_pReader->Next(m_pReader->m_Current))
+	{
+		m_pReader->m_bHaveCurrent = false;
+		m_pReader = NULL;
+	}
+	return *this;
+}
+
+
+CAlogReader::CAlogReader()
+{
+	m_bOpen = false;
+	m_bCompressed = false;
+	m_pFile = NULL;
+	m_pInflater = NULL;
+	Close();
+}
+
+CAlogReader::~CAlogReader()
+{
+	Close();
+}
+
+void CAlogReader::Close()
+{
+	m_Map.Close();
+	m_Blog.Close();
+
+#ifdef ZLIB_FOUND
+	if(m_pInflater!=NULL)
+	{
+		z_stream * pStream = (z_stream *)m_pInflater;
+		inflateEnd(pStream);
+		delete pStream;
+	}
+#endif
+	m_pInflater = NULL;
+
+	if(m_pFile!=NULL)
+		fclose(m_pFile);
+	m_pFile = NULL;
+
+	m_Input.clear();
+	m_Buffer.clear();
+
+	m_bOpen = false;
+	m_bCompressed = false;
+	m_bStarted = false;
+	m_bFinished = false;
+	m_bHaveCurrent = false;
+	m_bRawDeflate = false;
+	m_nTrailerToSkip = 0;
+	m_bInputEnded = false;
+
+	m_dfLogStart = -1;
+	m_bTypeMarked = false;
+	m_bReceiveTimed = false;
+
+	m_dfStart = 0;
+	m_dfEnd = 0;
+	m_bTimeFiltered = false;
+	m_Variables.clear();
+	m_nStop = ~0ULL;
+
+	m_bIndexed = false;
+	m_TimeIndex.clear();
+	m_RestartPoints.clear();
+	m_VariableIndex.clear();
+
+	m_pWindow = NULL;
+	m_nWindowSize = 0;
+	m_nPosition = 0;
+	m_nWindowOffset = 0;
+}
+
+bool CAlogReader::IsOpen() const
+{
+	return m_bOpen;
+}
+
+bool CAlogReader::Open(const std::string & sFileName, bool bUseIndex)
+{
+	Close();
+
+	m_sFileName = sFileName;
+	size_t nSlash = sFileName.find_last_of("/\\");
+	m_sDirectory = nSlash==std::string::npos ? "." : sFileName.substr(0, nSlash);
+
+	std::string sUncompressed = sFileName;
+	m_bCompressed = sFileName.size()>3 && sFileName.compare(sFileName.size()-3, 3, ".gz")==0;
+
+	if(m_bCompressed)
+	{
+		sUncompressed.resize(sUncompressed.size()-3);
+#ifdef ZLIB_FOUND
+		m_pFile = fopen(sFileName.c_str(), "rb");
+		if(m_pFile==NULL)
+		{
+			std::cerr<<"cannot open "<<sFileName<<"\n";
+			return false;
+		}
+
+		m_pInflater = new z_stream;
+		memset(m_pInflater, 0, sizeof(z_stream));
+		m_Input.resize(READER_INPUT_SIZE);
+		m_Buffer.resize(READER_BUFFER_SIZE);
+		if(!StartInflating(0, false))
+		{
+			Close();
+			return false;
+		}
+#else
+		std::cerr<<"cannot read "<<sFileName<<" - built without zlib\n";
+		return false;
+#endif
+	}
+	else
+	{
+		if(!m_Map.Open(sFileName, true))
+		{
+			std::cerr<<"cannot open "<<sFileName<<"\n";
+			return false;
+		}
+		m_pWindow = m_Map.GetData();
+		m_nWindowSize = (size_t)m_Map.GetSize();
+	}
+
+	m_bOpen = true;
+
+	//the banner is a block of %% lines at the top - leave the reader at the first entry
+	for(;;)
+	{
+		if(m_nPosition>=m_nWindowSize && !(m_bCompressed && Fill()))
+			break;
+		if(m_pWindow[m_nPosition]!='%')
+			break;
+
+		const char * pLine;
+		size_t nLength;
+		unsigned long long nOffset;
+		if(!NextLine(pLine, nLength, nOffset))
+			break;
+
+		std::string sLine(pLine, nLength);
+		size_t nLogStart = sLine.find("LOGSTART");
+		if(nLogStart!=std::string::npos)
+			m_dfLogStart = atof(sLine.c_str()+nLogStart+strlen("LOGSTART"));
+		else if(sLine.find("DATATYPE MARKING ON")!=std::string::npos)
+			m_bTypeMarked = true;
+		else if(sLine.find("RECEIVE TIME ON")!=std::string::npos)
+			m_bReceiveTimed = true;
+	}
+
+	//mission.alog and mission.alog.gz are both indexed by mission.aidx
+	if(bUseIndex && sUncompressed.size()>5 && sUncompressed.compare(sUncompressed.size()-5, 5, ".alog")==0)
+		m_bIndexed = LoadIndex(sUncompressed.substr(0, sUncompressed.size()-5)+".aidx");
+
+	//failing that a compressed log written as members has a member index
+	if(bUseIndex && !m_bIndexed && m_bCompressed && CheckMemberIndex(sUncompressed+".zidx"))
+		m_bIndexed = LoadIndex(sUncompressed+".zidx");
+
+	return true;
+}
+
+bool CAlogReader::LoadIndex(const std::string & sIndexFileName)
+{
+	std::ifstream In(sIndexFileName.c_str());
+	if(!In.is_open())
+		return false;
+
+	std::string sLine;
+	while(std::getline(In, sLine))
+	{
+		if(sLine.size()<2 || sLine[1]!=' ')
+			continue;
+
+		std::istringstream Fields(sLine.substr(2));
+		switch(sLine[0])
+		{
+			case 'T':
+			{
+				std::pair<double, unsigned long long> Point;
+				if(Fields>>Point.first>>Point.second)
+					m_TimeIndex.push_back(Point);
+				break;
+			}
+			case 'Z':
+			case 'M':
+			{
+				RestartPoint Point;
+				Point.bMember = sLine[0]=='M';
+				if(Fields>>Point.nOffset>>Point.nCompressedOffset)
+					m_RestartPoints.push_back(Point);
+
+				//a member index (.zidx) also gives the time of each member's first entry
+				unsigned long long nCompressedBytes;
+				std::pair<double, unsigned long long> Start(0, Point.nOffset);
+				if(Point.bMember && Fields>>nCompressedBytes>>Start.first && Start.first>=0)
+					m_TimeIndex.push_back(Start);
+				break;
+			}
+			case 'V':
+			{
+				std::string sName;
+				VariableExtent Extent;
+				if(Fields>>sName>>Extent.nFirst>>Extent.nLast)
+					m_VariableIndex[sName] = Extent;
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+bool CAlogReader::CheckMemberIndex(const std::string & sIndexFileName)
+{
+	std::ifstream In(sIndexFileName.c_str());
+	if(!In.is_open())
+		return false;
+
+	//an index left behind by another log of the same name, or a log renamed away from its own
+	std::string sName = m_sFileName.substr(m_sFileName.find_last_of("/\\")+1);
+	std::string sLine;
+	if(!std::getline(In, sLine) || sLine!="%% MEMBER INDEX "+sName)
+	{
+		std::cerr<<"ignoring "<<sIndexFileName<<" - it doesn't index "<<sName<<"\n";
+		return false;
+	}
+
+	//a log which has been truncated (or copied while it was written) since
+	std::ifstream Data(m_sFileName.c_str(), std::ios::in|std::ios::binary);
+	Data.seekg(0, std::ios::end);
+	unsigned long long nFileSize = Data ? (unsigned long long)Data.tellg() : 0;
+	while(std::getline(In, sLine))
+	{
+		if(sLine.size()<2 || sLine[0]!='M' || sLine[1]!=' ')
+			continue;
+
+		unsigned long long nOffset, nCompressedOffset, nCompressedBytes;
+		std::istringstream Fields(sLine.substr(2));
+		if(Fields>>nOffset>>nCompressedOffset>>nCompressedBytes && nCompressedOffset+nCompressedBytes>nFileSize)
+		{
+			std::cerr<<"ignoring "<<sIndexFileName<<" - it lists members past the end of "<<sName<<"\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CAlogReader::SetTimeRange(double dfStart, double dfEnd)
+{
+	m_dfStart = dfStart;
+	m_dfEnd = dfEnd;
+	m_bTimeFiltered = true;
+}
+
+void CAlogReader::AddVariable(const std::string & sName)
+{
+	m_Variables.push_back(sName);
+}
+
+double CAlogReader::GetLogStart() const
+{
+	return m_dfLogStart;
+}
+
+bool CAlogReader::IsReceiveTimed() const
+{
+	return m_bReceiveTimed;
+}
+
+bool CAlogReader::IsDataTypeMarked() const
+{
+	return m_bTypeMarked;
+}
+
+bool CAlogReader::HasIndex() const
+{
+	return m_bIndexed;
+}
+
+void CAlogReader::PlanRead()
+{
+	m_bStarted = true;
+
+	if(!m_bIndexed)
+		return;
+
+	unsigned long long nStart = 0;
+
+	//the last indexed entry comfortably before the start of the window
+	if(m_bTimeFiltered)
+	{
+		for(size_t i = 0;i<m_TimeIndex.size();i++)
+		{
+			if(m_TimeIndex[i].first>m_dfStart-READER_TIME_SLACK)
+				break;
+			nStart = m_TimeIndex[i].second;
+		}
+	}
+
+	//the table of variables is written when the alog is closed - a log which was
+	//not closed properly doesn't have one so it must be read to the end
+	if(!m_Variables.empty() && !m_VariableIndex.empty())
+	{
+		bool bAny = false;
+		unsigned long long nFirst = ~0ULL;
+		unsigned long long nLast = 0;
+		for(size_t i = 0;i<m_Variables.size();i++)
+		{
+			std::map<std::string, VariableExtent>::iterator q = m_VariableIndex.find(m_Variables[i]);
+			if(q==m_VariableIndex.end())
+				continue;
+
+			bAny = true;
+			if(q->second.nFirst<nFirst)
+				nFirst = q->second.nFirst;
+			if(q->second.nLast>nLast)
+				nLast = q->second.nLast;
+		}
+
+		if(!bAny)
+		{
+			m_bFinished = true;
+			return;
+		}
+
+		if(nFirst>nStart)
+			nStart = nFirst;
+		m_nStop = nLast;
+	}
+
+	if(!SeekTo(nStart))
+		m_bFinished = true;
+}
+
+bool CAlogReader::SeekTo(unsigned long long nOffset)
+{
+	if(nOffset<=m_nWindowOffset+m_nPosition)
+		return true;
+
+	if(!m_bCompressed)
+	{
+		if(nOffset>m_nWindowSize)
+			return false;
+		m_nPosition = (size_t)nOffset;
+		return true;
+	}
+
+	//rather than inflate everything up to the offset start from the nearest restart point
+	//before it which is beyond what we have already inflated
+	const RestartPoint * pBest = NULL;
+	for(size_t i = 0;i<m_RestartPoints.size();i++)
+	{
+		const RestartPoint & rPoint = m_RestartPoints[i];
+		if(rPoint.nOffset<=nOffset && rPoint.nOffset>m_nWindowOffset+m_nWindowSize &&
+			(pBest==NULL || rPoint.nOffset>pBest->nOffset))
+		{
+			pBest = &rPoint;
+		}
+	}
+
+	if(pBest!=NULL)
+	{
+		if(!StartInflating(pBest->nCompressedOffset, !pBest->bMember))
+			return false;
+		m_nWindowOffset = pBest->nOffset;
+	}
+
+	while(m_nWindowOffset+m_nWindowSize<nOffset)
+	{
+		m_nPosition = m_nWindowSize;
+		if(!Fill())
+			return false;
+	}
+
+	m_nPosition = (size_t)(nOffset-m_nWindowOffset);
+	return true;
+}
+
+bool CAlogReader::StartInflating(unsigned long long nCompressedOffset, bool bRawDeflate)
+{
+#ifdef ZLIB_FOUND
+	z_stream * pStream = (z_stream *)m_pInflater;
+	if(pStream==NULL || m_pFile==NULL)
+		return false;
+
+#ifdef _WIN32
+	int nSeek = _fseeki64(m_pFile, (__int64)nCompressedOffset, SEEK_SET);
+#else
+	int nSeek = fseeko(m_pFile, (off_t)nCompressedOffset, SEEK_SET);
+#endif
+	if(nSeek!=0)
+		return false;
+
+	//a full flush point is the middle of a raw deflate stream, a member starts with a gzip header
+	inflateEnd(pStream);
+	memset(pStream, 0, sizeof(z_stream));
+	if(inflateInit2(pStream, bRawDeflate ? -MAX_WBITS : MAX_WBITS+16)!=Z_OK)
+	{
+		std::cerr<<"cannot start inflating "<<m_sFileName<<"\n";
+		return false;
+	}
+
+	m_bRawDeflate = bRawDeflate;
+	m_nTrailerToSkip = 0;
+	m_bInputEnded = false;
+
+	m_pWindow = &m_Buffer[0];
+	m_nWindowSize = 0;
+	m_nPosition = 0;
+	m_nWindowOffset = 0;
+	return true;
+#else
+	(void)nCompressedOffset;
+	(void)bRawDeflate;
+	return false;
+#endif
+}
+
+bool CAlogReader::Fill()
+{
+#ifdef ZLIB_FOUND
+	z_stream * pStream = (z_stream *)m_pInflater;
+	if(!m_bCompressed || pStream==NULL)
+		return false;
+
+	//keep the unread tail, which is the start of a line
+	if(m_nPosition>0)
+	{
+		memmove(&m_Buffer[0], &m_Buffer[0]+m_nPosition, m_nWindowSize-m_nPosition);
+		m_nWindowOffset+=m_nPosition;
+		m_nWindowSize-=m_nPosition;
+		m_nPosition = 0;
+	}
+
+	//a line longer than the buffer
+	if(m_nWindowSize==m_Buffer.size())
+		m_Buffer.resize(m_Buffer.size()*2);
+	m_pWindow = &m_Buffer[0];
+
+	size_t nBefore = m_nWindowSize;
+	while(m_nWindowSize==nBefore)
+	{
+		if(pStream->avail_in==0 && !m_bInputEnded)
+		{
+			size_t nRead = fread(&m_Input[0], 1, m_Input.size(), m_pFile);
+			if(nRead==0)
+				m_bInputEnded = true;
+			pStream->next_in = (Bytef *)&m_Input[0];
+			pStream->avail_in = (uInt)nRead;
+		}
+
+		if(pStream->avail_in==0 && m_bInputEnded)
+			return false;
+
+		//started at a restart point we were inflating raw deflate - the gzip
+		//trailer is next, then (in a multi member file) another member
+		if(m_nTrailerToSkip>0)
+		{
+			uInt nSkip = pStream->avail_in<(uInt)m_nTrailerToSkip ? pStream->avail_in : (uInt)m_nTrailerToSkip;
+			pStream->next_in+=nSkip;
+			pStream->avail_in-=nSkip;
+			m_nTrailerToSkip-=nSkip;
+			if(m_nTrailerToSkip==0)
+			{
+				inflateEnd(pStream);
+				Bytef * pNext = pStream->next_in;
+				uInt nAvailable = pStream->avail_in;
+				memset(pStream, 0, sizeof(z_stream));
+				if(inflateInit2(pStream, MAX_WBITS+16)!=Z_OK)
+					return false;
+				pStream->next_in = pNext;
+				pStream->avail_in = nAvailable;
+				m_bRawDeflate = false;
+			}
+			continue;
+		}
+
+		pStream->next_out = (Bytef *)&m_Buffer[0]+m_nWindowSize;
+		pStream->avail_out = (uInt)(m_Buffer.size()-m_nWindowSize);
+
+		int nResult = inflate(pStream, Z_NO_FLUSH);
+		m_nWindowSize = m_Buffer.size()-pStream->avail_out;
+
+		if(nResult==Z_STREAM_END)
+		{
+			if(m_bRawDeflate)
+				m_nTrailerToSkip = 8;
+			else
+				inflateReset(pStream);
+		}
+		else if(nResult==Z_BUF_ERROR)
+		{
+			//needs more input than there is - a file cut short
+			if(m_bInputEnded)
+				break;
+		}
+		else if(nResult!=Z_OK)
+		{
+			std::cerr<<"corrupt data in "<<m_sFileName<<" at "<<m_nWindowOffset+m_nWindowSize<<"\n";
+			m_bInputEnded = true;
+			pStream->avail_in = 0;
+			break;
+		}
+	}
+
+	return m_nWindowSize>nBefore;
+#else
+	return false;
+#endif
+}
+
+bool CAlogReader::NextLine(const char * & pLine, size_t & nLength, unsigned long long & nOffset)
+{
+	for(;;)
+	{
+		if(m_nPosition<m_nWindowSize)
+		{
+			const char * pStart = m_pWindow+m_nPosition;
+
+			//the zero filled tail of a log written by a preallocating backend
+			if(*pStart=='\0')
+				return false;
+
+			const char * pEnd = (const char *)memchr(pStart, '\n', m_nWindowSize-m_nPosition);
+			if(pEnd!=NULL)
+			{
+				pLine = pStart;
+				nLength = pEnd-pStart;
+				nOffset = m_nWindowOffset+m_nPosition;
+				m_nPosition+=nLength+1;
+				return true;
+			}
+		}
+
+		//anything left without a newline is a line cut short
+		if(!m_bCompressed || !Fill())
+			return false;
+	}
+}
+
+bool CAlogReader::IsWanted(const View & Key) const
+{
+	if(m_Variables.empty())
+		return true;
+
+	for(size_t i = 0;i<m_Variables.size();i++)
+	{
+		if(Key==m_Variables[i])
+			return true;
+	}
+	return false;
+}
+
+bool CAlogReader::Next(Entry & rEntry)
+{
+	if(!m_bOpen || m_bFinished)
+		return false;
+
+	if(!m_bStarted)
+	{
+		PlanRead();
+		if(m_bFinished)
+			return false;
+	}
+
+	const char * pLine;
+	size_t nLength;
+	unsigned long long nOffset;
+	while(NextLine(pLine, nLength, nOffset))
+	{
+		//past the last entry of any variable we want
+		if(nOffset>m_nStop)
+			break;
+
+		if(nLength==0 || pLine[0]=='%')
+			continue;
+
+		if(!ParseLine(pLine, nLength, m_bTypeMarked, rEntry, m_bReceiveTimed))
+			continue;
+
+		if(m_bTimeFiltered)
+		{
+			if(rEntry.dfTime>m_dfEnd+READER_TIME_SLACK)
+				break;
+			if(rEntry.dfTime<m_dfStart || rEntry.dfTime>m_dfEnd)
+				continue;
+		}
+
+		if(!IsWanted(rEntry.Key))
+			continue;
+
+		rEntry.nOffset = nOffset;
+		return true;
+	}
+
+	m_bFinished = true;
+	return false;
+}
+
+CAlogReader::iterator CAlogReader::begin()
+{
+	if(!m_bHaveCurrent)
+	{
+		if(!Next(m_Current))
+			return end();
+		m_bHaveCurrent = true;
+	}
+	return iterator(this);
+}
+
+CAlogReader::iterator CAlogReader::end()
+{
+	return iterator();
+}
+
+bool CAlogReader::GetBinary(const Entry & rEntry, View & Payload)
+{
+	if(rEntry.eType!=BINARY)
+		return false;
+
+	std::string sBlog = m_sDirectory+"/"+rEntry.BlogFile.ToString();
+	unsigned long long nEnd = rEntry.nBlogOffset+rEntry.nBlogBytes;
+
+	//a blog still being written may have grown since we mapped it
+	if(!m_Blog.IsOpen() || m_Blog.GetFileName()!=sBlog || m_Blog.GetSize()<nEnd)
+	{
+		if(!m_Blog.Open(sBlog))
+			return false;
+	}
+
+	if(m_Blog.GetSize()<nEnd)
+		return false;
+
+	Payload = View(m_Blog.GetData()+rEntry.nBlogOffset, (size_t)rEntry.nBlogBytes);
+	return true;
+}
+
+bool CAlogReader::ParseLine(const char * pLine, size_t nLength, bool bTypeMarked, Entry & rEntry, bool bReceiveTimed)
+{
+	const char * p = pLine;
+	const char * pEnd = pLine+nLength;
+
+	//time, (receive time,) key and source are space separated and padded with spaces
+	int nFields = bReceiveTimed ? 4 : 3;
+	View Fields[4];
+	for(int i = 0;i<nFields;i++)
+	{
+		while(p<pEnd && *p==' ')
+			p++;
+		const char * pStart = p;
+		while(p<pEnd && *p!=' ')
+			p++;
+		if(p==pStart)
+			return false;
+		Fields[i] = View(pStart, p-pStart);
+	}
+
+	if(!ParseDouble(Fields[0].pData, Fields[0].nSize, rEntry.dfTime))
+		return false;
+
+	rEntry.dfReceiveTime = -1;
+	if(bReceiveTimed && !ParseDouble(Fields[1].pData, Fields[1].nSize, rEntry.dfReceiveTime))
+		return false;
+
+	rEntry.Key = Fields[nFields-2];
+	rEntry.Source = Fields[nFields-1];
+
+	//...then the rest of the line is the value, which pLogger pads (doubles) and follows with a space
+	while(p<pEnd && *p==' ')
+		p++;
+	const char * pValueEnd = pEnd;
+	while(pValueEnd>p && pValueEnd[-1]==' ')
+		pValueEnd--;
+	rEntry.Value = View(p, pValueEnd-p);
+
+	rEntry.BlogFile = View();
+	rEntry.nBlogOffset = 0;
+	rEntry.nBlogBytes = 0;
+
+	//<MOOS_BINARY>File=name.blog,Offset=N,Bytes=N</MOOS_BINARY>
+	size_t nTag = strlen(READER_BINARY_TAG);
+	if(rEntry.Value.nSize>nTag && memcmp(p, READER_BINARY_TAG, nTag)==0)
+	{
+		rEntry.eType = BINARY;
+
+		const char * q = p+nTag;
+		while(q<pValueEnd && *q!='<')
+		{
+			const char * pName = q;
+			while(q<pValueEnd && *q!='=')
+				q++;
+			const char * pVal = q<pValueEnd ? q+1 : q;
+			q = pVal;
+			while(q<pValueEnd && *q!=',' && *q!='<')
+				q++;
+
+			View Name(pName, pVal-pName);
+			if(Name=="File=")
+				rEntry.BlogFile = View(pVal, q-pVal);
+			else if(Name=="Offset=")
+				rEntry.nBlogOffset = strtoull(std::string(pVal, q-pVal).c_str(), NULL, 10);
+			else if(Name=="Bytes=")
+				rEntry.nBlogBytes = strtoull(std::string(pVal, q-pVal).c_str(), NULL, 10);
+
+			if(q<pValueEnd && *q==',')
+				q++;
+		}
+		return true;
+	}
+
+	if(bTypeMarked && rEntry.Value.nSize>=2 && p[1]==':' && (p[0]=='D' || p[0]=='S'))
+	{
+		rEntry.eType = p[0]=='D' ? DOUBLE : STRING;
+		rEntry.Value = View(p+2, rEntry.Value.nSize-2);
+		return true;
+	}
+
+	//unmarked - a value which reads as a number was (almost certainly) a double
+	double dfVal;
+	rEntry.eType = ParseDouble(rEntry.Value.pData, rEntry.Value.nSize, dfVal) ? DOUBLE : STRING;
+	return true;
+}
+
+bool CAlogReader::ParseDouble(const char * pData, size_t nSize, double & dfVal)
+{
+	if(nSize==0)
+		return false;
+
+	const char * p = pData;
+	const char * pEnd = pData+nSize;
+
+	bool bNegative = *p=='-';
+	if(*p=='-' || *p=='+')
+		p++;
+
+	//most of what pLogger writes is fixed point which needs no strtod: up to 15 significant
+	//digits are exact in a double, as is a power of ten up to 1e22, so one division rounds right
+	unsigned long long nMantissa = 0;
+	int nDigits = 0;
+	int nDecimals = 0;
+	bool bAnyDigits = false;
+	bool bFast = true;
+
+	while(p<pEnd && *p>='0' && *p<='9')
+	{
+		if(nDigits<15)
+		{
+			nMantissa = nMantissa*10+(*p-'0');
+			if(nMantissa!=0)
+				nDigits++;
+		}
+		else
+			bFast = false;
+		bAnyDigits = true;
+		p++;
+	}
+
+	if(p<pEnd && *p=='.')
+	{
+		p++;
+		while(p<pEnd && *p>='0' && *p<='9')
+		{
+			if(nDigits<15 && nDecimals<22)
+			{
+				nMantissa = nMantissa*10+(*p-'0');
+				if(nMantissa!=0)
+					nDigits++;
+				nDecimals++;
+			}
+			else
+				bFast = false;
+			bAnyDigits = true;
+			p++;
+		}
+	}
+
+	if(p==pEnd && bAnyDigits && bFast)
+	{
+		dfVal = (double)nMantissa/POWERS_OF_TEN[nDecimals];
+		if(bNegative)
+			dfVal = -dfVal;
+		return true;
+	}
+
+	//only exponents, very long numbers, inf and nan are left for strtod - anything
+	//else is text and we can tell that without copying it
+	if(p<pEnd && !(bAnyDigits || *p=='.' || *p=='i' || *p=='I' || *p=='n' || *p=='N'))
+		return false;
+
+	char Tmp[64];
+	if(nSize>=sizeof(Tmp))
+	{
+		std::string sTmp(pData, nSize);
+		char * pStop;
+		dfVal = strtod(sTmp.c_str(), &pStop);
+		return pStop==sTmp.c_str()+nSize;
+	}
+
+	memcpy(Tmp, pData, nSize);
+	Tmp[nSize] = '\0';
+	char * pStop;
+	dfVal = strtod(Tmp, &pStop);
+	return pStop==Tmp+nSize;
+}
@@ -0,0 +1,338 @@
+/*
+ *  AlogReader.h
+ *  MOOS
+ *
+ */
+
+#ifndef CALOGREADERH
+#define CALOGREADERH
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+/*!
+    @class   CMappedFile
+    @abstract    A whole file mapped read only into memory
+    @discussion  Where the platform can't map files the contents are read into memory instead,
+				 so callers never need to know which happened.
+*/
+
+class CMappedFile
+	{
+	public:
+		CMappedFile();
+		~CMappedFile();
+
+		/*!
+		 @function   Open
+		 @abstract   map the named file
+		 @param bSequential tell the OS the file will be read from start to end
+		 */
+		bool Open(const std::string & sFileName, bool bSequential = false);
+
+		void Close();
+
+		bool IsOpen() const;
+
+		const char * GetData() const;
+
+		unsigned long long GetSize() const;
+
+		const std::string & GetFileName() const;
+
+	protected:
+		std::string m_sFileName;
+		const char * m_pData;
+		unsigned long long m_nSize;
+		bool m_bOpen;
+
+		//only used where files can't be mapped
+		std::vector<char> m_Contents;
+
+	private:
+		CMappedFile(const CMappedFile &);
+		CMappedFile & operator=(const CMappedFile &);
+	};
+
+
+/*!
+    @class   CAlogReader
+    @abstract    Reads the entries of an alog (or xlog) as pLogger writes them, as fast as the disk allows
+    @discussion  A plain alog is memory mapped and an .alog.gz is inflated a chunk at a time, so
+				 memory use doesn't grow with the log. Each line is split into time, key, source and
+				 value in place: the fields of an Entry are Views into the reader's buffer and no
+				 string is built per line. A View is valid until the next call to Next() - take a
+				 copy (View::ToString()) of anything which must last longer.
+
+				 Entries can be restricted to a time window and to a set of variables. If the alog
+				 has a seek index (.aidx) alongside it the reader starts at the nearest indexed point
+				 - using the restart points or members recorded in the index to start part way into a
+				 compressed alog - and stops once the last entry of the wanted variables is past.
+				 A compressed alog written as members without a seek index is seeked by time
+				 through its member index (.zidx) instead - as long as the index names this file
+				 and none of its members lie past the end of it, otherwise the log is read from
+				 the start.
+
+				 Binary messages are logged as a reference into the blog. GetBinary() returns a View
+				 of the payload from the (mapped) blog.
+
+				 Entries come back in the order pLogger wrote them, which is the order the mail
+				 arrived. Lines cut short by a crash are skipped, as are the trailing zeros a log
+				 left by a preallocating file backend may end in.
+
+				 Not thread safe. Use as
+
+				 CAlogReader Reader;
+				 Reader.Open("mission.alog.gz");
+				 Reader.AddVariable("NAV_X");
+				 for(CAlogReader::iterator q = Reader.begin();q!=Reader.end();++q)
+					 Process(q->dfTime, q->GetDouble());
+*/
+
+class CAlogReader
+	{
+	public:
+		enum DataType
+		{
+			DOUBLE,
+			STRING,
+			BINARY
+		};
+
+		/** some bytes inside the reader - valid until it moves on */
+		struct View
+		{
+			View() : pData(NULL), nSize(0) {}
+			View(const char * p, size_t n) : pData(p), nSize(n) {}
+
+			std::string ToString() const {return std::string(pData, nSize);}
+			bool empty() const {return nSize==0;}
+			bool operator==(const std::string & sOther) const;
+			bool operator!=(const std::string & sOther) const {return !(*this==sOther);}
+
+			const char * pData;
+			size_t nSize;
+		};
+
+		/** one line of the alog */
+		struct Entry
+		{
+			Entry();
+
+			/** the value as a number (0 if it isn't one) */
+			double GetDouble() const;
+
+			/** seconds since the LOGSTART in the banner */
+			double dfTime;
+
+			/** when pLogger received it (as dfTime), -1 unless the log has RECEIVE TIME ON */
+			double dfReceiveTime;
+			View Key;
+			View Source;
+			View Value;
+			DataType eType;
+
+			/** where the line starts in the (uncompressed) alog */
+			unsigned long long nOffset;
+
+			/** binary entries only - where the payload is in which blog */
+			View BlogFile;
+			unsigned long long nBlogOffset;
+			unsigned long long nBlogBytes;
+		};
+
+		/** a single pass over the entries - advancing it advances the reader */
+		class iterator
+		{
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef Entry value_type;
+			typedef ptrdiff_t difference_type;
+			typedef const Entry * pointer;
+			typedef const Entry & reference;
+
+			iterator() : m_pReader(NULL) {}
+			explicit iterator(CAlogReader * pReader) : m_pReader(pReader) {}
+
+			const Entry & operator*() const {return m_pReader->m_Current;}
+			const Entry * operator->() const {return &m_pReader->m_Current;}
+			iterator & operator++();
+			bool operator==(const iterator & Other) const {return m_pReader==Other.m_pReader;}
+			bool operator!=(const iterator & Other) const {return m_pReader!=Other.m_pReader;}
+
+		protected:
+			CAlogReader * m_pReader;
+		};
+
+		friend class iterator;
+
+		CAlogReader();
+		~CAlogReader();
+
+		/*!
+		 @function   Open
+		 @abstract   open an alog (.alog) or compressed alog (.alog.gz) and read its banner
+		 @param bUseIndex use the seek index (.aidx) or member index (.zidx) if there is one
+		 */
+		bool Open(const std::string & sFileName, bool bUseIndex = true);
+
+		void Close();
+
+		bool IsOpen() const;
+
+		/*!
+		 @function   SetTimeRange
+		 @abstract   only entries with dfStart<=time<=dfEnd (seconds since LOGSTART)
+		 @discussion set filters before the first entry is read
+		 */
+		void SetTimeRange(double dfStart, double dfEnd);
+
+		/*!
+		 @function   AddVariable
+		 @abstract   only entries of this variable (and any others added)
+		 */
+		void AddVariable(const std::string & sName);
+
+		/*!
+		 @function   Next
+		 @abstract   the next entry which passes the filters, false at the end
+		 */
+		bool Next(Entry & rEntry);
+
+		/** the first entry (reading it if need be) - the reader can only be iterated once */
+		iterator begin();
+
+		iterator end();
+
+		/*!
+		 @function   GetBinary
+		 @abstract   the payload of a binary entry, from the blog in the alog's directory
+		 @discussion the View stays valid until another blog is needed
+		 */
+		bool GetBinary(const Entry & rEntry, View & Payload);
+
+		/** the LOGSTART time from the banner (-1 if there was none) */
+		double GetLogStart() const;
+
+		/** were values logged with D: and S: markers */
+		bool IsDataTypeMarked() const;
+
+		/** does each line carry the time pLogger received it */
+		bool IsReceiveTimed() const;
+
+		/** is a seek index being used */
+		bool HasIndex() const;
+
+		/*!
+		 @function   ParseLine
+		 @abstract   split one alog line (without its newline) into an entry
+		 @param bTypeMarked values start with D: or S:
+		 @param bReceiveTimed the time is followed by the receive time
+		 */
+		static bool ParseLine(const char * pLine, size_t nLength, bool bTypeMarked, Entry & rEntry, bool bReceiveTimed = false);
+
+		/*!
+		 @function   ParseDouble
+		 @abstract   read a whole field as a number, false if it isn't exactly one
+		 */
+		static bool ParseDouble(const char * pData, size_t nSize, double & dfVal);
+
+	protected:
+
+		/** a point a compressed alog can be inflated from */
+		struct RestartPoint
+		{
+			unsigned long long nOffset;
+			unsigned long long nCompressedOffset;
+			bool bMember;
+		};
+
+		struct VariableExtent
+		{
+			unsigned long long nFirst;
+			unsigned long long nLast;
+		};
+
+		/** read the .aidx (or .zidx) */
+		bool LoadIndex(const std::string & sIndexFileName);
+
+		/** is the .zidx there and written for this file as it is now (named in its header, members all inside it)? */
+		bool CheckMemberIndex(const std::string & sIndexFileName);
+
+		/** work out where to start and stop from the index and the filters */
+		void PlanRead();
+
+		/** the next complete line, false at the end */
+		bool NextLine(const char * & pLine, size_t & nLength, unsigned long long & nOffset);
+
+		/** move on to the line starting at nOffset (not backwards) */
+		bool SeekTo(unsigned long long nOffset);
+
+		/** compressed alogs - inflate more into the buffer, false at the end */
+		bool Fill();
+
+		/** compressed alogs - start inflating at a point in the file */
+		bool StartInflating(unsigned long long nCompressedOffset, bool bRawDeflate);
+
+		bool IsWanted(const View & Key) const;
+
+		std::string m_sFileName;
+		std::string m_sDirectory;
+		bool m_bOpen;
+		bool m_bCompressed;
+		bool m_bStarted;
+		bool m_bFinished;
+
+		double m_dfLogStart;
+		bool m_bTypeMarked;
+		bool m_bReceiveTimed;
+
+		//filters
+		double m_dfStart;
+		double m_dfEnd;
+		bool m_bTimeFiltered;
+		std::vector<std::string> m_Variables;
+		unsigned long long m_nStop;
+
+		//the seek index
+		bool m_bIndexed;
+		std::vector<std::pair<double, unsigned long long> > m_TimeIndex;
+		std::vector<RestartPoint> m_RestartPoints;
+		std::map<std::string, VariableExtent> m_VariableIndex;
+
+		//the uncompressed bytes being read, starting at m_nWindowOffset in the alog
+		const char * m_pWindow;
+		size_t m_nWindowSize;
+		size_t m_nPosition;
+		unsigned long long m_nWindowOffset;
+
+		//plain alogs
+		CMappedFile m_Map;
+
+		//compressed alogs
+		FILE * m_pFile;
+		void * m_pInflater;
+		bool m_bRawDeflate;
+		int m_nTrailerToSkip;
+		bool m_bInputEnded;
+		std::vector<char> m_Input;
+		std::vector<char> m_Buffer;
+
+		//the blog payloads come from
+		CMappedFile m_Blog;
+
+		//what the iterator points at
+		Entry m_Current;
+		bool m_bHaveCurrent;
+
+	private:
+		CAlogReader(const CAlogReader &);
+		CAlogReader & operator=(const CAlogReader &);
+	};
+
+#endif
@@ -0,0 +1,380 @@
+/*
+ *  BinaryLog.cpp
+ *  MOOS
+ *
+ */
+
+#include "BinaryLog.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include <iostream>
+#include <fcntl.h>
+
+#ifdef _WIN32
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <sys/uio.h>
+	#include <unistd.h>
+	#include <climits>
+	#include <cerrno>
+#endif
+
+//how many bytes can be queued before Add() has to wait for the disk
+#define BLOG_CAPACITY (64*1024*1024)
+
+//how long the writer sleeps if nobody wakes it
+#define BLOG_WAIT_MS 100
+
+//payloads smaller than this are not worth looking up
+#define BLOG_DEDUP_MIN_BYTES 64
+
+//default bytes of recent payloads kept for dedup
+#define BLOG_DEFAULT_DEDUP_CACHE (64*1024*1024)
+
+//most pieces handed to one writev
+#ifdef IOV_MAX
+	#define BLOG_MAX_IOV (IOV_MAX<1024 ? IOV_MAX : 1024)
+#else
+	#define BLOG_MAX_IOV 1024
+#endif
+
+
+bool _BinaryLogThreadWorker(void * pParam)
+{
+	CBinaryLog* pMe = (CBinaryLog*) pParam;
+	return pMe->DoWriting();
+}
+
+namespace
+{
+	//64 bit FNV-1a - plenty to tell payloads apart, a match is always checked byte for byte
+	unsigned long long Hash(const std::string & Data)
+	{
+		unsigned long long nHash = 14695981039346656037ULL;
+		const unsigned char * p = (const unsigned char *)Data.data();
+		for(size_t i = 0;i<Data.size();i++)
+		{
+			nHash^=p[i];
+			nHash*=1099511628211ULL;
+		}
+		return nHash;
+	}
+}
+
+CBinaryLog::CBinaryLog()
+{
+	m_nQueuedBytes = 0;
+	m_nCapacity = BLOG_CAPACITY;
+	m_nFile = -1;
+	m_bOpen = false;
+	m_nOffset = 0;
+	m_bDedup = false;
+	m_nCachedBytes = 0;
+	m_nCacheLimit = BLOG_DEFAULT_DEDUP_CACHE;
+	m_nDuplicateBytes = 0;
+}
+
+CBinaryLog::~CBinaryLog()
+{
+	Close();
+}
+
+bool CBinaryLog::IsOpen()
+{
+	return m_bOpen;
+}
+
+void CBinaryLog::SetDedupCacheSize(size_t nBytes)
+{
+	m_nCacheLimit = nBytes;
+}
+
+void CBinaryLog::SetDurability(const CLogDurability & Policy)
+{
+	m_Durability.SetPolicy(Policy);
+}
+
+double CBinaryLog::GetDurableTime()
+{
+	return m_Durability.GetDurableTime();
+}
+
+CLatencyHistogram & CBinaryLog::GetWriteLatency()
+{
+	return m_WriteLatency;
+}
+
+unsigned long long CBinaryLog::GetSize()
+{
+	return m_nOffset;
+}
+
+unsigned long long CBinaryLog::GetDuplicateBytes()
+{
+	return m_nDuplicateBytes;
+}
+
+bool CBinaryLog::Open(const std::string & sFileName, bool bDedup)
+{
+	if(m_bOpen)
+		Close();
+
+	m_sFileName = sFileName;
+
+#ifdef _WIN32
+	m_nFile = _open(m_sFileName.c_str(), _O_WRONLY|_O_CREAT|_O_TRUNC|_O_BINARY, _S_IREAD|_S_IWRITE);
+#else
+	m_nFile = open(m_sFileName.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+#endif
+	if(m_nFile<0)
+		return false;
+
+	m_nOffset = 0;
+	m_bDedup = bDedup;
+	m_Payloads.clear();
+	m_PayloadAge.clear();
+	m_nCachedBytes = 0;
+	m_nDuplicateBytes = 0;
+
+	m_Durability.Reset(MOOSTime());
+	m_bOpen = true;
+
+	m_Thread.Initialise(_BinaryLogThreadWorker, this);
+	return m_Thread.Start();
+}
+
+bool CBinaryLog::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	bool bOK = true;
+	if(m_Thread.IsThreadRunning())
+	{
+		m_DataSignal.Set();
+		bOK = m_Thread.Stop();
+	}
+
+	//the thread drains on the way out, this catches a thread that never ran
+	bOK = WriteQueued() && bOK;
+
+#ifdef _WIN32
+	_close(m_nFile);
+#else
+	close(m_nFile);
+#endif
+	m_nFile = -1;
+	m_Durability.Closed();
+
+	m_Payloads.clear();
+	m_PayloadAge.clear();
+	m_nCachedBytes = 0;
+
+	m_bOpen = false;
+	return bOK;
+}
+
+unsigned long long CBinaryLog::Add(const char * pHeader, size_t nHeader, const std::string & Payload)
+{
+	unsigned long long nHash = 0;
+	if(m_bDedup && Payload.size()>=BLOG_DEDUP_MIN_BYTES)
+	{
+		nHash = Hash(Payload);
+		long long nPrevious = FindDuplicate(Payload, nHash);
+		if(nPrevious>=0)
+		{
+			m_nDuplicateBytes+=Payload.size();
+			return (unsigned long long)nPrevious;
+		}
+	}
+
+	unsigned long long nPayloadOffset = m_nOffset+nHeader;
+	size_t nBytes = nHeader+Payload.size()+1;
+
+	m_Lock.Lock();
+
+	//if the disk has fallen a long way behind wait for the writer
+	//rather than growing without limit
+	while(m_nQueuedBytes>0 && m_nQueuedBytes+nBytes>m_nCapacity && m_Thread.IsThreadRunning())
+	{
+		m_Lock.UnLock();
+		m_DataSignal.Set();
+		m_SpaceSignal.Wait(BLOG_WAIT_MS);
+		m_Lock.Lock();
+	}
+
+	m_Front.push_back(std::string(pHeader, nHeader));
+	m_Front.push_back(Payload);
+	m_Front.push_back("\n");
+	m_nQueuedBytes+=nBytes;
+
+	m_Lock.UnLock();
+
+	m_DataSignal.Set();
+
+	m_nOffset+=nBytes;
+
+	if(m_bDedup && Payload.size()>=BLOG_DEDUP_MIN_BYTES)
+		RememberPayload(Payload, nHash, nPayloadOffset);
+
+	return nPayloadOffset;
+}
+
+long long CBinaryLog::FindDuplicate(const std::string & Payload, unsigned long long nHash)
+{
+	std::pair<std::multimap<unsigned long long, CachedPayload>::iterator,
+		std::multimap<unsigned long long, CachedPayload>::iterator> Range = m_Payloads.equal_range(nHash);
+
+	std::multimap<unsigned long long, CachedPayload>::iterator q;
+	for(q = Range.first;q!=Range.second;q++)
+	{
+		if(q->second.Data==Payload)
+			return (long long)q->second.nOffset;
+	}
+	return -1;
+}
+
+void CBinaryLog::RememberPayload(const std::string & Data, unsigned long long nHash, unsigned long long nOffset)
+{
+	if(Data.size()>m_nCacheLimit)
+		return;
+
+	//forget the oldest payloads until there is room
+	while(!m_PayloadAge.empty() && m_nCachedBytes+Data.size()>m_nCacheLimit)
+	{
+		m_nCachedBytes-=m_PayloadAge.front()->second.Data.size();
+		m_Payloads.erase(m_PayloadAge.front());
+		m_PayloadAge.pop_front();
+	}
+
+	CachedPayload Entry;
+	Entry.nOffset = nOffset;
+	std::multimap<unsigned long long, CachedPayload>::iterator q = m_Payloads.insert(std::make_pair(nHash, Entry));
+	q->second.Data = Data;
+
+	m_PayloadAge.push_back(q);
+	m_nCachedBytes+=Data.size();
+}
+
+bool CBinaryLog::WriteQueued()
+{
+	//everything added before now is in this batch
+	double dfQueuedBefore = MOOSTime();
+	size_t nBytes = 0;
+
+	m_Lock.Lock();
+	{
+		m_Front.swap(m_Back);
+		nBytes = m_nQueuedBytes;
+		m_nQueuedBytes = 0;
+	}
+	m_Lock.UnLock();
+
+	m_SpaceSignal.Set();
+
+	if(m_Back.empty())
+	{
+		m_Durability.Written(0, dfQueuedBefore);
+		return true;
+	}
+
+	bool bOK = true;
+	double dfStart = MOOSLocalTime();
+
+#ifdef _WIN32
+	for(size_t i = 0;i<m_Back.size() && bOK;i++)
+	{
+		bOK = _write(m_nFile, m_Back[i].data(), (unsigned int)m_Back[i].size())==(int)m_Back[i].size();
+	}
+#else
+	//hand the pieces to the OS as few calls as we can
+	struct iovec Pieces[BLOG_MAX_IOV];
+	size_t nNext = 0;
+	size_t nSkip = 0;
+	while(nNext<m_Back.size() && bOK)
+	{
+		int nPieces = 0;
+		for(size_t i = nNext;i<m_Back.size() && nPieces<BLOG_MAX_IOV;i++,nPieces++)
+		{
+			size_t nStart = (i==nNext) ? nSkip : 0;
+			Pieces[nPieces].iov_base = (void*)(m_Back[i].data()+nStart);
+			Pieces[nPieces].iov_len = m_Back[i].size()-nStart;
+		}
+
+		ssize_t nWritten = writev(m_nFile, Pieces, nPieces);
+		if(nWritten<0 && errno==EINTR)
+			continue;
+
+		if(nWritten<=0)
+		{
+			bOK = false;
+			break;
+		}
+
+		//step over what was written, which may end part way through a piece
+		size_t nLeft = (size_t)nWritten;
+		while(nNext<m_Back.size() && nLeft>=m_Back[nNext].size()-nSkip)
+		{
+			nLeft-=m_Back[nNext].size()-nSkip;
+			nSkip = 0;
+			nNext++;
+		}
+		nSkip+=nLeft;
+	}
+#endif
+
+	m_Back.clear();
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+
+	if(!bOK)
+		std::cerr<<"failed writing to "<<m_sFileName<<"\n";
+	else
+		m_Durability.Written(nBytes, dfQueuedBefore);
+
+	return bOK;
+}
+
+bool CBinaryLog::Commit()
+{
+	//writev has already handed everything to the OS so a flush is free
+	if(m_Durability.GetMode()!=CLogDurability::SYNC)
+	{
+		m_Durability.Committed(MOOSTime());
+		return true;
+	}
+
+	double dfStart = MOOSLocalTime();
+	bool bOK = CLogDurability::SyncFile(m_nFile);
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+
+	if(!bOK)
+	{
+		std::cerr<<"failed committing "<<m_sFileName<<"\n";
+		return false;
+	}
+
+	m_Durability.Committed(MOOSTime());
+	return true;
+}
+
+bool CBinaryLog::DoWriting()
+{
+	while(!m_Thread.IsQuitRequested())
+	{
+		m_DataSignal.Wait(m_Durability.GetWaitMS(BLOG_WAIT_MS));
+
+		WriteQueued();
+
+		//one commit covers everything written since the last
+		if(m_Durability.IsCommitDue(MOOSTime()))
+			Commit();
+	}
+
+	//make sure nothing queued is lost
+	WriteQueued();
+	if(m_Durability.GetMode()!=CLogDurability::NONE)
+		Commit();
+	m_Durability.Closed();
+
+	return true;
+}
@@ -0,0 +1,149 @@
+/*
+ *  BinaryLog.h
+ *  MOOS
+ *
+ */
+
+#ifndef CBINARYLOGH
+#define CBINARYLOGH
+
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "LogSignal.h"
+#include "LogDurability.h"
+#include "LatencyHistogram.h"
+
+
+/*!
+    @class   CBinaryLog
+    @abstract    Writes the binary log (.blog) from a background thread
+    @discussion  Each binary message becomes a record of the alog style entry header, the
+				 payload and a newline - so even the blog is broadly human readable. The alog
+				 refers to the payload by its offset which Add() returns straight away: the
+				 offset is counted here rather than asked of the file so the mail thread
+				 never waits for the disk.
+
+				 Records are queued as pieces (header, payload, newline) and the writer thread
+				 hands whole batches of them to the OS in one scatter-gather write (writev),
+				 with no flush per record. Like CLogWriter the queue is bounded and Add()
+				 waits for the writer if the disk falls that far behind.
+
+				 Optionally payloads can be deduplicated: a payload identical to one already
+				 in the file (and still in a bounded cache of recent payloads) is not written
+				 again, Add() returns the offset of the earlier copy instead. Such duplicates
+				 have no record of their own in the blog - only the alog refers to them.
+
+				 Records reach the OS with every batch - when they are also synced to the disk
+				 is set by a CLogDurability policy.
+*/
+
+class CBinaryLog
+	{
+	public:
+		CBinaryLog();
+		~CBinaryLog();
+
+		/*!
+		 @function   Open
+		 @abstract   open the named file and start the writing thread
+		 @param bDedup store repeated payloads once
+		 */
+		bool Open(const std::string & sFileName, bool bDedup = false);
+
+		/*!
+		 @function   Close
+		 @abstract   write everything queued and close the file (blocking)
+		 */
+		bool Close();
+
+		bool IsOpen();
+
+		/*!
+		 @function   SetDedupCacheSize
+		 @abstract   how many bytes of recent payloads are kept to find duplicates in
+		 */
+		void SetDedupCacheSize(size_t nBytes);
+
+		/** when the writer thread syncs the file, set before Open() */
+		void SetDurability(const CLogDurability & Policy);
+
+		/** the time before which everything added is committed (see CLogDurability) */
+		double GetDurableTime();
+
+		/** how long each batch write and commit took */
+		CLatencyHistogram & GetWriteLatency();
+
+		/*!
+		 @function   Add
+		 @abstract   queue a record, returning the offset in the file at which its payload starts
+		 @param pHeader,nHeader the text written in front of the payload
+		 @param Payload the binary data
+		 */
+		unsigned long long Add(const char * pHeader, size_t nHeader, const std::string & Payload);
+
+		/** how many bytes have been queued for the file */
+		unsigned long long GetSize();
+
+		/** how many payload bytes were not written because they were duplicates */
+		unsigned long long GetDuplicateBytes();
+
+		//worker function
+		bool DoWriting();
+
+	protected:
+
+		/** swap queues and write whatever was there */
+		bool WriteQueued();
+
+		/** sync the file if the durability policy asks for it */
+		bool Commit();
+
+		/** the offset of an identical payload already written, or -1 */
+		long long FindDuplicate(const std::string & Payload, unsigned long long nHash);
+
+		/** remember a payload just queued at nOffset */
+		void RememberPayload(const std::string & Payload, unsigned long long nHash, unsigned long long nOffset);
+
+		CMOOSLock   m_Lock;
+		CMOOSThread m_Thread;
+
+		CLogSignal m_DataSignal;
+		CLogSignal m_SpaceSignal;
+
+		//pieces to be written - the mail thread fills the front, the writer empties the back
+		std::vector<std::string> m_Front;
+		std::vector<std::string> m_Back;
+		size_t m_nQueuedBytes;
+		size_t m_nCapacity;
+
+		std::string m_sFileName;
+		int m_nFile;
+		bool m_bOpen;
+		CLogDurability m_Durability;
+		CLatencyHistogram m_WriteLatency;
+
+		//where the next record will start (mail thread only)
+		unsigned long long m_nOffset;
+
+		//dedup state (mail thread only)
+		struct CachedPayload
+		{
+			unsigned long long nOffset;
+			std::string Data;
+		};
+		bool m_bDedup;
+		std::multimap<unsigned long long, CachedPayload> m_Payloads;
+		std::deque<std::multimap<unsigned long long, CachedPayload>::iterator> m_PayloadAge;
+		size_t m_nCachedBytes;
+		size_t m_nCacheLimit;
+		unsigned long long m_nDuplicateBytes;
+
+	private:
+		CBinaryLog(const CBinaryLog &);
+		CBinaryLog & operator=(const CBinaryLog &);
+	};
+
+#endif
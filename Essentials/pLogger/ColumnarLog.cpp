@@ -0,0 +1,368 @@
+/*
+ *  ColumnarLog.cpp
+ *  MOOS
+ *
+ */
+
+#include "ColumnarLog.h"
+#include <cmath>
+#include <cstring>
+
+#define CLOG_MAGIC "MOOSCLOG"
+#define CLOG_END_MAGIC "CLOGEND!"
+#define CLOG_VERSION 1
+
+//a column is written as a chunk when it has this many entries...
+#define CLOG_CHUNK_ENTRIES 4096
+//...or this many bytes...
+#define CLOG_CHUNK_BYTES (256*1024)
+//...or its first entry is this old (seconds) so quiet variables still reach the disk
+#define CLOG_CHUNK_MAX_AGE 30.0
+
+//only short strings are worth putting in the dictionary
+#define CLOG_MAX_DICTIONARY_STRING 256
+//and the dictionary itself is bounded
+#define CLOG_MAX_DICTIONARY_ENTRIES 65536
+#define CLOG_MAX_DICTIONARY_BYTES (8*1024*1024)
+
+
+namespace
+{
+	void PutU8(std::string & Out, unsigned int n)
+	{
+		Out.push_back((char)(n&0xFF));
+	}
+
+	void PutU32(std::string & Out, unsigned int n)
+	{
+		for(int i = 0;i<4;i++)
+			Out.push_back((char)((n>>(8*i))&0xFF));
+	}
+
+	void PutU64(std::string & Out, unsigned long long n)
+	{
+		for(int i = 0;i<8;i++)
+			Out.push_back((char)((n>>(8*i))&0xFF));
+	}
+
+	void PutF64(std::string & Out, double df)
+	{
+		unsigned long long n;
+		memcpy(&n, &df, sizeof(n));
+		PutU64(Out, n);
+	}
+
+	void PutVarint(std::string & Out, unsigned long long n)
+	{
+		while(n>=0x80)
+		{
+			Out.push_back((char)((n&0x7F)|0x80));
+			n>>=7;
+		}
+		Out.push_back((char)n);
+	}
+
+	void PutZigZag(std::string & Out, long long n)
+	{
+		PutVarint(Out, ((unsigned long long)n<<1)^(unsigned long long)(n>>63));
+	}
+
+	void PutBytes(std::string & Out, const std::string & sBytes)
+	{
+		PutVarint(Out, sBytes.size());
+		Out.append(sBytes);
+	}
+
+	long long ToMicros(double dfTime)
+	{
+		return (long long)std::floor(dfTime*1e6+0.5);
+	}
+}
+
+
+CColumnarLog::CColumnarLog()
+{
+	m_bOpen = false;
+	m_nOffset = 0;
+	m_nNextVariableID = 1;
+	m_nNextStringID = 1;
+	m_nFirstNewStringID = 1;
+	m_nDictionaryBytes = 0;
+	m_dfLastSweepTime = 0;
+}
+
+CColumnarLog::~CColumnarLog()
+{
+	Close();
+}
+
+bool CColumnarLog::IsOpen()
+{
+	return m_bOpen;
+}
+
+unsigned long long CColumnarLog::GetSize()
+{
+	return m_nOffset;
+}
+
+void CColumnarLog::SetBackend(CLogFile::Mode eMode, size_t nExtent)
+{
+	m_Writer.SetBackend(eMode, nExtent);
+}
+
+void CColumnarLog::SetDurability(const CLogDurability & Policy)
+{
+	m_Writer.SetDurability(Policy);
+}
+
+void CColumnarLog::SetStaging(size_t nCapacity, size_t nDrainSize)
+{
+	//blocks are never dropped - the directory at the end refers to them by offset
+	m_Writer.SetStaging(nCapacity, nDrainSize, CLogWriter::BLOCK);
+}
+
+double CColumnarLog::GetStagingFill()
+{
+	return m_Writer.GetStagingFill();
+}
+
+double CColumnarLog::GetDurableTime()
+{
+	return m_Writer.GetDurableTime();
+}
+
+CLatencyHistogram & CColumnarLog::GetWriteLatency()
+{
+	return m_Writer.GetWriteLatency();
+}
+
+bool CColumnarLog::Open(const std::string & sFileName, double dfAppStartTime)
+{
+	if(m_bOpen)
+		Close();
+
+	if(!m_Writer.Start(sFileName, true))
+		return false;
+
+	m_Columns.clear();
+	m_Dictionary.clear();
+	m_NewStrings.clear();
+	m_Directory.clear();
+	m_nNextVariableID = 1;
+	m_nNextStringID = 1;
+	m_nFirstNewStringID = 1;
+	m_nDictionaryBytes = 0;
+	m_dfLastSweepTime = 0;
+
+	std::string Header(CLOG_MAGIC);
+	PutU32(Header, CLOG_VERSION);
+	PutF64(Header, dfAppStartTime);
+	m_Writer.Push(Header);
+	m_nOffset = Header.size();
+
+	m_bOpen = true;
+	return true;
+}
+
+bool CColumnarLog::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	std::map<std::string, Column>::iterator q;
+	for(q = m_Columns.begin();q!=m_Columns.end();q++)
+	{
+		if(q->second.nEntries>0)
+			FlushColumn(q->second);
+	}
+
+	//the directory lets readers go straight to the chunks of one variable
+	unsigned long long nDirectoryOffset = m_nOffset;
+	m_Block.clear();
+	PutVarint(m_Block, m_Directory.size());
+	for(size_t i = 0;i<m_Directory.size();i++)
+	{
+		const ChunkInfo & rInfo = m_Directory[i];
+		PutVarint(m_Block, rInfo.nVariable);
+		PutU64(m_Block, rInfo.nOffset);
+		PutVarint(m_Block, rInfo.nEntries);
+		PutF64(m_Block, rInfo.dfFirstTime);
+		PutF64(m_Block, rInfo.dfLastTime);
+	}
+	WriteBlock('X', m_Block);
+
+	std::string Footer;
+	PutU64(Footer, nDirectoryOffset);
+	Footer.append(CLOG_END_MAGIC);
+	m_Writer.Push(Footer);
+
+	m_bOpen = false;
+	return m_Writer.Stop();
+}
+
+bool CColumnarLog::Add(const CMOOSMsg & rMsg, double dfTime, const std::string & sSource)
+{
+	if(!m_bOpen)
+		return false;
+
+	std::map<std::string, Column>::iterator q = m_Columns.find(rMsg.m_sKey);
+	if(q==m_Columns.end())
+	{
+		//a new variable - declare it before any chunk refers to it
+		Column NewColumn;
+		NewColumn.nID = m_nNextVariableID++;
+		NewColumn.nEntries = 0;
+		NewColumn.dfFirstTime = 0;
+		NewColumn.dfLastTime = 0;
+		NewColumn.nLastMicros = 0;
+		q = m_Columns.insert(std::make_pair(rMsg.m_sKey, NewColumn)).first;
+
+		m_Block.clear();
+		PutVarint(m_Block, NewColumn.nID);
+		m_Block.append(rMsg.m_sKey);
+		WriteBlock('V', m_Block);
+	}
+
+	Column & rColumn = q->second;
+
+	long long nMicros = ToMicros(dfTime);
+	if(rColumn.nEntries==0)
+	{
+		rColumn.dfFirstTime = dfTime;
+	}
+	else
+	{
+		PutZigZag(rColumn.Times, nMicros-rColumn.nLastMicros);
+	}
+	rColumn.nLastMicros = nMicros;
+	rColumn.dfLastTime = dfTime;
+
+	//a source too long for (or arriving after a full) dictionary goes inline like a string value
+	unsigned int nSourceID = GetStringID(sSource);
+	PutVarint(rColumn.Sources, nSourceID);
+	if(nSourceID==0)
+		PutBytes(rColumn.Sources, sSource);
+
+	if(rMsg.IsDataType(MOOS_DOUBLE))
+	{
+		PutU8(rColumn.Types, 'D');
+		PutF64(rColumn.Doubles, rMsg.m_dfVal);
+	}
+	else if(rMsg.IsDataType(MOOS_BINARY_STRING))
+	{
+		PutU8(rColumn.Types, 'B');
+		PutBytes(rColumn.Binaries, rMsg.m_sVal);
+	}
+	else
+	{
+		PutU8(rColumn.Types, 'S');
+		unsigned int nStringID = GetStringID(rMsg.m_sVal);
+		PutVarint(rColumn.Strings, nStringID);
+		if(nStringID==0)
+			PutBytes(rColumn.Strings, rMsg.m_sVal);
+	}
+
+	rColumn.nEntries++;
+
+	size_t nBytes = rColumn.Times.size()+rColumn.Doubles.size()+rColumn.Strings.size()+rColumn.Binaries.size()+rColumn.Sources.size();
+	if(rColumn.nEntries>=CLOG_CHUNK_ENTRIES || nBytes>=CLOG_CHUNK_BYTES)
+	{
+		FlushColumn(rColumn);
+	}
+
+	//every now and then write out columns which have gone quiet
+	if(dfTime-m_dfLastSweepTime>1.0)
+	{
+		m_dfLastSweepTime = dfTime;
+		for(q = m_Columns.begin();q!=m_Columns.end();q++)
+		{
+			if(q->second.nEntries>0 && dfTime-q->second.dfFirstTime>CLOG_CHUNK_MAX_AGE)
+				FlushColumn(q->second);
+		}
+	}
+
+	return true;
+}
+
+unsigned int CColumnarLog::GetStringID(const std::string & sStr)
+{
+	if(sStr.size()>CLOG_MAX_DICTIONARY_STRING)
+		return 0;
+
+	std::map<std::string, unsigned int>::iterator q = m_Dictionary.find(sStr);
+	if(q!=m_Dictionary.end())
+		return q->second;
+
+	if(m_Dictionary.size()>=CLOG_MAX_DICTIONARY_ENTRIES || m_nDictionaryBytes>=CLOG_MAX_DICTIONARY_BYTES)
+		return 0;
+
+	//new entry - it is written out ahead of the next chunk (which is the first that can use it)
+	q = m_Dictionary.insert(std::make_pair(sStr, m_nNextStringID++)).first;
+	m_NewStrings.push_back(&q->first);
+	m_nDictionaryBytes+=sStr.size();
+
+	return q->second;
+}
+
+void CColumnarLog::FlushDictionary()
+{
+	if(m_NewStrings.empty())
+		return;
+
+	m_Block.clear();
+	PutVarint(m_Block, m_nFirstNewStringID);
+	PutVarint(m_Block, m_NewStrings.size());
+	for(size_t i = 0;i<m_NewStrings.size();i++)
+	{
+		PutBytes(m_Block, *m_NewStrings[i]);
+	}
+	WriteBlock('S', m_Block);
+
+	m_NewStrings.clear();
+	m_nFirstNewStringID = m_nNextStringID;
+}
+
+void CColumnarLog::FlushColumn(Column & rColumn)
+{
+	FlushDictionary();
+
+	ChunkInfo Info;
+	Info.nVariable = rColumn.nID;
+	Info.nOffset = m_nOffset;
+	Info.nEntries = rColumn.nEntries;
+	Info.dfFirstTime = rColumn.dfFirstTime;
+	Info.dfLastTime = rColumn.dfLastTime;
+	m_Directory.push_back(Info);
+
+	m_Block.clear();
+	PutVarint(m_Block, rColumn.nID);
+	PutVarint(m_Block, rColumn.nEntries);
+	PutF64(m_Block, rColumn.dfFirstTime);
+	m_Block.append(rColumn.Times);
+	m_Block.append(rColumn.Types);
+	m_Block.append(rColumn.Sources);
+	m_Block.append(rColumn.Doubles);
+	m_Block.append(rColumn.Strings);
+	m_Block.append(rColumn.Binaries);
+	WriteBlock('C', m_Block);
+
+	rColumn.nEntries = 0;
+	rColumn.Times.clear();
+	rColumn.Types.clear();
+	rColumn.Sources.clear();
+	rColumn.Doubles.clear();
+	rColumn.Strings.clear();
+	rColumn.Binaries.clear();
+}
+
+void CColumnarLog::WriteBlock(char cType, const std::string & Payload)
+{
+	m_Framed.clear();
+	PutU8(m_Framed, (unsigned char)cType);
+	PutU32(m_Framed, (unsigned int)Payload.size());
+	m_Framed.append(Payload);
+
+	m_Writer.Push(m_Framed);
+	m_nOffset+=m_Framed.size();
+}
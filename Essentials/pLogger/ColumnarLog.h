@@ -0,0 +1,168 @@
+/*
+ *  ColumnarLog.h
+ *  MOOS
+ *
+ */
+
+#ifndef CCOLUMNARLOGH
+#define CCOLUMNARLOGH
+
+#include <map>
+#include <string>
+#include <vector>
+#include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "LogWriter.h"
+
+
+/*!
+    @class   CColumnarLog
+    @abstract    Writes a binary, column oriented log (.clog) of asynchronous mail
+    @discussion  Each variable accumulates its own column which is written as a self contained
+				 chunk once it is full (or old). Analysis tools can then read one variable without
+				 parsing any other and without any text conversion.
+
+				 All integers are little endian, "varint" is LEB128 and "zigzag" maps signed to
+				 unsigned varints. The file is
+
+				 "MOOSCLOG" u32 version f64 app-start-time
+				 then a sequence of blocks, each u8 type, u32 payload length, payload:
+				   'V' variable      : varint id, name bytes
+				   'S' dictionary    : varint first id, varint count, count x (varint length, bytes)
+				   'C' column chunk  : varint variable id, varint n,
+									   f64 first time (seconds since app start),
+									   (n-1) x zigzag time delta in microseconds,
+									   n x u8 type ('D' double, 'S' string, 'B' binary),
+									   n x varint source id (0 means a varint length and
+									   the bytes follow inline),
+									   f64 for each double,
+									   varint string id for each string (0 means a varint
+									   length and the bytes follow inline),
+									   varint length and bytes for each binary
+				 and finally a chunk directory
+				   'X' directory     : varint count, count x (varint variable id, u64 block offset,
+									   varint n, f64 first time, f64 last time)
+				 followed by u64 offset of the directory block and "CLOGEND!".
+
+				 Dictionary ids start at 1 and every id is defined by an 'S' block before first use.
+				 A file which was never closed has no directory but can still be read by walking
+				 the blocks from the start.
+*/
+
+class CColumnarLog
+	{
+	public:
+		CColumnarLog();
+		~CColumnarLog();
+
+		/*!
+		 @function   Open
+		 @abstract   start a new clog file
+		 @param sFileName name of the file
+		 @param dfAppStartTime written in the header, times are stored relative to it
+		 */
+		bool Open(const std::string & sFileName, double dfAppStartTime);
+
+		/*!
+		 @function   Close
+		 @abstract   write out all part filled columns and the directory and close the file
+		 */
+		bool Close();
+
+		bool IsOpen();
+
+		/** how many bytes have been written (queued) so far */
+		unsigned long long GetSize();
+
+		/** how the file is written (see CLogFile), set before Open() */
+		void SetBackend(CLogFile::Mode eMode, size_t nExtent = 0);
+
+		/** when the file is committed (see CLogDurability), set before Open() */
+		void SetDurability(const CLogDurability & Policy);
+
+		/** how much is staged in RAM on the way to disk (see CLogWriter), set before Open() */
+		void SetStaging(size_t nCapacity, size_t nDrainSize);
+
+		/** the fraction (0 to 1) of the staging buffer in use */
+		double GetStagingFill();
+
+		/** the time before which everything added is committed */
+		double GetDurableTime();
+
+		/** how long each write and commit to the file took */
+		CLatencyHistogram & GetWriteLatency();
+
+		/*!
+		 @function   Add
+		 @abstract   add a message to its variable's column
+		 @param rMsg the message
+		 @param dfTime time of the message relative to app start
+		 @param sSource the source string as it should be recorded
+		 */
+		bool Add(const CMOOSMsg & rMsg, double dfTime, const std::string & sSource);
+
+	protected:
+
+		struct Column
+		{
+			unsigned int nID;
+			unsigned int nEntries;
+			double dfFirstTime;
+			double dfLastTime;
+			long long nLastMicros;
+			std::string Times;
+			std::string Types;
+			std::string Sources;
+			std::string Doubles;
+			std::string Strings;
+			std::string Binaries;
+		};
+
+		struct ChunkInfo
+		{
+			unsigned int nVariable;
+			unsigned long long nOffset;
+			unsigned int nEntries;
+			double dfFirstTime;
+			double dfLastTime;
+		};
+
+		/** write a column as a chunk block and reset it */
+		void FlushColumn(Column & rColumn);
+
+		/** write any dictionary entries defined since the last block */
+		void FlushDictionary();
+
+		/** returns the dictionary id of a string, defining it if needed (0 if not dictionary encoded) */
+		unsigned int GetStringID(const std::string & sStr);
+
+		/** frame a block and hand it to the writer */
+		void WriteBlock(char cType, const std::string & Payload);
+
+		CLogWriter m_Writer;
+		bool m_bOpen;
+
+		//bytes handed to the writer so far - ie the file offset of the next block
+		unsigned long long m_nOffset;
+
+		std::map<std::string, Column> m_Columns;
+		unsigned int m_nNextVariableID;
+
+		std::map<std::string, unsigned int> m_Dictionary;
+		unsigned int m_nNextStringID;
+		size_t m_nDictionaryBytes;
+
+		//strings given ids but not yet written to the file
+		std::vector<const std::string *> m_NewStrings;
+		unsigned int m_nFirstNewStringID;
+
+		//when we last looked for columns which have gone quiet
+		double m_dfLastSweepTime;
+
+		std::vector<ChunkInfo> m_Directory;
+
+		//scratch space reused for every block
+		std::string m_Block;
+		std::string m_Framed;
+	};
+
+#endif
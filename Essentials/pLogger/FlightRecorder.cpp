@@ -0,0 +1,370 @@
+/*
+ *  FlightRecorder.cpp
+ *  MOOS
+ *
+ */
+
+#include "FlightRecorder.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "LogFile.h"
+#include "BinaryLog.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//a record is its length (4 bytes), time (8), data type (1), key and source
+//lengths (2 each) and value length (4) followed by the key, source and value
+#define FLIGHT_RECORD_HEADER 21
+
+//the ring size if only a time limit is given
+#define FLIGHT_RECORDER_DEFAULT_SIZE (64*1024*1024)
+
+//records bigger than this fraction of the ring are not kept - one huge binary
+//message would otherwise wipe out everything else
+#define FLIGHT_RECORDER_MAX_RECORD_FRACTION 4
+
+//how much of a snapshot's alog is formatted before it is written
+#define FLIGHT_RECORDER_WRITE_CHUNK (1024*1024)
+
+
+bool _FlightRecorderThreadWorker(void * pParam)
+{
+	CFlightRecorder* pMe = (CFlightRecorder*) pParam;
+	return pMe->DoDump();
+}
+
+CFlightRecorder::CFlightRecorder()
+{
+	m_nCapacity = 0;
+	m_dfSpan = 0;
+	m_nHead = 0;
+	m_nTail = 0;
+	m_nWrapAt = 0;
+	m_bWrapped = false;
+	m_nRecords = 0;
+	m_nBytes = 0;
+	m_dfNewest = 0;
+	m_bMarkDataType = false;
+	m_nDoublePrecision = 5;
+	m_dfDumpStartTime = 0;
+}
+
+CFlightRecorder::~CFlightRecorder()
+{
+	//let a snapshot being written finish
+	m_Thread.Stop();
+}
+
+bool CFlightRecorder::Parse(const std::string & sLimits)
+{
+	std::string sRest = sLimits;
+	MOOSRemoveChars(sRest," \t");
+	MOOSToUpper(sRest);
+
+	double dfSpan = 0;
+	size_t nCapacity = 0;
+	while(!sRest.empty())
+	{
+		std::string sLimit = MOOSChomp(sRest,",");
+
+		char * pUnit = NULL;
+		double dfValue = strtod(sLimit.c_str(),&pUnit);
+		std::string sUnit(pUnit);
+		if(pUnit==sLimit.c_str() || dfValue<=0)
+			return false;
+
+		if(sUnit=="S")
+			dfSpan = dfValue;
+		else if(sUnit=="MIN")
+			dfSpan = dfValue*60.0;
+		else if(sUnit=="MB")
+			nCapacity = (size_t)(dfValue*1024*1024);
+		else if(sUnit=="GB")
+			nCapacity = (size_t)(dfValue*1024*1024*1024);
+		else
+			return false;
+	}
+
+	if(nCapacity==0 && dfSpan<=0)
+		return false;
+
+	m_dfSpan = dfSpan;
+	m_nCapacity = nCapacity>0 ? nCapacity : FLIGHT_RECORDER_DEFAULT_SIZE;
+
+	//allocate (and touch) all of it now so recording never allocates
+	std::vector<char>(m_nCapacity).swap(m_Ring);
+	m_nHead = 0;
+	m_nTail = 0;
+	m_bWrapped = false;
+	m_nRecords = 0;
+	m_nBytes = 0;
+
+	return true;
+}
+
+bool CFlightRecorder::IsEnabled() const
+{
+	return m_nCapacity>0;
+}
+
+void CFlightRecorder::SetFormat(bool bMarkDataType, int nDoublePrecision)
+{
+	m_bMarkDataType = bMarkDataType;
+	m_nDoublePrecision = nDoublePrecision;
+}
+
+double CFlightRecorder::GetRecordTime(size_t nOffset) const
+{
+	double dfTime;
+	memcpy(&dfTime, &m_Ring[nOffset+4], sizeof(dfTime));
+	return dfTime;
+}
+
+void CFlightRecorder::DropOldest()
+{
+	unsigned int nLength;
+	memcpy(&nLength, &m_Ring[m_nHead], sizeof(nLength));
+
+	m_nHead+=nLength;
+	m_nBytes-=nLength;
+	m_nRecords--;
+
+	//past the last record before the wrap - the oldest is now at the start
+	if(m_bWrapped && m_nHead==m_nWrapAt)
+	{
+		m_nHead = 0;
+		m_bWrapped = false;
+	}
+}
+
+void CFlightRecorder::Add(const CMOOSMsg & rMsg, const std::string & sSource)
+{
+	if(!IsEnabled())
+		return;
+
+	const std::string & sKey = rMsg.m_sKey;
+	unsigned short nKey = (unsigned short)std::min(sKey.size(), (size_t)0xffff);
+	unsigned short nSource = (unsigned short)std::min(sSource.size(), (size_t)0xffff);
+	unsigned int nValue = rMsg.IsDouble() ? sizeof(double) : (unsigned int)rMsg.m_sVal.size();
+
+	size_t nLength = FLIGHT_RECORD_HEADER+nKey+nSource+nValue;
+	if(nLength>m_nCapacity/FLIGHT_RECORDER_MAX_RECORD_FRACTION)
+		return;
+
+	//make room for the record in one piece
+	for(;;)
+	{
+		if(m_nRecords==0)
+		{
+			m_nHead = 0;
+			m_nTail = 0;
+			m_bWrapped = false;
+		}
+
+		if(!m_bWrapped)
+		{
+			if(m_nCapacity-m_nTail>=nLength)
+				break;
+
+			//no room at the end - carry on from the start
+			m_nWrapAt = m_nTail;
+			m_nTail = 0;
+			m_bWrapped = true;
+		}
+		else if(m_nHead-m_nTail>=nLength)
+		{
+			break;
+		}
+		else
+		{
+			DropOldest();
+		}
+	}
+
+	char * pRecord = &m_Ring[m_nTail];
+	unsigned int nLength32 = (unsigned int)nLength;
+	double dfTime = rMsg.GetTime();
+	memcpy(pRecord, &nLength32, 4);
+	memcpy(pRecord+4, &dfTime, 8);
+	pRecord[12] = rMsg.m_cDataType;
+	memcpy(pRecord+13, &nKey, 2);
+	memcpy(pRecord+15, &nSource, 2);
+	memcpy(pRecord+17, &nValue, 4);
+	pRecord+=FLIGHT_RECORD_HEADER;
+
+	memcpy(pRecord, sKey.data(), nKey);
+	pRecord+=nKey;
+	memcpy(pRecord, sSource.data(), nSource);
+	pRecord+=nSource;
+	if(rMsg.IsDouble())
+		memcpy(pRecord, &rMsg.m_dfVal, sizeof(double));
+	else
+		memcpy(pRecord, rMsg.m_sVal.data(), nValue);
+
+	m_nTail+=nLength;
+	m_nBytes+=nLength;
+	m_nRecords++;
+
+	//and forget what has been held longer than we were asked to
+	if(dfTime>m_dfNewest)
+		m_dfNewest = dfTime;
+	while(m_dfSpan>0 && m_nRecords>1 && GetRecordTime(m_nHead)<m_dfNewest-m_dfSpan)
+		DropOldest();
+}
+
+bool CFlightRecorder::Snapshot(const std::string & sFileStem, const std::string & sBanner, double dfAppStartTime)
+{
+	if(!IsEnabled() || IsDumping())
+		return false;
+
+	//the copy is all the caller pays for - formatting and writing happen on the dump thread
+	m_Dump.clear();
+	if(m_nRecords>0)
+	{
+		if(!m_bWrapped)
+		{
+			m_Dump.insert(m_Dump.end(), m_Ring.begin()+m_nHead, m_Ring.begin()+m_nTail);
+		}
+		else
+		{
+			m_Dump.insert(m_Dump.end(), m_Ring.begin()+m_nHead, m_Ring.begin()+m_nWrapAt);
+			m_Dump.insert(m_Dump.end(), m_Ring.begin(), m_Ring.begin()+m_nTail);
+		}
+	}
+
+	m_sDumpStem = sFileStem;
+	m_sDumpBanner = sBanner;
+	m_dfDumpStartTime = dfAppStartTime;
+
+	m_Thread.Initialise(_FlightRecorderThreadWorker, this);
+	return m_Thread.Start();
+}
+
+bool CFlightRecorder::IsDumping()
+{
+	return m_Thread.IsThreadRunning();
+}
+
+double CFlightRecorder::GetSpan() const
+{
+	return m_nRecords>0 ? m_dfNewest-GetRecordTime(m_nHead) : 0;
+}
+
+size_t CFlightRecorder::GetSize() const
+{
+	return m_nBytes;
+}
+
+double CFlightRecorder::GetFill() const
+{
+	return m_nCapacity>0 ? (double)m_nBytes/m_nCapacity : 0;
+}
+
+bool CFlightRecorder::DoDump()
+{
+	bool bOK = WriteDump();
+	if(!bOK)
+		std::cerr<<"failed writing snapshot "<<m_sDumpStem<<".alog\n";
+
+	//give the memory back - snapshots are rare
+	std::vector<char>().swap(m_Dump);
+
+	return bOK;
+}
+
+bool CFlightRecorder::WriteDump()
+{
+	CLogFile File;
+	if(!File.Open(m_sDumpStem+".alog", CLogFile::BUFFERED, 0, false))
+		return false;
+
+	if(!File.Write(m_sDumpBanner.data(), m_sDumpBanner.size()))
+		return false;
+
+	//binary payloads go to a blog alongside, opened if there are any
+	std::string sBlogName = m_sDumpStem+".blog";
+	std::string sBlogRef = sBlogName.substr(sBlogName.find_last_of("/\\")+1);
+	CBinaryLog BinaryLog;
+
+	bool bOK = true;
+	m_Encoder.Clear();
+	size_t nPosition = 0;
+	while(nPosition+FLIGHT_RECORD_HEADER<=m_Dump.size())
+	{
+		const char * pRecord = &m_Dump[nPosition];
+		unsigned int nLength;
+		double dfTime;
+		unsigned short nKey;
+		unsigned short nSource;
+		unsigned int nValue;
+		memcpy(&nLength, pRecord, 4);
+		memcpy(&dfTime, pRecord+4, 8);
+		char cType = pRecord[12];
+		memcpy(&nKey, pRecord+13, 2);
+		memcpy(&nSource, pRecord+15, 2);
+		memcpy(&nValue, pRecord+17, 4);
+		nPosition+=nLength;
+
+		const char * pKey = pRecord+FLIGHT_RECORD_HEADER;
+		const char * pSource = pKey+nKey;
+		const char * pValue = pSource+nSource;
+
+		//laid out exactly as DoAsyncLog lays out the alog
+		size_t nEntryStart = m_Encoder.Size();
+		m_Encoder.AppendFixed(dfTime-m_dfDumpStartTime,15,3);
+		m_Encoder.Append(' ');
+		m_Encoder.AppendPadded(std::string(pKey,nKey),20);
+		m_Encoder.Append(' ');
+		m_Encoder.AppendPadded(std::string(pSource,nSource),15);
+		m_Encoder.Append(' ');
+
+		if(cType==MOOS_DOUBLE)
+		{
+			double dfVal;
+			memcpy(&dfVal, pValue, sizeof(dfVal));
+			if(m_bMarkDataType)
+				m_Encoder.Append("D:");
+			m_Encoder.AppendFixed(dfVal,12,m_nDoublePrecision);
+			m_Encoder.Append(' ');
+		}
+		else if(cType==MOOS_BINARY_STRING)
+		{
+			if(!BinaryLog.IsOpen() && !BinaryLog.Open(sBlogName))
+				return false;
+
+			unsigned long long nOffset = BinaryLog.Add(m_Encoder.GetBuffer().data()+nEntryStart,
+				m_Encoder.Size()-nEntryStart, std::string(pValue,nValue));
+
+			m_Encoder.Append("<MOOS_BINARY>File=");
+			m_Encoder.Append(sBlogRef);
+			m_Encoder.Append(",Offset=");
+			m_Encoder.AppendInteger((long long)nOffset);
+			m_Encoder.Append(",Bytes=");
+			m_Encoder.AppendInteger((long long)nValue);
+			m_Encoder.Append("</MOOS_BINARY>");
+		}
+		else
+		{
+			if(m_bMarkDataType)
+				m_Encoder.Append("S:");
+			m_Encoder.Append(std::string(pValue,nValue));
+			m_Encoder.Append(' ');
+		}
+		m_Encoder.Append('\n');
+
+		if(m_Encoder.Size()>=FLIGHT_RECORDER_WRITE_CHUNK)
+		{
+			bOK = File.Write(m_Encoder.GetBuffer().data(), m_Encoder.Size()) && bOK;
+			m_Encoder.Clear();
+		}
+	}
+
+	bOK = File.Write(m_Encoder.GetBuffer().data(), m_Encoder.Size()) && bOK;
+	m_Encoder.Clear();
+
+	if(BinaryLog.IsOpen())
+		bOK = BinaryLog.Close() && bOK;
+
+	return File.Close() && bOK;
+}
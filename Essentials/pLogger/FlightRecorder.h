@@ -0,0 +1,126 @@
+/*
+ *  FlightRecorder.h
+ *  MOOS
+ *
+ */
+
+#ifndef CFLIGHTRECORDERH
+#define CFLIGHTRECORDERH
+
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include <string>
+#include <vector>
+#include "AlogEncoder.h"
+
+
+/*!
+    @class   CFlightRecorder
+    @abstract    Keeps the last few seconds (or megabytes) of all traffic in memory and writes it out on demand
+    @discussion  Every message the logger receives - whether or not it is logged - is added as
+				 a compact binary record to a preallocated ring. When the ring is full, or a
+				 record is older than the time limit, the oldest records are dropped. Nothing
+				 touches the disk until a snapshot is asked for.
+
+				 Snapshot() copies the ring (the only cost to the caller) and a background thread
+				 writes the copy out as an ordinary alog - with a blog alongside it if any
+				 binary messages were recorded - so the usual tools can read it.
+
+				 The limits are given as "N s", "N MB" or both ("60s,256MB"). Add() and Snapshot()
+				 must be called from the same thread.
+*/
+
+class CFlightRecorder
+	{
+	public:
+		CFlightRecorder();
+		~CFlightRecorder();
+
+		/*!
+		 @function   Parse
+		 @abstract   set the limits from "N s", "N MB" or "N s,N MB" and allocate the ring
+		 @discussion returns false (leaving the recorder as it was) if the string is not understood
+		 */
+		bool Parse(const std::string & sLimits);
+
+		/** is anything being recorded */
+		bool IsEnabled() const;
+
+		/*!
+		 @function   SetFormat
+		 @abstract   how values are written in snapshots (as the alog is written)
+		 @param bMarkDataType start values with D: or S:
+		 @param nDoublePrecision decimal places of doubles
+		 */
+		void SetFormat(bool bMarkDataType, int nDoublePrecision);
+
+		/** record a message, dropping the oldest records as needed */
+		void Add(const CMOOSMsg & rMsg, const std::string & sSource);
+
+		/*!
+		 @function   Snapshot
+		 @abstract   write what is recorded to sFileStem.alog (and .blog) from a background thread
+		 @param sBanner written at the top of the alog
+		 @param dfAppStartTime the time entries are written relative to
+		 @return false if the last snapshot is still being written
+		 */
+		bool Snapshot(const std::string & sFileStem, const std::string & sBanner, double dfAppStartTime);
+
+		/** is a snapshot being written */
+		bool IsDumping();
+
+		/** how many seconds of traffic are held */
+		double GetSpan() const;
+
+		/** how many bytes of records are held */
+		size_t GetSize() const;
+
+		/** the part of the ring the records use (0 to 1) */
+		double GetFill() const;
+
+		bool DoDump();
+
+	protected:
+
+		/** drop the oldest record */
+		void DropOldest();
+
+		/** the time of the record at nOffset */
+		double GetRecordTime(size_t nOffset) const;
+
+		/** format the records in m_Dump as alog lines (and blog records) */
+		bool WriteDump();
+
+		//the limits
+		size_t m_nCapacity;
+		double m_dfSpan;
+
+		//records are never split - live data is [m_nHead, m_nTail) or, when the
+		//ring has wrapped, [m_nHead, m_nWrapAt) followed by [0, m_nTail)
+		std::vector<char> m_Ring;
+		size_t m_nHead;
+		size_t m_nTail;
+		size_t m_nWrapAt;
+		bool m_bWrapped;
+		size_t m_nRecords;
+		size_t m_nBytes;
+		double m_dfNewest;
+
+		//how snapshots are formatted
+		bool m_bMarkDataType;
+		int m_nDoublePrecision;
+
+		//the copy being written by the dump thread
+		std::vector<char> m_Dump;
+		std::string m_sDumpStem;
+		std::string m_sDumpBanner;
+		double m_dfDumpStartTime;
+		CAlogEncoder m_Encoder;
+		CMOOSThread m_Thread;
+
+	private:
+		CFlightRecorder(const CFlightRecorder &);
+		CFlightRecorder & operator=(const CFlightRecorder &);
+	};
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ *  KeyTable.h
+ *  MOOS
+ *
+ */
+
+#ifndef CKEYTABLEH
+#define CKEYTABLEH
+
+#include <string>
+#include <vector>
+
+
+/*!
+    @class   CKeyTable
+    @abstract    A hash table from variable names to T
+    @discussion  The logger looks up the key of every message it receives. A std::map does
+				 that with O(log n) string compares, this does it with one hash of the key
+				 and (almost always) one compare. Open addressing with linear probing in a
+				 power of two sized table which doubles when it is 70% full.
+
+				 Entries can't be removed, only the whole table cleared - names the logger
+				 has seen stay seen. A pointer returned by Find() or Insert() is good until
+				 the next Insert() (which may grow the table).
+*/
+
+template <class T>
+class CKeyTable
+	{
+	public:
+		CKeyTable()
+		{
+			m_nUsed = 0;
+			m_Slots.resize(64);
+		}
+
+		/** the value stored under sKey or NULL */
+		T * Find(const std::string & sKey)
+		{
+			unsigned int nHash = Hash(sKey);
+			size_t nMask = m_Slots.size()-1;
+			for(size_t i = nHash&nMask;;i = (i+1)&nMask)
+			{
+				Slot & rSlot = m_Slots[i];
+				if(!rSlot.bUsed)
+					return NULL;
+				if(rSlot.nHash==nHash && rSlot.sKey==sKey)
+					return &rSlot.Value;
+			}
+		}
+
+		/** store Value under sKey (replacing any value already there) */
+		T & Insert(const std::string & sKey, const T & Value)
+		{
+			T * pExisting = Find(sKey);
+			if(pExisting!=NULL)
+			{
+				*pExisting = Value;
+				return *pExisting;
+			}
+
+			if(10*(m_nUsed+1)>7*m_Slots.size())
+				Grow();
+
+			Slot & rSlot = FreeSlot(Hash(sKey));
+			rSlot.bUsed = true;
+			rSlot.nHash = Hash(sKey);
+			rSlot.sKey = sKey;
+			rSlot.Value = Value;
+			m_nUsed++;
+			return rSlot.Value;
+		}
+
+		/** forget everything */
+		void Clear()
+		{
+			m_Slots.clear();
+			m_Slots.resize(64);
+			m_nUsed = 0;
+		}
+
+		size_t Size() const
+		{
+			return m_nUsed;
+		}
+
+	protected:
+		struct Slot
+		{
+			Slot() : bUsed(false), nHash(0), Value() {}
+			bool bUsed;
+			unsigned int nHash;
+			std::string sKey;
+			T Value;
+		};
+
+		//32 bit FNV-1a
+		static unsigned int Hash(const std::string & sKey)
+		{
+			unsigned int nHash = 2166136261U;
+			for(size_t i = 0;i<sKey.size();i++)
+			{
+				nHash^=(unsigned char)sKey[i];
+				nHash*=16777619U;
+			}
+			return nHash;
+		}
+
+		Slot & FreeSlot(unsigned int nHash)
+		{
+			size_t nMask = m_Slots.size()-1;
+			size_t i = nHash&nMask;
+			while(m_Slots[i].bUsed)
+				i = (i+1)&nMask;
+			return m_Slots[i];
+		}
+
+		void Grow()
+		{
+			std::vector<Slot> Old(m_Slots.size()*2);
+			Old.swap(m_Slots);
+			for(size_t i = 0;i<Old.size();i++)
+			{
+				if(!Old[i].bUsed)
+					continue;
+
+				Slot & rSlot = FreeSlot(Old[i].nHash);
+				rSlot.bUsed = true;
+				rSlot.nHash = Old[i].nHash;
+				rSlot.sKey.swap(Old[i].sKey);
+				rSlot.Value = Old[i].Value;
+			}
+		}
+
+		std::vector<Slot> m_Slots;
+		size_t m_nUsed;
+	};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ *  LatencyHistogram.cpp
+ *  MOOS
+ *
+ */
+
+#include "LatencyHistogram.h"
+#include <cmath>
+
+//the upper edge of the first bucket (seconds)
+#define LATENCY_HISTOGRAM_BASE 1e-6
+//buckets per doubling
+#define LATENCY_HISTOGRAM_STEPS 4
+
+
+CLatencyHistogram::CLatencyHistogram()
+{
+	Clear();
+}
+
+void CLatencyHistogram::Clear()
+{
+	m_Lock.Lock();
+	for(int i = 0;i<LATENCY_HISTOGRAM_BUCKETS;i++)
+		m_Counts[i] = 0;
+	m_nCount = 0;
+	m_dfMax = 0;
+	m_Lock.UnLock();
+}
+
+int CLatencyHistogram::GetBucket(double dfSeconds)
+{
+	if(dfSeconds<=LATENCY_HISTOGRAM_BASE)
+		return 0;
+
+	int nBucket = (int)ceil(LATENCY_HISTOGRAM_STEPS*log(dfSeconds/LATENCY_HISTOGRAM_BASE)/log(2.0))-1;
+	if(nBucket<0)
+		return 0;
+	if(nBucket>=LATENCY_HISTOGRAM_BUCKETS)
+		return LATENCY_HISTOGRAM_BUCKETS-1;
+	return nBucket;
+}
+
+double CLatencyHistogram::GetBucketLimit(int nBucket)
+{
+	return LATENCY_HISTOGRAM_BASE*pow(2.0,(nBucket+1)/(double)LATENCY_HISTOGRAM_STEPS);
+}
+
+void CLatencyHistogram::Add(double dfSeconds)
+{
+	int nBucket = GetBucket(dfSeconds);
+
+	m_Lock.Lock();
+	m_Counts[nBucket]++;
+	m_nCount++;
+	if(dfSeconds>m_dfMax)
+		m_dfMax = dfSeconds;
+	m_Lock.UnLock();
+}
+
+void CLatencyHistogram::MoveTo(CLatencyHistogram & Other)
+{
+	if(&Other==this)
+		return;
+
+	//take ours out first so the two locks are never held together
+	unsigned long long Counts[LATENCY_HISTOGRAM_BUCKETS];
+	m_Lock.Lock();
+	for(int i = 0;i<LATENCY_HISTOGRAM_BUCKETS;i++)
+	{
+		Counts[i] = m_Counts[i];
+		m_Counts[i] = 0;
+	}
+	unsigned long long nCount = m_nCount;
+	double dfMax = m_dfMax;
+	m_nCount = 0;
+	m_dfMax = 0;
+	m_Lock.UnLock();
+
+	if(nCount==0)
+		return;
+
+	Other.m_Lock.Lock();
+	for(int i = 0;i<LATENCY_HISTOGRAM_BUCKETS;i++)
+		Other.m_Counts[i]+=Counts[i];
+	Other.m_nCount+=nCount;
+	if(dfMax>Other.m_dfMax)
+		Other.m_dfMax = dfMax;
+	Other.m_Lock.UnLock();
+}
+
+unsigned long long CLatencyHistogram::GetCount()
+{
+	m_Lock.Lock();
+	unsigned long long nCount = m_nCount;
+	m_Lock.UnLock();
+	return nCount;
+}
+
+double CLatencyHistogram::GetPercentile(double dfFraction)
+{
+	m_Lock.Lock();
+
+	double dfResult = 0;
+	if(m_nCount>0)
+	{
+		//the smallest bucket with at least that fraction of the samples at or below it
+		unsigned long long nWanted = (unsigned long long)ceil(dfFraction*m_nCount);
+		if(nWanted<1)
+			nWanted = 1;
+
+		unsigned long long nSoFar = 0;
+		for(int i = 0;i<LATENCY_HISTOGRAM_BUCKETS;i++)
+		{
+			nSoFar+=m_Counts[i];
+			if(nSoFar>=nWanted)
+			{
+				dfResult = GetBucketLimit(i);
+				break;
+			}
+		}
+
+		//no point claiming more than was ever seen
+		if(dfResult>m_dfMax)
+			dfResult = m_dfMax;
+	}
+
+	m_Lock.UnLock();
+	return dfResult;
+}
+
+double CLatencyHistogram::GetMax()
+{
+	m_Lock.Lock();
+	double dfMax = m_dfMax;
+	m_Lock.UnLock();
+	return dfMax;
+}
@@ -0,0 +1,68 @@
+/*
+ *  LatencyHistogram.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLATENCYHISTOGRAMH
+#define CLATENCYHISTOGRAMH
+
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+
+
+/*!
+    @class   CLatencyHistogram
+    @abstract    A thread safe histogram of durations from which percentiles can be read
+    @discussion  Buckets are logarithmic - four to every doubling from a microsecond up to a
+				 couple of minutes - so a percentile is known to within 20% whatever its size
+				 and adding a sample is a couple of arithmetic operations and a lock. The largest
+				 sample is kept exactly.
+
+				 Writer threads each keep one and Add() to it, whoever reports takes the samples
+				 out with MoveTo() so that reports cover the time since the last.
+*/
+
+#define LATENCY_HISTOGRAM_BUCKETS 112
+
+class CLatencyHistogram
+	{
+	public:
+		CLatencyHistogram();
+
+		/** record a duration in seconds */
+		void Add(double dfSeconds);
+
+		/** add all our samples to Other and forget them here */
+		void MoveTo(CLatencyHistogram & Other);
+
+		/** forget all samples */
+		void Clear();
+
+		/** how many samples */
+		unsigned long long GetCount();
+
+		/** the duration (seconds) below which fraction dfFraction of the samples lie, 0 if there are none */
+		double GetPercentile(double dfFraction);
+
+		/** the longest duration (seconds), 0 if there are none */
+		double GetMax();
+
+	protected:
+
+		/** the bucket a duration belongs in */
+		static int GetBucket(double dfSeconds);
+
+		/** the upper edge (seconds) of a bucket */
+		static double GetBucketLimit(int nBucket);
+
+		CMOOSLock m_Lock;
+		unsigned long long m_Counts[LATENCY_HISTOGRAM_BUCKETS];
+		unsigned long long m_nCount;
+		double m_dfMax;
+
+	private:
+		CLatencyHistogram(const CLatencyHistogram &);
+		CLatencyHistogram & operator=(const CLatencyHistogram &);
+	};
+
+#endif
@@ -0,0 +1,499 @@
+/*
+ *  LogCodec.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogCodec.h"
+#include "LogDurability.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
+#ifdef ZSTD_FOUND
+#include <zstd.h>
+#endif
+
+#ifdef LZ4_FOUND
+#include <lz4frame.h>
+//lz4 frames are compressed this much at a time
+#define LZ4_CODEC_CHUNK (64*1024)
+#endif
+
+
+CLogCodec::CLogCodec(int nLevel)
+{
+	m_nLevel = nLevel;
+}
+
+CLogCodec::~CLogCodec()
+{
+}
+
+
+#ifdef ZLIB_FOUND
+/*
+ gzip through zlib's gz* interface, exactly the format pLogger has always written
+ */
+class CGzipCodec : public CLogCodec
+	{
+	public:
+		CGzipCodec(int nLevel) : CLogCodec(nLevel<0 ? Z_DEFAULT_COMPRESSION : nLevel)
+		{
+			m_File = NULL;
+		}
+
+		~CGzipCodec()
+		{
+			Close();
+		}
+
+		std::string GetName(){return "gzip";};
+		std::string GetExtension(){return ".gz";};
+		bool StartsMember(){return false;};
+
+		bool Open(const std::string & sFileName)
+		{
+			Close();
+
+			char sMode[8];
+			if(m_nLevel==Z_DEFAULT_COMPRESSION)
+				strcpy(sMode,"wb");
+			else
+				sprintf(sMode,"wb%d",m_nLevel);
+
+			m_sFileName = sFileName;
+			m_File = gzopen(sFileName.c_str(),sMode);
+			return m_File!=NULL;
+		}
+
+		bool Write(const char * pData, size_t nBytes)
+		{
+			if(m_File==NULL)
+				return false;
+
+			if(gzwrite(m_File, pData, (unsigned int)nBytes)<=0)
+			{
+				int nError;
+				fprintf(stderr,"gzwrite failed: %s\n",gzerror(m_File,&nError));
+				return false;
+			}
+			return true;
+		}
+
+		bool Flush()
+		{
+			return m_File!=NULL && gzflush(m_File, Z_SYNC_FLUSH)==Z_OK;
+		}
+
+		bool Sync()
+		{
+			//zlib keeps its descriptor to itself - sync the file through one of our own
+			return Flush() && CLogDurability::SyncFile(m_sFileName);
+		}
+
+		bool Restart(unsigned long long & nCompressedOffset)
+		{
+#if ZLIB_VERNUM >= 0x1240
+			//a full flush means nothing after this point refers back before it
+			//so a raw inflate can start here
+			if(m_File==NULL || gzflush(m_File, Z_FULL_FLUSH)!=Z_OK)
+				return false;
+			nCompressedOffset = gzoffset(m_File);
+			return true;
+#else
+			(void)nCompressedOffset;
+			return false;
+#endif
+		}
+
+		unsigned long long GetCompressedSize()
+		{
+#if ZLIB_VERNUM >= 0x1240
+			if(m_File!=NULL)
+				return gzoffset(m_File);
+#endif
+			return 0;
+		}
+
+		bool Close()
+		{
+			if(m_File==NULL)
+				return true;
+			bool bOK = gzclose(m_File)==Z_OK;
+			m_File = NULL;
+			return bOK;
+		}
+
+		bool CompressBlock(const std::string & Input, std::string & Output)
+		{
+			z_stream Stream;
+			memset(&Stream, 0, sizeof(Stream));
+
+			//windowBits of 15+16 asks for a gzip header and trailer (with crc)
+			if(deflateInit2(&Stream, m_nLevel, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY)!=Z_OK)
+				return false;
+
+			Output.resize(deflateBound(&Stream, Input.size())+32);
+
+			Stream.next_in = (Bytef*)Input.data();
+			Stream.avail_in = (uInt)Input.size();
+			Stream.next_out = (Bytef*)&Output[0];
+			Stream.avail_out = (uInt)Output.size();
+
+			int nResult = deflate(&Stream, Z_FINISH);
+
+			Output.resize(Stream.total_out);
+			deflateEnd(&Stream);
+
+			return nResult==Z_STREAM_END;
+		}
+
+	protected:
+		gzFile m_File;
+		std::string m_sFileName;
+	};
+#endif
+
+
+#ifdef ZSTD_FOUND
+/*
+ zstd frames with content checksums, readable with "zstd -d"
+ */
+class CZstdCodec : public CLogCodec
+	{
+	public:
+		CZstdCodec(int nLevel) : CLogCodec(nLevel<0 ? ZSTD_CLEVEL_DEFAULT : nLevel)
+		{
+			m_pContext = NULL;
+			m_pFile = NULL;
+			m_nWritten = 0;
+		}
+
+		~CZstdCodec()
+		{
+			Close();
+			if(m_pContext!=NULL)
+				ZSTD_freeCCtx(m_pContext);
+		}
+
+		std::string GetName(){return "zstd";};
+		std::string GetExtension(){return ".zst";};
+		bool StartsMember(){return true;};
+		unsigned long long GetCompressedSize(){return m_nWritten;};
+
+		bool Open(const std::string & sFileName)
+		{
+			Close();
+
+			if(m_pContext==NULL)
+			{
+				m_pContext = ZSTD_createCCtx();
+				if(m_pContext==NULL)
+					return false;
+			}
+
+			ZSTD_CCtx_reset(m_pContext, ZSTD_reset_session_and_parameters);
+			ZSTD_CCtx_setParameter(m_pContext, ZSTD_c_compressionLevel, m_nLevel);
+			ZSTD_CCtx_setParameter(m_pContext, ZSTD_c_checksumFlag, 1);
+
+			m_Out.resize(ZSTD_CStreamOutSize());
+			m_nWritten = 0;
+
+			m_pFile = fopen(sFileName.c_str(),"wb");
+			return m_pFile!=NULL;
+		}
+
+		bool Write(const char * pData, size_t nBytes)
+		{
+			return Compress(pData, nBytes, ZSTD_e_continue);
+		}
+
+		bool Flush()
+		{
+			return Compress(NULL, 0, ZSTD_e_flush) && fflush(m_pFile)==0;
+		}
+
+		bool Sync()
+		{
+			return Flush() && CLogDurability::SyncFile(fileno(m_pFile));
+		}
+
+		bool Restart(unsigned long long & nCompressedOffset)
+		{
+			//ending the frame here means the next write starts a new one
+			if(!Compress(NULL, 0, ZSTD_e_end))
+				return false;
+			nCompressedOffset = m_nWritten;
+			return true;
+		}
+
+		bool Close()
+		{
+			if(m_pFile==NULL)
+				return true;
+			bool bOK = Compress(NULL, 0, ZSTD_e_end);
+			bOK = fclose(m_pFile)==0 && bOK;
+			m_pFile = NULL;
+			return bOK;
+		}
+
+		bool CompressBlock(const std::string & Input, std::string & Output)
+		{
+			Output.resize(ZSTD_compressBound(Input.size()));
+			size_t nSize = ZSTD_compress(&Output[0], Output.size(), Input.data(), Input.size(), m_nLevel);
+			if(ZSTD_isError(nSize))
+				return false;
+			Output.resize(nSize);
+			return true;
+		}
+
+	protected:
+
+		bool Compress(const char * pData, size_t nBytes, ZSTD_EndDirective eMode)
+		{
+			if(m_pFile==NULL)
+				return false;
+
+			ZSTD_inBuffer In = {pData, nBytes, 0};
+			for(;;)
+			{
+				ZSTD_outBuffer Out = {&m_Out[0], m_Out.size(), 0};
+				size_t nRemaining = ZSTD_compressStream2(m_pContext, &Out, &In, eMode);
+				if(ZSTD_isError(nRemaining))
+				{
+					fprintf(stderr,"zstd compression failed: %s\n",ZSTD_getErrorName(nRemaining));
+					return false;
+				}
+
+				if(Out.pos>0)
+				{
+					if(fwrite(Out.dst, 1, Out.pos, m_pFile)!=Out.pos)
+						return false;
+					m_nWritten+=Out.pos;
+				}
+
+				//continue is done when the input is used up, flush and end when nothing is left inside
+				if(eMode==ZSTD_e_continue ? In.pos==In.size : nRemaining==0)
+					return true;
+			}
+		}
+
+		ZSTD_CCtx * m_pContext;
+		FILE * m_pFile;
+		std::string m_Out;
+		unsigned long long m_nWritten;
+	};
+#endif
+
+
+#ifdef LZ4_FOUND
+/*
+ lz4 frames with content checksums, readable with "lz4 -d". Very fast, modest ratio
+ */
+class CLz4Codec : public CLogCodec
+	{
+	public:
+		CLz4Codec(int nLevel) : CLogCodec(nLevel<0 ? 0 : nLevel)
+		{
+			m_pContext = NULL;
+			m_pFile = NULL;
+			m_nWritten = 0;
+			m_bInFrame = false;
+
+			memset(&m_Preferences, 0, sizeof(m_Preferences));
+			m_Preferences.compressionLevel = m_nLevel;
+			m_Preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+		}
+
+		~CLz4Codec()
+		{
+			Close();
+			if(m_pContext!=NULL)
+				LZ4F_freeCompressionContext(m_pContext);
+		}
+
+		std::string GetName(){return "lz4";};
+		std::string GetExtension(){return ".lz4";};
+		bool StartsMember(){return true;};
+		unsigned long long GetCompressedSize(){return m_nWritten;};
+
+		bool Open(const std::string & sFileName)
+		{
+			Close();
+
+			if(m_pContext==NULL && LZ4F_isError(LZ4F_createCompressionContext(&m_pContext, LZ4F_VERSION)))
+			{
+				m_pContext = NULL;
+				return false;
+			}
+
+			m_Out.resize(LZ4F_compressBound(LZ4_CODEC_CHUNK, &m_Preferences)+LZ4F_HEADER_SIZE_MAX);
+			m_nWritten = 0;
+			m_bInFrame = false;
+
+			m_pFile = fopen(sFileName.c_str(),"wb");
+			return m_pFile!=NULL;
+		}
+
+		bool Write(const char * pData, size_t nBytes)
+		{
+			if(m_pFile==NULL)
+				return false;
+
+			if(!m_bInFrame)
+			{
+				if(!Output(LZ4F_compressBegin(m_pContext, &m_Out[0], m_Out.size(), &m_Preferences)))
+					return false;
+				m_bInFrame = true;
+			}
+
+			while(nBytes>0)
+			{
+				size_t nChunk = nBytes<LZ4_CODEC_CHUNK ? nBytes : LZ4_CODEC_CHUNK;
+				if(!Output(LZ4F_compressUpdate(m_pContext, &m_Out[0], m_Out.size(), pData, nChunk, NULL)))
+					return false;
+				pData+=nChunk;
+				nBytes-=nChunk;
+			}
+			return true;
+		}
+
+		bool Flush()
+		{
+			if(m_pFile==NULL)
+				return false;
+			if(m_bInFrame && !Output(LZ4F_flush(m_pContext, &m_Out[0], m_Out.size(), NULL)))
+				return false;
+			return fflush(m_pFile)==0;
+		}
+
+		bool Sync()
+		{
+			return Flush() && CLogDurability::SyncFile(fileno(m_pFile));
+		}
+
+		bool Restart(unsigned long long & nCompressedOffset)
+		{
+			if(m_pFile==NULL || !EndFrame())
+				return false;
+			nCompressedOffset = m_nWritten;
+			return true;
+		}
+
+		bool Close()
+		{
+			if(m_pFile==NULL)
+				return true;
+			bool bOK = EndFrame();
+			bOK = fclose(m_pFile)==0 && bOK;
+			m_pFile = NULL;
+			return bOK;
+		}
+
+		bool CompressBlock(const std::string & Input, std::string & Output)
+		{
+			//a copy so that concurrent callers share nothing
+			LZ4F_preferences_t Preferences = m_Preferences;
+			Preferences.frameInfo.contentSize = Input.size();
+
+			Output.resize(LZ4F_compressFrameBound(Input.size(), &Preferences));
+			size_t nSize = LZ4F_compressFrame(&Output[0], Output.size(), Input.data(), Input.size(), &Preferences);
+			if(LZ4F_isError(nSize))
+				return false;
+			Output.resize(nSize);
+			return true;
+		}
+
+	protected:
+
+		bool EndFrame()
+		{
+			if(!m_bInFrame)
+				return true;
+			m_bInFrame = false;
+			return Output(LZ4F_compressEnd(m_pContext, &m_Out[0], m_Out.size(), NULL));
+		}
+
+		/** write what an LZ4F call produced */
+		bool Output(size_t nSize)
+		{
+			if(LZ4F_isError(nSize))
+			{
+				fprintf(stderr,"lz4 compression failed: %s\n",LZ4F_getErrorName(nSize));
+				return false;
+			}
+			if(nSize>0 && fwrite(&m_Out[0], 1, nSize, m_pFile)!=nSize)
+				return false;
+			m_nWritten+=nSize;
+			return true;
+		}
+
+		LZ4F_compressionContext_t m_pContext;
+		LZ4F_preferences_t m_Preferences;
+		FILE * m_pFile;
+		std::string m_Out;
+		unsigned long long m_nWritten;
+		bool m_bInFrame;
+	};
+#endif
+
+
+CLogCodec * CLogCodec::Create(const std::string & sSpecification)
+{
+	std::string sName = sSpecification;
+	int nLevel = -1;
+
+	size_t nColon = sSpecification.find(':');
+	if(nColon!=std::string::npos)
+	{
+		sName = sSpecification.substr(0,nColon);
+		std::string sLevel = sSpecification.substr(nColon+1);
+		if(sLevel.empty() || sLevel.find_first_not_of("0123456789")!=std::string::npos)
+			return NULL;
+		nLevel = atoi(sLevel.c_str());
+	}
+
+	for(size_t i = 0;i<sName.size();i++)
+		sName[i] = (char)tolower(sName[i]);
+
+#ifdef ZLIB_FOUND
+	if(sName=="gzip" || sName=="gz" || sName=="zlib")
+		return new CGzipCodec(nLevel>9 ? 9 : nLevel);
+#endif
+
+#ifdef ZSTD_FOUND
+	if(sName=="zstd")
+		return new CZstdCodec(nLevel>ZSTD_maxCLevel() ? ZSTD_maxCLevel() : nLevel);
+#endif
+
+#ifdef LZ4_FOUND
+	if(sName=="lz4")
+		return new CLz4Codec(nLevel);
+#endif
+
+	(void)nLevel;
+	return NULL;
+}
+
+std::string CLogCodec::GetAvailable()
+{
+	std::string sAvailable;
+#ifdef ZLIB_FOUND
+	sAvailable+="gzip,";
+#endif
+#ifdef ZSTD_FOUND
+	sAvailable+="zstd,";
+#endif
+#ifdef LZ4_FOUND
+	sAvailable+="lz4,";
+#endif
+	if(!sAvailable.empty())
+		sAvailable.erase(sAvailable.size()-1);
+	return sAvailable;
+}
@@ -0,0 +1,99 @@
+/*
+ *  LogCodec.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGCODECH
+#define CLOGCODECH
+
+#include <string>
+
+
+/*!
+    @class   CLogCodec
+    @abstract    A compression format for logs (gzip, zstd or lz4)
+    @discussion  CZipper talks to its output through one of these so that the format can
+				 be chosen at run time. Codecs are named "codec[:level]" e.g. "gzip:6", "zstd:3"
+				 or "lz4". Which codecs exist depends on which libraries were found at build
+				 time - Create() returns NULL for anything else.
+
+				 A codec is used in one of two ways:
+				 - as a stream: Open(), any number of Write(), Flush() and Sync(), Close(). Only the
+				   zipper thread does this.
+				 - one block at a time: CompressBlock() turns a block into a self contained
+				   member (gzip member, zstd or lz4 frame). Members written one after the
+				   other are a valid file for the usual command line tools. CompressBlock()
+				   keeps no state so any number of threads may call it at once.
+*/
+
+class CLogCodec
+	{
+	public:
+		virtual ~CLogCodec();
+
+		/*!
+		 @function   Create
+		 @abstract   make a codec from a "codec[:level]" specification
+		 @discussion returns NULL if the codec is unknown or was not built in. Caller owns the result
+		 */
+		static CLogCodec * Create(const std::string & sSpecification);
+
+		/*!
+		 @function   GetAvailable
+		 @abstract   the names of the codecs built in, comma separated
+		 */
+		static std::string GetAvailable();
+
+		/** the name e.g "zstd" */
+		virtual std::string GetName() = 0;
+
+		/** the file extension e.g ".zst" */
+		virtual std::string GetExtension() = 0;
+
+		int GetLevel(){return m_nLevel;};
+
+		/** start a new compressed file */
+		virtual bool Open(const std::string & sFileName) = 0;
+
+		/** compress some more data into the file */
+		virtual bool Write(const char * pData, size_t nBytes) = 0;
+
+		/** push everything written so far to disk in decodable form */
+		virtual bool Flush() = 0;
+
+		/** flush and then get the file onto the disk (fdatasync) */
+		virtual bool Sync() = 0;
+
+		/*!
+		 @function   Restart
+		 @abstract   make a point from which a reader can start decompressing
+		 @discussion nCompressedOffset is set to where, in the compressed file, that point is.
+					 If StartsMember() a whole new member begins there, otherwise (gzip) it is
+					 a full flush point in the deflate stream. Returns false if not supported
+		 */
+		virtual bool Restart(unsigned long long & nCompressedOffset) = 0;
+
+		/** true if restart points are the starts of new members */
+		virtual bool StartsMember() = 0;
+
+		/** how many bytes of compressed output the stream has produced so far (roughly, for gzip) */
+		virtual unsigned long long GetCompressedSize() = 0;
+
+		/** finish the file */
+		virtual bool Close() = 0;
+
+		/** compress a block into a complete member (thread safe) */
+		virtual bool CompressBlock(const std::string & Input, std::string & Output) = 0;
+
+	protected:
+		CLogCodec(int nLevel);
+
+		int m_nLevel;
+
+	private:
+		CLogCodec(const CLogCodec &);
+		CLogCodec & operator=(const CLogCodec &);
+	};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ *  LogDurability.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogDurability.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include <cstdlib>
+#include <fcntl.h>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+
+CLogDurability::CLogDurability()
+{
+	m_eMode = NONE;
+	m_dfPeriod = 0;
+	m_nBytes = 0;
+	Reset(0);
+}
+
+bool CLogDurability::Parse(const std::string & sPolicy)
+{
+	std::string sRest = sPolicy;
+	MOOSRemoveChars(sRest," \t");
+	MOOSToUpper(sRest);
+
+	std::string sMode = MOOSChomp(sRest,":");
+
+	Mode eMode;
+	if(sMode=="NONE")
+		eMode = NONE;
+	else if(sMode=="FLUSH")
+		eMode = FLUSH;
+	else if(sMode=="FDATASYNC" || sMode=="FSYNC")
+		eMode = SYNC;
+	else
+		return false;
+
+	//what's left is a comma separated list of a period and (fdatasync only) an amount
+	double dfPeriod = 0;
+	unsigned long long nBytes = 0;
+	while(!sRest.empty())
+	{
+		std::string sLimit = MOOSChomp(sRest,",");
+
+		char * pUnit = NULL;
+		double dfValue = strtod(sLimit.c_str(),&pUnit);
+		std::string sUnit(pUnit);
+		if(pUnit==sLimit.c_str() || dfValue<0)
+			return false;
+
+		if(sUnit=="MS")
+			dfPeriod = dfValue/1000.0;
+		else if(sUnit=="S")
+			dfPeriod = dfValue;
+		else if(eMode==SYNC && sUnit=="KB")
+			nBytes = (unsigned long long)(dfValue*1024);
+		else if(eMode==SYNC && sUnit=="MB")
+			nBytes = (unsigned long long)(dfValue*1024*1024);
+		else if(eMode==SYNC && sUnit=="GB")
+			nBytes = (unsigned long long)(dfValue*1024*1024*1024);
+		else
+			return false;
+	}
+
+	m_eMode = eMode;
+	m_dfPeriod = dfPeriod;
+	m_nBytes = nBytes;
+	return true;
+}
+
+void CLogDurability::SetPolicy(const CLogDurability & Policy)
+{
+	m_eMode = Policy.m_eMode;
+	m_dfPeriod = Policy.m_dfPeriod;
+	m_nBytes = Policy.m_nBytes;
+}
+
+CLogDurability::Mode CLogDurability::GetMode() const
+{
+	return m_eMode;
+}
+
+double CLogDurability::GetPeriod() const
+{
+	return m_dfPeriod;
+}
+
+unsigned long long CLogDurability::GetBytes() const
+{
+	return m_nBytes;
+}
+
+std::string CLogDurability::GetDescription() const
+{
+	if(m_eMode==NONE)
+		return "none";
+
+	std::string sDescription = m_eMode==FLUSH ? "flush" : "fdatasync";
+	std::string sSeparator = ":";
+	if(m_dfPeriod>0)
+	{
+		sDescription+=sSeparator+MOOSFormat("%.0fms",m_dfPeriod*1000.0);
+		sSeparator = ",";
+	}
+	if(m_nBytes>0)
+		sDescription+=sSeparator+MOOSFormat("%.1fMB",m_nBytes/(1024.0*1024.0));
+
+	return sDescription;
+}
+
+void CLogDurability::Reset(double dfTimeNow)
+{
+	m_nUncommitted = 0;
+	m_dfLastCommit = dfTimeNow;
+	m_dfWrittenBefore = dfTimeNow;
+
+	m_Lock.Lock();
+	m_dfDurableTime = m_eMode==NONE ? -1 : dfTimeNow;
+	m_Lock.UnLock();
+}
+
+void CLogDurability::Written(unsigned long long nBytes, double dfQueuedBefore)
+{
+	m_nUncommitted+=nBytes;
+	m_dfWrittenBefore = dfQueuedBefore;
+
+	//with nothing waiting to be committed everything queued so far is as safe as it will get
+	if(m_nUncommitted==0 && m_eMode!=NONE)
+	{
+		m_Lock.Lock();
+		m_dfDurableTime = dfQueuedBefore;
+		m_Lock.UnLock();
+	}
+}
+
+bool CLogDurability::IsCommitDue(double dfTimeNow)
+{
+	if(m_eMode==NONE || m_nUncommitted==0)
+		return false;
+
+	//neither a period nor an amount - commit every batch
+	if(m_dfPeriod<=0 && m_nBytes==0)
+		return true;
+
+	if(m_dfPeriod>0 && dfTimeNow-m_dfLastCommit>=m_dfPeriod)
+		return true;
+
+	return m_nBytes>0 && m_nUncommitted>=m_nBytes;
+}
+
+void CLogDurability::Committed(double dfTimeNow)
+{
+	m_nUncommitted = 0;
+	m_dfLastCommit = dfTimeNow;
+
+	m_Lock.Lock();
+	m_dfDurableTime = m_dfWrittenBefore;
+	m_Lock.UnLock();
+}
+
+void CLogDurability::Closed()
+{
+	m_Lock.Lock();
+	m_dfDurableTime = -1;
+	m_Lock.UnLock();
+}
+
+double CLogDurability::GetDurableTime()
+{
+	m_Lock.Lock();
+	double dfDurableTime = m_dfDurableTime;
+	m_Lock.UnLock();
+	return dfDurableTime;
+}
+
+int CLogDurability::GetWaitMS(int nDefaultMS) const
+{
+	if(m_eMode==NONE || m_dfPeriod<=0)
+		return nDefaultMS;
+
+	int nPeriodMS = (int)(m_dfPeriod*1000.0);
+	if(nPeriodMS<1)
+		nPeriodMS = 1;
+
+	return nPeriodMS<nDefaultMS ? nPeriodMS : nDefaultMS;
+}
+
+bool CLogDurability::SyncFile(int nFile)
+{
+	if(nFile<0)
+		return false;
+
+#if defined(_WIN32)
+	return _commit(nFile)==0;
+#elif defined(__APPLE__)
+	return fsync(nFile)==0;
+#else
+	return fdatasync(nFile)==0;
+#endif
+}
+
+bool CLogDurability::SyncFile(const std::string & sFileName)
+{
+	//syncing any descriptor of a file syncs the file, so we needn't own the one being written
+#ifdef _WIN32
+	int nFile = _open(sFileName.c_str(),_O_WRONLY);
+#else
+	int nFile = open(sFileName.c_str(),O_RDONLY);
+#endif
+	if(nFile<0)
+		return false;
+
+	bool bOK = SyncFile(nFile);
+
+#ifdef _WIN32
+	_close(nFile);
+#else
+	close(nFile);
+#endif
+	return bOK;
+}
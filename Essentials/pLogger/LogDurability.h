@@ -0,0 +1,120 @@
+/*
+ *  LogDurability.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGDURABILITYH
+#define CLOGDURABILITYH
+
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include <string>
+
+
+/*!
+    @class   CLogDurability
+    @abstract    When a writer thread commits what it has written - and how far that commit reaches
+    @discussion  Three policies, set by the Durability configuration parameter:
+
+				 none             nothing is forced out - data reaches the OS when buffers fill
+								  and the disk when the OS decides
+				 flush:N ms       every N ms anything still held by the logger is handed to the
+								  OS. Survives pLogger dying, not the machine losing power
+				 fdatasync:N ms   as flush and then fdatasync - everything committed is on the
+				 fdatasync:N MB   disk. Either or both ("fdatasync:500ms,64MB") of a period
+								  and an amount of data written since the last commit
+
+				 The commit is done by the thread which writes the file, covering everything it
+				 has written since the last one (group commit) - so the cost of an fdatasync is
+				 shared by however much data arrived in the meantime and is never paid by the
+				 mail thread.
+
+				 Each writer keeps one of these. Reset() is called as the file is opened,
+				 Written(), Committed() and Closed() by the writer thread and GetDurableTime() by
+				 anyone: it is the time before which everything queued to that writer is committed.
+*/
+
+class CLogDurability
+	{
+	public:
+		enum Mode
+		{
+			NONE,
+			FLUSH,
+			SYNC
+		};
+
+		CLogDurability();
+
+		/*!
+		 @function   Parse
+		 @abstract   set the policy from "none", "flush:N ms" or "fdatasync:N ms[,N MB]"
+		 @discussion periods may be given in ms or s, amounts in KB, MB or GB. Returns false
+					 (leaving the policy as it was) if the string is not understood
+		 */
+		bool Parse(const std::string & sPolicy);
+
+		/** copy the policy (not the state) of another */
+		void SetPolicy(const CLogDurability & Policy);
+
+		Mode GetMode() const;
+
+		/** seconds between commits, 0 if commits are not timed */
+		double GetPeriod() const;
+
+		/** bytes written between commits, 0 if commits are not triggered by size */
+		unsigned long long GetBytes() const;
+
+		/** e.g "fdatasync:500ms,64MB" */
+		std::string GetDescription() const;
+
+		/** forget any state - the writer is starting on a new file at dfTimeNow */
+		void Reset(double dfTimeNow);
+
+		/*!
+		 @function   Written
+		 @abstract   the writer has handed nBytes to its file
+		 @param dfQueuedBefore everything queued before this time is now in the file
+		 */
+		void Written(unsigned long long nBytes, double dfQueuedBefore);
+
+		/** has a commit fallen due */
+		bool IsCommitDue(double dfTimeNow);
+
+		/** the writer has committed everything it has written */
+		void Committed(double dfTimeNow);
+
+		/** the writer has closed its file - it holds nothing back any more */
+		void Closed();
+
+		/** the time before which all data is committed, -1 if the policy is none or the file is closed */
+		double GetDurableTime();
+
+		/** how long a writer may sleep (ms) without missing a commit, at most nDefaultMS */
+		int GetWaitMS(int nDefaultMS) const;
+
+		/** get the data of an open file onto the disk */
+		static bool SyncFile(int nFile);
+
+		/** get the data of a file someone else has open onto the disk */
+		static bool SyncFile(const std::string & sFileName);
+
+	protected:
+		Mode m_eMode;
+		double m_dfPeriod;
+		unsigned long long m_nBytes;
+
+		//writer thread only
+		unsigned long long m_nUncommitted;
+		double m_dfLastCommit;
+		double m_dfWrittenBefore;
+
+		CMOOSLock m_Lock;
+		double m_dfDurableTime;
+
+	private:
+		CLogDurability(const CLogDurability &);
+		CLogDurability & operator=(const CLogDurability &);
+	};
+
+#endif
@@ -0,0 +1,451 @@
+/*
+ *  LogFile.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogFile.h"
+#include "LogDurability.h"
+#include <iostream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+
+#ifdef _WIN32
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
+
+//file offsets and lengths of aligned writes are multiples of this
+#define LOG_FILE_ALIGNMENT 4096
+//size of the aligned buffer - data goes to disk in chunks of this
+#define LOG_FILE_BUFFER (1024*1024)
+//default preallocation step
+#define LOG_FILE_DEFAULT_EXTENT (64*1024*1024)
+//size of the mmap window
+#define LOG_FILE_WINDOW (16*1024*1024)
+
+
+CLogFile::CLogFile()
+{
+	m_nFile = -1;
+	m_eMode = BUFFERED;
+	m_nSize = 0;
+	m_nReserved = 0;
+	m_nExtent = LOG_FILE_DEFAULT_EXTENT;
+	m_bCanPreallocate = true;
+	m_pBuffer = NULL;
+	m_nBuffered = 0;
+	m_nBufferOffset = 0;
+	m_pWindow = NULL;
+	m_nWindowOffset = 0;
+}
+
+CLogFile::~CLogFile()
+{
+	Close();
+}
+
+bool CLogFile::IsOpen()
+{
+	return m_nFile>=0;
+}
+
+unsigned long long CLogFile::GetSize()
+{
+	return m_nSize;
+}
+
+CLogFile::Mode CLogFile::GetMode()
+{
+	return m_eMode;
+}
+
+bool CLogFile::ParseMode(const std::string & sMode, Mode & eMode)
+{
+	std::string sLower = sMode;
+	for(size_t i = 0;i<sLower.size();i++)
+		sLower[i] = (char)tolower(sLower[i]);
+
+	if(sLower=="buffered")
+		eMode = BUFFERED;
+	else if(sLower=="preallocate" || sLower=="preallocated")
+		eMode = PREALLOCATED;
+	else if(sLower=="direct")
+		eMode = DIRECT;
+	else if(sLower=="mmap" || sLower=="mapped")
+		eMode = MAPPED;
+	else
+		return false;
+
+	return true;
+}
+
+std::string CLogFile::GetModeName(Mode eMode)
+{
+	switch(eMode)
+	{
+		case BUFFERED: return "buffered";
+		case PREALLOCATED: return "preallocate";
+		case DIRECT: return "direct";
+		case MAPPED: return "mmap";
+	}
+	return "unknown";
+}
+
+bool CLogFile::Open(const std::string & sFileName, Mode eMode, size_t nExtent, bool bBinary)
+{
+	if(IsOpen())
+		Close();
+
+	m_sFileName = sFileName;
+	m_nSize = 0;
+	m_nReserved = 0;
+	m_nExtent = nExtent>0 ? nExtent : LOG_FILE_DEFAULT_EXTENT;
+	m_nExtent = (m_nExtent+LOG_FILE_ALIGNMENT-1)/LOG_FILE_ALIGNMENT*LOG_FILE_ALIGNMENT;
+	m_bCanPreallocate = true;
+	m_nBuffered = 0;
+	m_nBufferOffset = 0;
+	m_nWindowOffset = 0;
+
+#ifdef _WIN32
+	if(eMode!=BUFFERED)
+	{
+		std::cerr<<"only buffered log files are supported on this platform - "<<sFileName<<" will be buffered\n";
+		eMode = BUFFERED;
+	}
+	m_nFile = _open(sFileName.c_str(), _O_WRONLY|_O_CREAT|_O_TRUNC|(bBinary ? _O_BINARY : _O_TEXT), _S_IREAD|_S_IWRITE);
+#else
+	(void)bBinary;
+
+#ifdef __APPLE__
+	//no posix_fallocate to put real blocks behind a mapping
+	if(eMode==MAPPED)
+	{
+		std::cerr<<"cannot preallocate "<<sFileName<<" for mmap - using preallocate\n";
+		eMode = PREALLOCATED;
+	}
+#endif
+
+	//a shared writable mapping needs the file to be readable too
+	int nFlags = (eMode==MAPPED ? O_RDWR : O_WRONLY)|O_CREAT|O_TRUNC;
+
+	if(eMode==DIRECT)
+	{
+#ifdef O_DIRECT
+		m_nFile = open(sFileName.c_str(), nFlags|O_DIRECT, 0644);
+#endif
+		if(m_nFile<0)
+		{
+			std::cerr<<"cannot open "<<sFileName<<" for direct io - using preallocate\n";
+			eMode = PREALLOCATED;
+		}
+	}
+
+	if(m_nFile<0)
+		m_nFile = open(sFileName.c_str(), nFlags, 0644);
+#endif
+
+	if(m_nFile<0)
+		return false;
+
+	m_eMode = eMode;
+
+	if(m_eMode==PREALLOCATED || m_eMode==DIRECT)
+	{
+#ifndef _WIN32
+		//room for a chunk plus the padding of a part filled last block
+		void * pBuffer = NULL;
+		if(posix_memalign(&pBuffer, LOG_FILE_ALIGNMENT, LOG_FILE_BUFFER+LOG_FILE_ALIGNMENT)!=0)
+		{
+			Close();
+			return false;
+		}
+		m_pBuffer = (char*)pBuffer;
+#endif
+	}
+
+	return true;
+}
+
+bool CLogFile::Close()
+{
+	if(!IsOpen())
+		return true;
+
+	bool bOK = Flush();
+
+#ifdef _WIN32
+	_close(m_nFile);
+#else
+	UnmapWindow();
+
+	//lose the preallocated (or padded) tail
+	if(m_eMode!=BUFFERED && ftruncate(m_nFile, (off_t)m_nSize)!=0)
+		bOK = false;
+
+	close(m_nFile);
+#endif
+	m_nFile = -1;
+
+	free(m_pBuffer);
+	m_pBuffer = NULL;
+
+	return bOK;
+}
+
+bool CLogFile::Write(const char * pData, size_t nBytes)
+{
+	if(!IsOpen())
+		return false;
+
+	switch(m_eMode)
+	{
+		case BUFFERED:
+			if(!WriteAll(pData, nBytes, m_nSize))
+				return false;
+			m_nSize+=nBytes;
+			return true;
+
+		case PREALLOCATED:
+		case DIRECT:
+			while(nBytes>0)
+			{
+				size_t nCopy = LOG_FILE_BUFFER-m_nBuffered;
+				if(nCopy>nBytes)
+					nCopy = nBytes;
+
+				memcpy(m_pBuffer+m_nBuffered, pData, nCopy);
+				m_nBuffered+=nCopy;
+				m_nSize+=nCopy;
+				pData+=nCopy;
+				nBytes-=nCopy;
+
+				if(m_nBuffered==LOG_FILE_BUFFER && !WriteBuffer(false))
+					return false;
+			}
+			return true;
+
+		case MAPPED:
+#ifndef _WIN32
+			while(nBytes>0)
+			{
+				if(m_pWindow==NULL || m_nSize>=m_nWindowOffset+LOG_FILE_WINDOW)
+				{
+					if(!MapWindow(m_nSize))
+						return false;
+				}
+
+				size_t nCopy = (size_t)(m_nWindowOffset+LOG_FILE_WINDOW-m_nSize);
+				if(nCopy>nBytes)
+					nCopy = nBytes;
+
+				memcpy(m_pWindow+(m_nSize-m_nWindowOffset), pData, nCopy);
+				m_nSize+=nCopy;
+				pData+=nCopy;
+				nBytes-=nCopy;
+			}
+#endif
+			return true;
+	}
+
+	return false;
+}
+
+bool CLogFile::Flush()
+{
+	if(!IsOpen())
+		return false;
+
+	//buffered writes and the mapping are already with the OS
+	if(m_eMode==PREALLOCATED || m_eMode==DIRECT)
+		return WriteBuffer(true);
+
+	return true;
+}
+
+bool CLogFile::Sync()
+{
+	if(!Flush())
+		return false;
+
+#ifndef _WIN32
+	//pages written through the mapping are dirty in the page cache like any other but
+	//msync is the portable way of saying so
+	if(m_pWindow!=NULL && msync(m_pWindow, LOG_FILE_WINDOW, MS_SYNC)!=0)
+		return false;
+#endif
+
+	return CLogDurability::SyncFile(m_nFile);
+}
+
+bool CLogFile::WriteBuffer(bool bAll)
+{
+	size_t nWhole = m_nBuffered/LOG_FILE_ALIGNMENT*LOG_FILE_ALIGNMENT;
+	size_t nWrite = bAll ? m_nBuffered : nWhole;
+
+	//direct io can only write whole blocks - pad the last one (Close() trims the file)
+	if(m_eMode==DIRECT && nWrite>nWhole)
+	{
+		nWrite = nWhole+LOG_FILE_ALIGNMENT;
+		memset(m_pBuffer+m_nBuffered, 0, nWrite-m_nBuffered);
+	}
+
+	if(nWrite==0)
+		return true;
+
+	if(!Reserve(m_nBufferOffset+nWrite))
+		return false;
+
+	if(!WriteAll(m_pBuffer, nWrite, m_nBufferOffset))
+		return false;
+
+	//keep the part filled last block, it is written again (aligned) next time
+	if(nWhole>0)
+	{
+		memmove(m_pBuffer, m_pBuffer+nWhole, m_nBuffered-nWhole);
+		m_nBufferOffset+=nWhole;
+		m_nBuffered-=nWhole;
+	}
+
+	return true;
+}
+
+bool CLogFile::WriteAll(const char * pData, size_t nBytes, unsigned long long nOffset)
+{
+	while(nBytes>0)
+	{
+#ifdef _WIN32
+		(void)nOffset;
+		int nWritten = _write(m_nFile, pData, (unsigned int)nBytes);
+#else
+		ssize_t nWritten;
+		if(m_eMode==BUFFERED)
+			nWritten = write(m_nFile, pData, nBytes);
+		else
+			nWritten = pwrite(m_nFile, pData, nBytes, (off_t)nOffset);
+
+		if(nWritten<0 && errno==EINTR)
+			continue;
+
+#ifdef O_DIRECT
+		//some filesystems accept O_DIRECT at open but not at write
+		if(nWritten<0 && errno==EINVAL && m_eMode==DIRECT)
+		{
+			std::cerr<<"direct io refused for "<<m_sFileName<<" - using preallocate\n";
+			fcntl(m_nFile, F_SETFL, fcntl(m_nFile, F_GETFL)&~O_DIRECT);
+			m_eMode = PREALLOCATED;
+			continue;
+		}
+#endif
+#endif
+		if(nWritten<=0)
+		{
+			std::cerr<<"failed writing to "<<m_sFileName<<": "<<strerror(errno)<<"\n";
+			return false;
+		}
+
+		pData+=nWritten;
+		nBytes-=nWritten;
+		nOffset+=nWritten;
+	}
+	return true;
+}
+
+int CLogFile::Allocate(unsigned long long nOffset, unsigned long long nBytes)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+	(void)nOffset;
+	(void)nBytes;
+	return EOPNOTSUPP;
+#else
+	//a mapping needs real blocks behind it (writing to a hole on a full disk is a SIGBUS)
+	//so where the filesystem can't preallocate posix_fallocate writes zeros instead
+	if(m_eMode==MAPPED)
+		return posix_fallocate(m_nFile, (off_t)nOffset, (off_t)nBytes);
+
+#ifdef __linux__
+	if(fallocate(m_nFile, 0, (off_t)nOffset, (off_t)nBytes)==0)
+		return 0;
+	return errno;
+#else
+	return EOPNOTSUPP;
+#endif
+#endif
+}
+
+bool CLogFile::Reserve(unsigned long long nUpTo)
+{
+	if(m_nReserved>=nUpTo || (!m_bCanPreallocate && m_eMode!=MAPPED))
+		return true;
+
+	//whole extents if the disk has room, otherwise just what is needed
+	unsigned long long nBytes = (nUpTo-m_nReserved+m_nExtent-1)/m_nExtent*m_nExtent;
+	int nError = Allocate(m_nReserved, nBytes);
+	if(nError==ENOSPC)
+	{
+		nBytes = nUpTo-m_nReserved;
+		nError = Allocate(m_nReserved, nBytes);
+	}
+
+	if(nError==0)
+	{
+		m_nReserved+=nBytes;
+		return true;
+	}
+
+	//not supported here - plain writes extend the file themselves so don't keep asking
+	if(m_eMode!=MAPPED && nError!=ENOSPC)
+	{
+		m_bCanPreallocate = false;
+		return true;
+	}
+
+	std::cerr<<"failed to allocate "<<m_sFileName<<": "<<strerror(nError)<<"\n";
+	return false;
+}
+
+bool CLogFile::MapWindow(unsigned long long nOffset)
+{
+#ifndef _WIN32
+	UnmapWindow();
+
+	m_nWindowOffset = nOffset/LOG_FILE_WINDOW*LOG_FILE_WINDOW;
+
+	//the whole window has to be inside the file
+	if(!Reserve(m_nWindowOffset+LOG_FILE_WINDOW))
+	{
+		std::cerr<<"failed to extend "<<m_sFileName<<"\n";
+		return false;
+	}
+
+	void * pWindow = mmap(NULL, LOG_FILE_WINDOW, PROT_READ|PROT_WRITE, MAP_SHARED, m_nFile, (off_t)m_nWindowOffset);
+	if(pWindow==MAP_FAILED)
+	{
+		std::cerr<<"failed to map "<<m_sFileName<<": "<<strerror(errno)<<"\n";
+		return false;
+	}
+
+	m_pWindow = (char*)pWindow;
+	return true;
+#else
+	(void)nOffset;
+	return false;
+#endif
+}
+
+void CLogFile::UnmapWindow()
+{
+#ifndef _WIN32
+	if(m_pWindow!=NULL)
+	{
+		munmap(m_pWindow, LOG_FILE_WINDOW);
+		m_pWindow = NULL;
+	}
+#endif
+}
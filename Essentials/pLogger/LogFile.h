@@ -0,0 +1,128 @@
+/*
+ *  LogFile.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGFILEH
+#define CLOGFILEH
+
+#include <string>
+
+
+/*!
+    @class   CLogFile
+    @abstract    The file a CLogWriter writes to, with a choice of how bytes reach the disk
+    @discussion  Four backends:
+
+				 BUFFERED     plain write() calls into the page cache. What pLogger has always done
+				 PREALLOCATED the file is grown with fallocate in large extents so the filesystem
+							  isn't allocating (and journalling) a little more on every write, and
+							  data goes out in page aligned chunks. The unwritten part of the last
+							  chunk is rewritten next time round rather than leaving writes unaligned
+				 DIRECT       as PREALLOCATED but opened O_DIRECT so the page cache (and its
+							  writeback storms) is bypassed. A part filled last block is padded with
+							  zeros when flushed
+				 MAPPED       the file is preallocated and written through a sliding mmap window.
+							  The blocks are really allocated (posix_fallocate) so a full disk is
+							  a failed write rather than a SIGBUS - where that isn't available
+							  it falls back to PREALLOCATED
+
+				 In all but BUFFERED mode the file is longer than the data (trailing zeros) while
+				 it is open - Close() truncates it to its real size. Backends which the platform
+				 or filesystem can't do fall back to the nearest one which it can.
+
+				 Not thread safe - one thread (the writer thread) owns the file.
+*/
+
+class CLogFile
+	{
+	public:
+		enum Mode
+		{
+			BUFFERED,
+			PREALLOCATED,
+			DIRECT,
+			MAPPED
+		};
+
+		CLogFile();
+		~CLogFile();
+
+		/*!
+		 @function   Open
+		 @abstract   create (truncating) the named file
+		 @param eMode which backend
+		 @param nExtent how much to preallocate at a time (0 for the default)
+		 @param bBinary false for text mode, which only matters on Windows
+		 */
+		bool Open(const std::string & sFileName, Mode eMode = BUFFERED, size_t nExtent = 0, bool bBinary = true);
+
+		/** append some bytes */
+		bool Write(const char * pData, size_t nBytes);
+
+		/** hand everything written so far to the OS */
+		bool Flush();
+
+		/** flush and then get everything written so far onto the disk (fdatasync) */
+		bool Sync();
+
+		/** flush, trim the file to the data written and close it */
+		bool Close();
+
+		bool IsOpen();
+
+		/** the number of bytes of data written */
+		unsigned long long GetSize();
+
+		/** the backend actually in use (after any fall back) */
+		Mode GetMode();
+
+		/** "buffered", "preallocate", "direct" or "mmap" to a Mode, false if not recognised */
+		static bool ParseMode(const std::string & sMode, Mode & eMode);
+
+		static std::string GetModeName(Mode eMode);
+
+	protected:
+
+		/** write the whole of a buffer, retrying partial writes */
+		bool WriteAll(const char * pData, size_t nBytes, unsigned long long nOffset);
+
+		/** make sure the file has space allocated up to nUpTo, false if it can't be (or must be and wasn't) */
+		bool Reserve(unsigned long long nUpTo);
+
+		/** allocate blocks for part of the file, returns 0 or an errno */
+		int Allocate(unsigned long long nOffset, unsigned long long nBytes);
+
+		/** write out the aligned buffer, all of it if bAll, else only whole chunks */
+		bool WriteBuffer(bool bAll);
+
+		/** map the window holding nOffset */
+		bool MapWindow(unsigned long long nOffset);
+		void UnmapWindow();
+
+		int m_nFile;
+		std::string m_sFileName;
+		Mode m_eMode;
+
+		//bytes of data written and bytes of file allocated
+		unsigned long long m_nSize;
+		unsigned long long m_nReserved;
+		size_t m_nExtent;
+		bool m_bCanPreallocate;
+
+		//PREALLOCATED and DIRECT: an aligned buffer which starts at an aligned file offset
+		char * m_pBuffer;
+		size_t m_nBuffered;
+		unsigned long long m_nBufferOffset;
+
+		//MAPPED: the window of the file currently mapped
+		char * m_pWindow;
+		unsigned long long m_nWindowOffset;
+
+	private:
+		CLogFile(const CLogFile &);
+		CLogFile & operator=(const CLogFile &);
+	};
+
+#endif
@@ -0,0 +1,397 @@
+/*
+ *  LogSegment.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogSegment.h"
+#include "LogCodec.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+//how much of a closed file is read at a time when compressing it
+#define SEGMENT_COMPRESS_CHUNK (1024*1024)
+
+
+CLogSegment::CLogSegment()
+{
+	m_bOpen = false;
+	m_nAlogBytes = 0;
+
+	m_bTextAlog = true;
+	m_bColumnar = false;
+	m_bCompress = false;
+	m_bExcluded = false;
+	m_bIndex = false;
+	m_nIndexInterval = 0;
+	m_bDedupBinary = false;
+}
+
+CLogSegment::~CLogSegment()
+{
+	Close();
+	for(size_t i = 0;i<m_Shards.size();i++)
+		delete m_Shards[i];
+}
+
+void CLogSegment::SetShards(const std::vector<std::string> & Names, const std::vector<std::string> & Directories)
+{
+	for(size_t i = 0;i<m_Shards.size();i++)
+		delete m_Shards[i];
+	m_Shards.clear();
+	m_ShardDirectories.clear();
+
+	for(size_t i = 0;i<Names.size();i++)
+	{
+		m_Shards.push_back(new CLogShard(Names[i]));
+		m_ShardDirectories.push_back(i<Directories.size() ? Directories[i] : std::string());
+	}
+}
+
+void CLogSegment::SetContents(bool bTextAlog, bool bColumnar, bool bCompress, bool bExcluded,
+	bool bIndex, unsigned long long nIndexInterval, bool bDedupBinary)
+{
+	m_bTextAlog = bTextAlog;
+	m_bColumnar = bColumnar;
+	m_bCompress = bCompress;
+	m_bExcluded = bExcluded;
+	m_bIndex = bIndex;
+	m_nIndexInterval = nIndexInterval;
+	m_bDedupBinary = bDedupBinary;
+}
+
+void CLogSegment::SetDurability(const CLogDurability & Policy)
+{
+	m_AlogWriter.SetDurability(Policy);
+	m_XlogWriter.SetDurability(Policy);
+	m_AlogZipper.SetDurability(Policy);
+	m_XlogZipper.SetDurability(Policy);
+	m_ColumnarLog.SetDurability(Policy);
+	m_BinaryLog.SetDurability(Policy);
+}
+
+double CLogSegment::GetDurableTime()
+{
+	std::vector<double> Times(6);
+	Times[0] = m_AlogWriter.GetDurableTime();
+	Times[1] = m_XlogWriter.GetDurableTime();
+	Times[2] = m_AlogZipper.GetDurableTime();
+	Times[3] = m_XlogZipper.GetDurableTime();
+	Times[4] = m_ColumnarLog.GetDurableTime();
+	Times[5] = m_BinaryLog.GetDurableTime();
+	for(size_t i = 0;i<m_Shards.size();i++)
+		Times.push_back(m_Shards[i]->GetDurableTime());
+
+	//writers which aren't running hold nothing back
+	double dfDurable = -1;
+	for(size_t i = 0;i<Times.size();i++)
+	{
+		if(Times[i]>=0 && (dfDurable<0 || Times[i]<dfDurable))
+			dfDurable = Times[i];
+	}
+	return dfDurable;
+}
+
+void CLogSegment::SetStaging(size_t nCapacity, size_t nDrainSize, CLogWriter::OverflowPolicy ePolicy)
+{
+	m_AlogWriter.SetStaging(nCapacity, nDrainSize, ePolicy);
+	m_XlogWriter.SetStaging(nCapacity, nDrainSize, ePolicy);
+	m_ColumnarLog.SetStaging(nCapacity, nDrainSize);
+}
+
+double CLogSegment::GetStagingFill()
+{
+	double Fills[5];
+	Fills[0] = m_AlogWriter.GetStagingFill();
+	Fills[1] = m_XlogWriter.GetStagingFill();
+	Fills[2] = m_ColumnarLog.GetStagingFill();
+	Fills[3] = m_AlogZipper.GetQueueLimit()>0 ? (double)m_AlogZipper.GetQueueDepth()/m_AlogZipper.GetQueueLimit() : 0;
+	Fills[4] = m_XlogZipper.GetQueueLimit()>0 ? (double)m_XlogZipper.GetQueueDepth()/m_XlogZipper.GetQueueLimit() : 0;
+
+	double dfFill = 0;
+	for(int i = 0;i<5;i++)
+		dfFill = std::max(dfFill, Fills[i]);
+	for(size_t i = 0;i<m_Shards.size();i++)
+		dfFill = std::max(dfFill, m_Shards[i]->GetStagingFill());
+	return dfFill;
+}
+
+void CLogSegment::MoveWriteLatency(CLatencyHistogram & Total)
+{
+	m_AlogWriter.GetWriteLatency().MoveTo(Total);
+	m_XlogWriter.GetWriteLatency().MoveTo(Total);
+	m_AlogZipper.GetWriteLatency().MoveTo(Total);
+	m_XlogZipper.GetWriteLatency().MoveTo(Total);
+	m_ColumnarLog.GetWriteLatency().MoveTo(Total);
+	m_BinaryLog.GetWriteLatency().MoveTo(Total);
+	for(size_t i = 0;i<m_Shards.size();i++)
+		m_Shards[i]->MoveWriteLatency(Total);
+}
+
+bool CLogSegment::IsOpen()
+{
+	return m_bOpen;
+}
+
+std::string CLogSegment::GetAlogFileName()
+{
+	return m_sAsyncFileName;
+}
+
+unsigned long long CLogSegment::GetSize()
+{
+	unsigned long long nSize = m_nAlogBytes+m_BinaryLog.GetSize()+m_ColumnarLog.GetSize();
+	for(size_t i = 0;i<m_Shards.size();i++)
+		nSize+=m_Shards[i]->GetSize();
+	return nSize;
+}
+
+bool CLogSegment::Open(const std::string & sDirectory, const std::string & sRootName,
+	const std::string & sBanner, double dfAppStartTime)
+{
+	if(m_bOpen)
+		Close();
+
+	m_sRootName = sRootName;
+	m_sAsyncFileName = sDirectory+"/"+sRootName+".alog";
+	m_sExcludeFileName = sDirectory+"/"+sRootName+".xlog";
+	m_sBinaryFileName = sDirectory+"/"+sRootName+".blog";
+	m_sColumnarFileName = sDirectory+"/"+sRootName+".clog";
+	m_sIndexFileName = sDirectory+"/"+sRootName+".aidx";
+	m_sShardIndexFileName = sDirectory+"/"+sRootName+".sidx";
+
+	m_bOpen = true;
+
+	if(m_bColumnar)
+	{
+		if(!m_ColumnarLog.Open(m_sColumnarFileName,dfAppStartTime))
+		{
+			std::cerr<<"failed to open clog file "<<m_sColumnarFileName<<"\n";
+			return false;
+		}
+	}
+
+	//offsets in the index count from the first byte of the banner
+	m_nAlogBytes = 0;
+	if(m_bIndex && m_bTextAlog)
+	{
+		std::string sIndexed = m_bCompress ? m_sAsyncFileName+m_AlogZipper.GetExtension() : m_sAsyncFileName;
+		if(!m_AlogIndex.Open(m_sIndexFileName,sIndexed,m_nIndexInterval))
+			std::cerr<<"failed to open alog index "<<m_sIndexFileName<<"\n";
+	}
+
+	if(m_bCompress)
+	{
+		//the banner is queued before the zipper thread starts
+		if(m_bTextAlog)
+		{
+			m_AlogZipper.Push(sBanner);
+			m_nAlogBytes+=sBanner.size();
+
+			m_AlogZipper.SetIndex(m_AlogIndex.IsOpen() ? &m_AlogIndex : NULL);
+			if(!m_AlogZipper.Start(m_sAsyncFileName))
+			{
+				std::cerr<<"failed to start compressing "<<m_sAsyncFileName<<"\n";
+				return false;
+			}
+		}
+
+		if(m_bExcluded)
+		{
+			m_XlogZipper.Push(sBanner);
+			if(!m_XlogZipper.Start(m_sExcludeFileName))
+			{
+				std::cerr<<"failed to start compressing "<<m_sExcludeFileName<<"\n";
+				return false;
+			}
+		}
+	}
+	else
+	{
+		//the actual disk writes happen on writer threads so a stalling
+		//disk never blocks mail handling
+		if(m_bTextAlog)
+		{
+			if(!m_AlogWriter.Start(m_sAsyncFileName))
+			{
+				std::cerr<<"failed to open alog file "<<m_sAsyncFileName<<"\n";
+				return false;
+			}
+
+			m_AlogWriter.Push(sBanner);
+			m_nAlogBytes+=sBanner.size();
+		}
+
+		if(m_bExcluded)
+		{
+			if(!m_XlogWriter.Start(m_sExcludeFileName))
+			{
+				std::cerr<<"failed to open xlog file "<<m_sExcludeFileName<<"\n";
+				return false;
+			}
+		}
+	}
+
+	//the shards are set up just like the alog and listed in the shard index - by name
+	//if they live alongside, by full path if they were given a directory of their own
+	if(m_bTextAlog && !m_Shards.empty())
+	{
+		std::vector<std::string> Files;
+		Files.push_back(sRootName+".alog"+(m_bCompress ? m_AlogZipper.GetExtension() : std::string()));
+		for(size_t i = 0;i<m_Shards.size();i++)
+		{
+			std::string sShardName = sRootName+"_"+m_Shards[i]->GetName()+".alog";
+			std::string sShardDirectory = m_ShardDirectories[i].empty() ? sDirectory : m_ShardDirectories[i];
+			if(!m_Shards[i]->Open(sShardDirectory+"/"+sShardName,sBanner,m_bCompress,m_AlogWriter,m_AlogZipper))
+				return false;
+			if(!m_ShardDirectories[i].empty())
+				sShardName = sShardDirectory+"/"+sShardName;
+			Files.push_back(sShardName+(m_bCompress ? m_AlogZipper.GetExtension() : std::string()));
+		}
+
+		if(!m_ShardIndex.Open(m_sShardIndexFileName,Files))
+			std::cerr<<"failed to open shard index "<<m_sShardIndexFileName<<"\n";
+	}
+
+	//also open a binary log file - this is always created
+
+	//*note* that the binary file is _not_ compressed
+	//no matter what flags you set - this is so that
+	//we can jump around in it using memory offsets
+	if(!m_BinaryLog.Open(m_sBinaryFileName,m_bDedupBinary))
+	{
+		std::cerr<<"failed to open blog file "<<m_sBinaryFileName<<"\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool CLogSegment::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	//blocks until everything queued has reached the disk
+	bool bOK = true;
+	bOK = m_AlogWriter.Stop() && bOK;
+	bOK = m_XlogWriter.Stop() && bOK;
+	bOK = m_ColumnarLog.Close() && bOK;
+	bOK = m_BinaryLog.Close() && bOK;
+	for(size_t i = 0;i<m_Shards.size();i++)
+		bOK = m_Shards[i]->Close() && bOK;
+	bOK = m_ShardIndex.Close() && bOK;
+
+	//crucially make sure the zipping threads have stopped
+	//before the index they write restart points to goes
+	if(m_AlogZipper.IsRunning())
+		bOK = m_AlogZipper.Stop() && bOK;
+	if(m_XlogZipper.IsRunning())
+		bOK = m_XlogZipper.Stop() && bOK;
+
+	bOK = m_AlogIndex.Close() && bOK;
+	m_AlogZipper.SetIndex(NULL);
+
+	m_bOpen = false;
+	return bOK;
+}
+
+bool CLogSegment::Discard()
+{
+	if(!m_bOpen)
+		return true;
+
+	Close();
+
+	std::vector<std::string> Files;
+	Files.push_back(m_sAsyncFileName);
+	Files.push_back(m_sExcludeFileName);
+	Files.push_back(m_sAsyncFileName+m_AlogZipper.GetExtension());
+	Files.push_back(m_sExcludeFileName+m_XlogZipper.GetExtension());
+	Files.push_back(m_sBinaryFileName);
+	Files.push_back(m_sColumnarFileName);
+	Files.push_back(m_sIndexFileName);
+	Files.push_back(m_sShardIndexFileName);
+	Files.push_back(m_sAsyncFileName+".zidx");
+	Files.push_back(m_sExcludeFileName+".zidx");
+	for(size_t i = 0;i<m_Shards.size();i++)
+	{
+		std::string sShardFile = m_Shards[i]->GetFileName();
+		Files.push_back(sShardFile);
+		if(m_bCompress)
+			Files.push_back(sShardFile.substr(0,sShardFile.size()-m_AlogZipper.GetExtension().size())+".zidx");
+	}
+
+	//not every one of these exists - that's fine
+	for(size_t i = 0;i<Files.size();i++)
+		remove(Files[i].c_str());
+
+	return true;
+}
+
+bool CLogSegment::CompressClosedFiles(const std::string & sCodec)
+{
+	if(m_bOpen || m_bCompress)
+		return true;
+
+	bool bOK = true;
+	if(m_bTextAlog && !m_bIndex)
+	{
+		bOK = CompressFile(m_sAsyncFileName,sCodec) && bOK;
+		for(size_t i = 0;i<m_Shards.size();i++)
+			bOK = CompressFile(m_Shards[i]->GetFileName(),sCodec) && bOK;
+	}
+
+	if(m_bExcluded)
+		bOK = CompressFile(m_sExcludeFileName,sCodec) && bOK;
+
+	return bOK;
+}
+
+bool CLogSegment::CompressFile(const std::string & sFileName, const std::string & sCodec)
+{
+	CLogCodec * pCodec = CLogCodec::Create(sCodec);
+	if(pCodec==NULL)
+	{
+		std::cerr<<"cannot compress "<<sFileName<<" - codec \""<<sCodec<<"\" is not available\n";
+		return false;
+	}
+
+	FILE * pIn = fopen(sFileName.c_str(),"rb");
+	std::string sCompressedName = sFileName+pCodec->GetExtension();
+	if(pIn==NULL || !pCodec->Open(sCompressedName))
+	{
+		std::cerr<<"cannot compress "<<sFileName<<"\n";
+		if(pIn!=NULL)
+			fclose(pIn);
+		delete pCodec;
+		return false;
+	}
+
+	std::vector<char> Chunk(SEGMENT_COMPRESS_CHUNK);
+	bool bOK = true;
+	size_t nRead;
+	while(bOK && (nRead = fread(&Chunk[0],1,Chunk.size(),pIn))>0)
+	{
+		bOK = pCodec->Write(&Chunk[0],nRead);
+	}
+
+	bOK = !ferror(pIn) && bOK;
+	fclose(pIn);
+
+	bOK = pCodec->Close() && bOK;
+	delete pCodec;
+
+	//only lose the original once the compressed copy is complete
+	if(bOK)
+		remove(sFileName.c_str());
+	else
+	{
+		std::cerr<<"failed compressing "<<sFileName<<" - keeping it uncompressed\n";
+		remove(sCompressedName.c_str());
+	}
+
+	return bOK;
+}
@@ -0,0 +1,178 @@
+/*
+ *  LogSegment.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGSEGMENTH
+#define CLOGSEGMENTH
+
+#include <string>
+#include <vector>
+#include "Zipper.h"
+#include "LogWriter.h"
+#include "ColumnarLog.h"
+#include "BinaryLog.h"
+#include "AlogIndex.h"
+#include "LogShard.h"
+#include "ShardIndex.h"
+
+
+/*!
+    @class   CLogSegment
+    @abstract    One stretch of asynchronous logging - the alog, xlog, blog, clog and alog index
+				 which are written together
+    @discussion  Without rotation a session has exactly one segment. With rotation (RotateEvery)
+				 pLogger keeps two: the one being written and a spare. The spare is opened by a
+				 background thread ahead of time so when the current segment is full the mail
+				 thread only has to swap a pointer - nothing is opened, closed, flushed or
+				 compressed on the mail thread. The old segment is then closed (and optionally
+				 compressed) by that same background thread.
+
+				 Open() and Close() may be called from any thread but a segment is only ever
+				 used by one thread at a time: the mail thread while it is current, the
+				 rotation thread otherwise.
+*/
+
+class CLogSegment
+	{
+	public:
+		CLogSegment();
+		~CLogSegment();
+
+		/*!
+		 @function   SetContents
+		 @abstract   which files make up a segment
+		 @param bTextAlog write the text alog
+		 @param bColumnar write the columnar clog
+		 @param bCompress compress the alog and xlog as they are written
+		 @param bExcluded write rejected variables to an xlog
+		 @param bIndex write an .aidx alongside the text alog
+		 @param nIndexInterval bytes of alog between index entries
+		 @param bDedupBinary store repeated binary payloads once
+		 */
+		void SetContents(bool bTextAlog, bool bColumnar, bool bCompress, bool bExcluded,
+			bool bIndex, unsigned long long nIndexInterval, bool bDedupBinary);
+
+		/*!
+		 @function   SetShards
+		 @abstract   split the alog - a CLogShard (sRootName_name.alog) for each name, set before Open()
+		 @discussion entries the logger doesn't put into a shard stay in the alog, shard 0
+		 @param Directories where each shard is written, an empty entry means alongside the alog
+		 */
+		void SetShards(const std::vector<std::string> & Names, const std::vector<std::string> & Directories);
+
+		/** when the writers commit what they have written, set before Open() */
+		void SetDurability(const CLogDurability & Policy);
+
+		/*!
+		 @function   GetDurableTime
+		 @abstract   the time before which everything logged to this segment is committed
+		 @discussion the earliest of the writers' durable times, -1 if none of them has one (the
+					 policy is none or the segment is closed)
+		 */
+		double GetDurableTime();
+
+		/*!
+		 @function   SetStaging
+		 @abstract   how much of the alog, xlog and clog is staged in RAM (see CLogWriter)
+		 @discussion set before Open(). The clog always blocks when full
+		 */
+		void SetStaging(size_t nCapacity, size_t nDrainSize, CLogWriter::OverflowPolicy ePolicy);
+
+		/*!
+		 @function   GetStagingFill
+		 @abstract   the fullest (0 to 1) of the staging buffers and compression queues
+		 @discussion a value near 1 means the disk is not keeping up
+		 */
+		double GetStagingFill();
+
+		/** move the write latencies the writers have measured into Total */
+		void MoveWriteLatency(CLatencyHistogram & Total);
+
+		/*!
+		 @function   Open
+		 @abstract   create the files sDirectory/sRootName.* and start their threads
+		 @param sBanner written at the top of the alog and xlog
+		 @param dfAppStartTime the time entries are written relative to
+		 */
+		bool Open(const std::string & sDirectory, const std::string & sRootName,
+			const std::string & sBanner, double dfAppStartTime);
+
+		/*!
+		 @function   Close
+		 @abstract   write everything queued and close all the files (blocking)
+		 */
+		bool Close();
+
+		/*!
+		 @function   Discard
+		 @abstract   close a segment which was opened but never used and remove its files
+		 */
+		bool Discard();
+
+		bool IsOpen();
+
+		/*!
+		 @function   CompressClosedFiles
+		 @abstract   compress the alog and xlog of a closed segment with the named codec
+		 @discussion each file is replaced by a compressed copy. Does nothing for files which
+					 were compressed as they were written. An indexed alog is left as it is since
+					 its index refers to uncompressed offsets
+		 */
+		bool CompressClosedFiles(const std::string & sCodec);
+
+		/** bytes written to the alog, its shards, blog and clog so far */
+		unsigned long long GetSize();
+
+		/** the uncompressed alog name (sDirectory/sRootName.alog) */
+		std::string GetAlogFileName();
+
+		//the writers - the logger pushes to these directly
+		CLogWriter m_AlogWriter;
+		CLogWriter m_XlogWriter;
+		CZipper m_AlogZipper;
+		CZipper m_XlogZipper;
+		CColumnarLog m_ColumnarLog;
+		CBinaryLog m_BinaryLog;
+		CAlogIndex m_AlogIndex;
+
+		//the alog's shards (shard n is m_Shards[n-1]), their directories and their merged index
+		std::vector<CLogShard*> m_Shards;
+		std::vector<std::string> m_ShardDirectories;
+		CShardIndex m_ShardIndex;
+
+		//how many bytes of alog have been written (offsets in the index)
+		unsigned long long m_nAlogBytes;
+
+		//the root of all this segment's file names (no directory)
+		std::string m_sRootName;
+
+	protected:
+
+		/** stream a file through a codec into sFileName+extension then remove it */
+		bool CompressFile(const std::string & sFileName, const std::string & sCodec);
+
+		bool m_bOpen;
+
+		bool m_bTextAlog;
+		bool m_bColumnar;
+		bool m_bCompress;
+		bool m_bExcluded;
+		bool m_bIndex;
+		unsigned long long m_nIndexInterval;
+		bool m_bDedupBinary;
+
+		std::string m_sAsyncFileName;
+		std::string m_sExcludeFileName;
+		std::string m_sBinaryFileName;
+		std::string m_sColumnarFileName;
+		std::string m_sIndexFileName;
+		std::string m_sShardIndexFileName;
+
+	private:
+		CLogSegment(const CLogSegment &);
+		CLogSegment & operator=(const CLogSegment &);
+	};
+
+#endif
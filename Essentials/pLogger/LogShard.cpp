@@ -0,0 +1,128 @@
+/*
+ *  LogShard.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogShard.h"
+#include <iostream>
+
+
+CLogShard::CLogShard(const std::string & sName)
+{
+	m_sName = sName;
+	m_bOpen = false;
+	m_bCompress = false;
+	m_nBytes = 0;
+}
+
+CLogShard::~CLogShard()
+{
+	Close();
+}
+
+const std::string & CLogShard::GetName() const
+{
+	return m_sName;
+}
+
+bool CLogShard::Open(const std::string & sFileName, const std::string & sBanner, bool bCompress,
+	const CLogWriter & Writer, const CZipper & Zipper)
+{
+	if(m_bOpen)
+		Close();
+
+	m_bCompress = bCompress;
+	m_nBytes = sBanner.size();
+
+	if(m_bCompress)
+	{
+		m_Zipper.CopySettings(Zipper);
+		m_sFileName = sFileName+m_Zipper.GetExtension();
+
+		//the banner is queued before the zipper thread starts
+		m_Zipper.Push(sBanner);
+		if(!m_Zipper.Start(sFileName))
+		{
+			std::cerr<<"failed to start compressing "<<sFileName<<"\n";
+			return false;
+		}
+	}
+	else
+	{
+		m_Writer.CopySettings(Writer);
+		m_sFileName = sFileName;
+
+		if(!m_Writer.Start(sFileName))
+		{
+			std::cerr<<"failed to open alog shard "<<sFileName<<"\n";
+			return false;
+		}
+		m_Writer.Push(sBanner);
+	}
+
+	m_bOpen = true;
+	return true;
+}
+
+bool CLogShard::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	m_bOpen = false;
+	return m_bCompress ? m_Zipper.Stop() : m_Writer.Stop();
+}
+
+bool CLogShard::IsOpen()
+{
+	return m_bOpen;
+}
+
+bool CLogShard::Push(const std::string & sStr, bool bKeep)
+{
+	if(!m_bOpen)
+		return false;
+
+	if(m_bCompress)
+	{
+		if(!m_Zipper.Push(sStr,bKeep))
+			return false;
+	}
+	else if(!m_Writer.Push(sStr,bKeep))
+	{
+		return false;
+	}
+
+	m_nBytes+=sStr.size();
+	return true;
+}
+
+unsigned long long CLogShard::GetSize()
+{
+	return m_nBytes;
+}
+
+std::string CLogShard::GetFileName()
+{
+	return m_sFileName;
+}
+
+double CLogShard::GetDurableTime()
+{
+	return m_bCompress ? m_Zipper.GetDurableTime() : m_Writer.GetDurableTime();
+}
+
+double CLogShard::GetStagingFill()
+{
+	if(!m_bCompress)
+		return m_Writer.GetStagingFill();
+
+	return m_Zipper.GetQueueLimit()>0 ? (double)m_Zipper.GetQueueDepth()/m_Zipper.GetQueueLimit() : 0;
+}
+
+void CLogShard::MoveWriteLatency(CLatencyHistogram & Total)
+{
+	m_Writer.GetWriteLatency().MoveTo(Total);
+	m_Zipper.GetWriteLatency().MoveTo(Total);
+}
@@ -0,0 +1,83 @@
+/*
+ *  LogShard.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGSHARDH
+#define CLOGSHARDH
+
+#include <string>
+#include "LogWriter.h"
+#include "Zipper.h"
+
+
+/*!
+    @class   CLogShard
+    @abstract    One extra alog - sRootName_name.alog - holding a share of the asynchronous traffic
+    @discussion  With LogShard configured the alog is split between several files (by variable
+				 or by source process) each with its own writer thread and, if alogs are
+				 compressed, its own compression stream - so logging is no longer limited to
+				 what one thread and one file can take. Entries are laid out exactly as in the
+				 alog and every shard begins with the alog's banner.
+
+				 A shard takes all its settings (file backend, durability, staging, codec,
+				 queue limit...) from the segment's alog writers when it is opened, so the
+				 logger configures those alone. Pushed to by the mail thread only.
+*/
+
+class CLogShard
+	{
+	public:
+		CLogShard(const std::string & sName);
+		~CLogShard();
+
+		const std::string & GetName() const;
+
+		/*!
+		 @function   Open
+		 @abstract   start writing sFileName (compressed, with the codec's extension, if bCompress)
+		 @param Writer, Zipper the alog's writers - their settings are copied
+		 */
+		bool Open(const std::string & sFileName, const std::string & sBanner, bool bCompress,
+			const CLogWriter & Writer, const CZipper & Zipper);
+
+		/** write everything queued and close the file (blocking) */
+		bool Close();
+
+		bool IsOpen();
+
+		/** queue entries to be written (waiting for room if bKeep), false if they were discarded */
+		bool Push(const std::string & sStr, bool bKeep = false);
+
+		/** how many (uncompressed) bytes have been queued, including the banner */
+		unsigned long long GetSize();
+
+		/** the name of the file written (with any compression extension) */
+		std::string GetFileName();
+
+		/** the time before which everything pushed is committed (see CLogDurability) */
+		double GetDurableTime();
+
+		/** the fraction (0 to 1) of the staging buffer or compression queue in use */
+		double GetStagingFill();
+
+		/** how long each write and commit to the file took */
+		void MoveWriteLatency(CLatencyHistogram & Total);
+
+	protected:
+		std::string m_sName;
+		std::string m_sFileName;
+		bool m_bOpen;
+		bool m_bCompress;
+		unsigned long long m_nBytes;
+
+		CLogWriter m_Writer;
+		CZipper m_Zipper;
+
+	private:
+		CLogShard(const CLogShard &);
+		CLogShard & operator=(const CLogShard &);
+	};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ *  LogSignal.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogSignal.h"
+
+#ifndef _WIN32
+	#include <sys/time.h>
+	#include <errno.h>
+#endif
+
+
+#ifdef _WIN32
+
+CLogSignal::CLogSignal()
+{
+	//auto reset, initially not signalled
+	m_hEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+CLogSignal::~CLogSignal()
+{
+	::CloseHandle(m_hEvent);
+}
+
+void CLogSignal::Set()
+{
+	::SetEvent(m_hEvent);
+}
+
+bool CLogSignal::Wait(int nTimeOutMS)
+{
+	return ::WaitForSingleObject(m_hEvent, nTimeOutMS)==WAIT_OBJECT_0;
+}
+
+#else
+
+CLogSignal::CLogSignal()
+{
+	m_bSet = false;
+	pthread_mutex_init(&m_Mutex, NULL);
+	pthread_cond_init(&m_Cond, NULL);
+}
+
+CLogSignal::~CLogSignal()
+{
+	pthread_cond_destroy(&m_Cond);
+	pthread_mutex_destroy(&m_Mutex);
+}
+
+void CLogSignal::Set()
+{
+	pthread_mutex_lock(&m_Mutex);
+	m_bSet = true;
+	pthread_cond_signal(&m_Cond);
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+bool CLogSignal::Wait(int nTimeOutMS)
+{
+	struct timeval Now;
+	gettimeofday(&Now, NULL);
+
+	struct timespec Until;
+	long long nNS = (long long)Now.tv_usec*1000 + (long long)nTimeOutMS*1000000;
+	Until.tv_sec = Now.tv_sec + (time_t)(nNS/1000000000);
+	Until.tv_nsec = (long)(nNS%1000000000);
+
+	pthread_mutex_lock(&m_Mutex);
+	int nResult = 0;
+	while(!m_bSet && nResult!=ETIMEDOUT)
+	{
+		nResult = pthread_cond_timedwait(&m_Cond, &m_Mutex, &Until);
+	}
+	bool bWasSet = m_bSet;
+	m_bSet = false;
+	pthread_mutex_unlock(&m_Mutex);
+
+	return bWasSet;
+}
+
+#endif
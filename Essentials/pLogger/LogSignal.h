@@ -0,0 +1,60 @@
+/*
+ *  LogSignal.h
+ *  MOOS
+ *
+ *  A tiny portable auto-reset event used by the pLogger worker threads
+ *
+ */
+
+#ifndef CLOGSIGNALH
+#define CLOGSIGNALH
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+
+/*!
+    @class   CLogSignal
+    @abstract    An auto-reset event which one thread can wait on and another can set
+    @discussion  Used so that worker threads (writers, zippers) sleep until there is work
+				 rather than polling. A Set() with nobody waiting is remembered until the
+				 next Wait()
+*/
+class CLogSignal
+	{
+	public:
+		CLogSignal();
+		~CLogSignal();
+
+		/*!
+		 @function   Set
+		 @abstract   wake (one) waiting thread
+		 */
+		void Set();
+
+		/*!
+		 @function   Wait
+		 @abstract   block until Set() is called or the timeout expires
+		 @param nTimeOutMS how long to wait in milliseconds
+		 @result true if the signal was set, false on timeout
+		 */
+		bool Wait(int nTimeOutMS);
+
+	private:
+		//not copyable
+		CLogSignal(const CLogSignal &);
+		CLogSignal & operator=(const CLogSignal &);
+
+#ifdef _WIN32
+		HANDLE m_hEvent;
+#else
+		pthread_mutex_t m_Mutex;
+		pthread_cond_t m_Cond;
+		bool m_bSet;
+#endif
+	};
+
+#endif
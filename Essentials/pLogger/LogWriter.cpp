@@ -0,0 +1,361 @@
+/*
+ *  LogWriter.cpp
+ *  MOOS
+ *
+ */
+
+#include "LogWriter.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+//how many bytes can be staged by default before Push() has to wait for the disk
+#define LOG_WRITER_CAPACITY (8*1024*1024)
+
+//the most handed to the disk in one write (unless the drain size is bigger) so
+//space is given back to Push() as the ring empties rather than all at the end
+#define LOG_WRITER_MAX_WRITE (4*1024*1024)
+
+//how long (s) data may wait for a drain size to build up if the durability policy doesn't say
+#define LOG_WRITER_STAGING_AGE 1.0
+
+//how long the writer sleeps if nobody wakes it
+#define LOG_WRITER_WAIT_MS 100
+
+
+bool _LogWriterThreadWorker(void * pParam)
+{
+	CLogWriter* pMe = (CLogWriter*) pParam;
+	return pMe->DoWriting();
+}
+
+CLogWriter::CLogWriter()
+{
+	m_nCapacity = LOG_WRITER_CAPACITY;
+	m_nRead = 0;
+	m_nUsed = 0;
+	m_nDrainSize = 0;
+	m_eOverflow = BLOCK;
+	m_nDroppedBytes = 0;
+	m_dfOldest = -1;
+	m_eBackend = CLogFile::BUFFERED;
+	m_nExtent = 0;
+}
+
+void CLogWriter::SetBackend(CLogFile::Mode eMode, size_t nExtent)
+{
+	m_eBackend = eMode;
+	m_nExtent = nExtent;
+}
+
+void CLogWriter::SetDurability(const CLogDurability & Policy)
+{
+	m_Durability.SetPolicy(Policy);
+}
+
+double CLogWriter::GetDurableTime()
+{
+	return m_Durability.GetDurableTime();
+}
+
+void CLogWriter::SetStaging(size_t nCapacity, size_t nDrainSize, OverflowPolicy ePolicy)
+{
+	m_Lock.Lock();
+	{
+		//the ring is only resized while it is empty
+		if(m_nUsed==0 && nCapacity>0)
+			m_nCapacity = nCapacity;
+		m_nDrainSize = std::min(nDrainSize, m_nCapacity);
+		m_eOverflow = ePolicy;
+	}
+	m_Lock.UnLock();
+}
+
+void CLogWriter::CopySettings(const CLogWriter & Other)
+{
+	m_eBackend = Other.m_eBackend;
+	m_nExtent = Other.m_nExtent;
+	m_Durability.SetPolicy(Other.m_Durability);
+	SetStaging(Other.m_nCapacity, Other.m_nDrainSize, Other.m_eOverflow);
+}
+
+double CLogWriter::GetStagingFill()
+{
+	m_Lock.Lock();
+	double dfFill = m_nCapacity>0 ? (double)m_nUsed/m_nCapacity : 0;
+	m_Lock.UnLock();
+	return dfFill;
+}
+
+unsigned long long CLogWriter::GetDroppedBytes()
+{
+	m_Lock.Lock();
+	unsigned long long nDropped = m_nDroppedBytes;
+	m_Lock.UnLock();
+	return nDropped;
+}
+
+CLatencyHistogram & CLogWriter::GetWriteLatency()
+{
+	return m_WriteLatency;
+}
+
+CLogWriter::~CLogWriter()
+{
+	Stop();
+}
+
+bool CLogWriter::Start(const std::string & sFileName, bool bBinary)
+{
+	if(IsRunning())
+		Stop();
+
+	m_sFileName = sFileName;
+
+	if(!m_File.Open(m_sFileName, m_eBackend, m_nExtent, bBinary))
+		return false;
+
+	m_Durability.Reset(MOOSTime());
+
+	//allocate (and so touch every page of) the ring now rather than page
+	//faulting on the mail thread as it first fills
+	m_Lock.Lock();
+	{
+		if(m_Ring.size()!=m_nCapacity)
+			std::vector<char>(m_nCapacity).swap(m_Ring);
+		m_nRead = 0;
+		m_nUsed = 0;
+		m_dfOldest = -1;
+	}
+	m_Lock.UnLock();
+
+	m_Thread.Initialise(_LogWriterThreadWorker, this);
+	return m_Thread.Start();
+}
+
+bool CLogWriter::Stop()
+{
+	bool bOK = true;
+	if(IsRunning())
+	{
+		//wake the writer so it notices the quit request promptly
+		m_DataSignal.Set();
+		bOK = m_Thread.Stop();
+	}
+
+	//the thread drains and closes on the way out, this catches a thread that never ran
+	if(m_File.IsOpen())
+	{
+		WriteQueued(true);
+		m_File.Close();
+		m_Durability.Closed();
+	}
+
+	//a big staging ring isn't held by a closed log
+	m_Lock.Lock();
+	{
+		std::vector<char>().swap(m_Ring);
+		m_nRead = 0;
+		m_nUsed = 0;
+	}
+	m_Lock.UnLock();
+
+	return bOK;
+}
+
+bool CLogWriter::IsRunning()
+{
+	return m_Thread.IsThreadRunning();
+}
+
+bool CLogWriter::Push(const std::string & sStr, bool bKeep)
+{
+	if(sStr.empty())
+		return true;
+
+	const char * pData = sStr.data();
+	size_t nLeft = sStr.size();
+
+	m_Lock.Lock();
+
+	//nothing to stage into (not started) or no room under DROP_NEWEST
+	if(m_Ring.empty() || (m_eOverflow==DROP_NEWEST && !bKeep && nLeft>m_nCapacity-m_nUsed))
+	{
+		m_nDroppedBytes+=nLeft;
+		m_Lock.UnLock();
+		m_DataSignal.Set();
+		return false;
+	}
+
+	//wait for room for the whole string before any of it goes in so a writer stopping
+	//meanwhile can't leave half of it staged (only a string bigger than the ring goes in pieces)
+	size_t nCopied = 0;
+	while(nLeft>0)
+	{
+		//stopped while we waited - the ring has been released
+		if(m_Ring.empty())
+		{
+			m_nDroppedBytes+=nLeft;
+			break;
+		}
+
+		size_t nFree = m_nCapacity-m_nUsed;
+		size_t nNeed = nCopied==0 ? std::min(nLeft, m_nCapacity) : 1;
+		if(nFree<nNeed)
+		{
+			if(!IsRunning())
+			{
+				//take back whatever of this string went in but hasn't been written
+				size_t nUndo = std::min(nCopied, m_nUsed);
+				m_nUsed-=nUndo;
+				m_nDroppedBytes+=nLeft+nUndo;
+				break;
+			}
+
+			//the disk has fallen a whole ring behind - wait for the writer to make room
+			m_Lock.UnLock();
+			m_DataSignal.Set();
+			m_SpaceSignal.Wait(LOG_WRITER_WAIT_MS);
+			m_Lock.Lock();
+			continue;
+		}
+
+		if(m_nUsed==0)
+			m_dfOldest = MOOSLocalTime();
+
+		//copy up to the end of the ring, then round to the start
+		size_t nWrite = (m_nRead+m_nUsed)%m_nCapacity;
+		size_t nChunk = std::min(nLeft, std::min(nFree, m_nCapacity-nWrite));
+		memcpy(&m_Ring[nWrite], pData, nChunk);
+		m_nUsed+=nChunk;
+		nCopied+=nChunk;
+		pData+=nChunk;
+		nLeft-=nChunk;
+	}
+
+	//only wake the writer once there is enough for it to write
+	bool bWake = m_nUsed>=m_nDrainSize;
+
+	m_Lock.UnLock();
+
+	if(bWake)
+		m_DataSignal.Set();
+
+	return nLeft==0;
+}
+
+double CLogWriter::GetMaxStagingAge() const
+{
+	if(m_nDrainSize==0)
+		return 0;
+
+	//never hold data longer than the durability policy would leave it uncommitted
+	double dfPeriod = m_Durability.GetPeriod();
+	return dfPeriod>0 ? std::min(dfPeriod, LOG_WRITER_STAGING_AGE) : LOG_WRITER_STAGING_AGE;
+}
+
+bool CLogWriter::WriteQueued(bool bAll)
+{
+	//everything pushed before now is in this batch
+	double dfQueuedBefore = MOOSTime();
+	double dfSnapshot = MOOSLocalTime();
+
+	size_t nRead;
+	size_t nUsed;
+	double dfOldest;
+	m_Lock.Lock();
+	{
+		nRead = m_nRead;
+		nUsed = m_nUsed;
+		dfOldest = m_dfOldest;
+	}
+	m_Lock.UnLock();
+
+	if(nUsed==0)
+	{
+		m_Durability.Written(0, dfQueuedBefore);
+		return true;
+	}
+
+	//let a drain size build up unless what is there has waited long enough
+	if(!bAll && nUsed<m_nDrainSize && dfSnapshot-dfOldest<GetMaxStagingAge())
+		return true;
+
+	//the writer owns [nRead, nRead+nUsed) so it is written straight from
+	//the ring without the lock, giving space back a piece at a time
+	size_t nMaxWrite = std::max(m_nDrainSize, (size_t)LOG_WRITER_MAX_WRITE);
+	bool bOK = true;
+	size_t nLeft = nUsed;
+	double dfStart = MOOSLocalTime();
+	while(nLeft>0)
+	{
+		size_t nChunk = std::min(nLeft, std::min(nMaxWrite, m_nCapacity-nRead));
+
+		//a failed write is dropped rather than retried forever
+		if(bOK)
+			bOK = m_File.Write(&m_Ring[nRead], nChunk);
+
+		nRead = (nRead+nChunk)%m_nCapacity;
+		nLeft-=nChunk;
+
+		m_Lock.Lock();
+		{
+			m_nRead = nRead;
+			m_nUsed-=nChunk;
+			//what is left was pushed after the snapshot
+			m_dfOldest = m_nUsed>0 ? dfSnapshot : -1;
+		}
+		m_Lock.UnLock();
+
+		m_SpaceSignal.Set();
+	}
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+
+	if(!bOK)
+	{
+		std::cerr<<"failed writing to "<<m_sFileName<<"\n";
+		return false;
+	}
+
+	m_Durability.Written(nUsed, dfQueuedBefore);
+	return true;
+}
+
+bool CLogWriter::Commit()
+{
+	double dfStart = MOOSLocalTime();
+	bool bOK = m_Durability.GetMode()==CLogDurability::SYNC ? m_File.Sync() : m_File.Flush();
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+	if(!bOK)
+	{
+		std::cerr<<"failed committing "<<m_sFileName<<"\n";
+		return false;
+	}
+
+	m_Durability.Committed(MOOSTime());
+	return true;
+}
+
+bool CLogWriter::DoWriting()
+{
+	while(!m_Thread.IsQuitRequested())
+	{
+		m_DataSignal.Wait(m_Durability.GetWaitMS(LOG_WRITER_WAIT_MS));
+
+		WriteQueued(false);
+
+		//one commit covers everything written since the last
+		if(m_Durability.IsCommitDue(MOOSTime()))
+			Commit();
+	}
+
+	//make sure nothing queued is lost
+	WriteQueued(true);
+	if(m_Durability.GetMode()!=CLogDurability::NONE)
+		Commit();
+	m_File.Close();
+	m_Durability.Closed();
+
+	return true;
+}
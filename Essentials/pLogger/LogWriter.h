@@ -0,0 +1,174 @@
+/*
+ *  LogWriter.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGWRITERH
+#define CLOGWRITERH
+
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include <string>
+#include <vector>
+#include "LogFile.h"
+#include "LogSignal.h"
+#include "LogDurability.h"
+#include "LatencyHistogram.h"
+
+
+/*!
+    @class   CLogWriter
+    @abstract    Launches a thread to write strings to a regular (uncompressed) log file
+    @discussion  The uncompressed sibling of CZipper. Strings pushed by the mail thread are
+				 copied into a preallocated ring in RAM which the writer thread drains to disk -
+				 a slow disk is never touched by the caller. The writer reads straight from
+				 the ring so nothing is copied twice.
+
+				 By default the writer takes whatever is there each time it wakes. To suit
+				 storage which likes large writes (and stalls now and then) the ring can be made
+				 large and the writer told to wait until a drain size has built up - or the
+				 oldest staged data has waited as long as the durability policy allows - so the
+				 disk sees big sequential writes while stalls are soaked up by RAM. When the
+				 ring is full Push() either waits for the writer (BLOCK) or discards what it
+				 was given (DROP_NEWEST).
+
+				 The ring is in process memory so whatever is staged dies with pLogger - a ring
+				 on tmpfs would survive pLogger crashing or being killed (though not the
+				 machine going down). It is kept in process for now because the mail thread
+				 copies into it without any system call.
+
+				 When the writer commits what it has written (flush or fdatasync) is set by a
+				 CLogDurability policy - by default it never does until the file is closed.
+*/
+
+class CLogWriter
+	{
+	public:
+		/*!
+		 @enum OverflowPolicy
+		 @abstract what Push() does when the ring is full
+		 @constant BLOCK wait for the writer to make room (nothing is lost)
+		 @constant DROP_NEWEST discard the string being pushed
+		 */
+		enum OverflowPolicy
+		{
+			BLOCK,
+			DROP_NEWEST
+		};
+
+		CLogWriter();
+		~CLogWriter();
+
+		/*!
+		 @function     Start
+		 @abstract   Open the named file and start the writing thread
+		 @discussion The file is opened synchronously so that failure can be reported
+		 @param	sFileName  the name of the file to write
+		 @param bBinary open in binary mode (no newline translation)
+		 */
+		bool Start(const std::string & sFileName, bool bBinary = false);
+
+		/*!
+		 @function   SetBackend
+		 @abstract   choose how the file is written (see CLogFile), set before Start()
+		 @param nExtent preallocation step in bytes, 0 for the default
+		 */
+		void SetBackend(CLogFile::Mode eMode, size_t nExtent = 0);
+
+		/*!
+		 @function   SetDurability
+		 @abstract   when the writer thread commits what it has written, set before Start()
+		 */
+		void SetDurability(const CLogDurability & Policy);
+
+		/*!
+		 @function   SetStaging
+		 @abstract   how much is staged in RAM and how it is drained, set before Start()
+		 @param nCapacity size of the ring in bytes
+		 @param nDrainSize the least the writer writes at once (0 for whatever there is)
+		 @param ePolicy what happens when the ring is full
+		 */
+		void SetStaging(size_t nCapacity, size_t nDrainSize, OverflowPolicy ePolicy);
+
+		/** take the backend, durability and staging settings of another writer, set before Start() */
+		void CopySettings(const CLogWriter & Other);
+
+		/** the fraction (0 to 1) of the ring in use */
+		double GetStagingFill();
+
+		/** bytes discarded because the ring was full */
+		unsigned long long GetDroppedBytes();
+
+		/** the time before which everything pushed is committed (see CLogDurability) */
+		double GetDurableTime();
+
+		/** how long each write and commit to the file took */
+		CLatencyHistogram & GetWriteLatency();
+
+		/*!
+		 @function Stop
+		 @abstract   Stop writing, flushing everything pushed so far and closing the file
+		 @discussion  blocking call
+		 */
+		bool Stop();
+
+		/*!
+		 @function IsRunning
+		 @abstract   returns true if the writer is active
+		 */
+		bool IsRunning();
+
+		/*!
+		 @function   Push
+		 @abstract   Queue a string to be written
+		 @discussion Cheap - a copy into the ring. Only blocks if the ring is full
+					 and the overflow policy is BLOCK (or bKeep is set)
+		 @param sStr  the string which should be appended to the file
+		 @param bKeep wait for room rather than discard it, whatever the policy
+		 @return false if the string was discarded
+		 */
+		bool Push(const std::string & sStr, bool bKeep = false);
+
+		//worker function
+		bool DoWriting();
+
+	protected:
+
+		/** write what is staged - if bAll is false only if there is enough or it is old enough */
+		bool WriteQueued(bool bAll);
+
+		/** how long staged data may wait for a drain size to build up (s) */
+		double GetMaxStagingAge() const;
+
+		/** flush (or sync) the file as the durability policy says */
+		bool Commit();
+
+		CMOOSLock   m_Lock;
+		CMOOSThread m_Thread;
+
+		//set by Push() when there is data, by the writer when there is space
+		CLogSignal m_DataSignal;
+		CLogSignal m_SpaceSignal;
+
+		//the mail thread fills the ring at m_nRead+m_nUsed, the writer empties it from m_nRead
+		std::vector<char> m_Ring;
+		size_t m_nCapacity;
+		size_t m_nRead;
+		size_t m_nUsed;
+		size_t m_nDrainSize;
+		OverflowPolicy m_eOverflow;
+		unsigned long long m_nDroppedBytes;
+
+		//when the oldest byte in the ring was pushed (MOOSLocalTime)
+		double m_dfOldest;
+
+		std::string m_sFileName;
+		CLogFile m_File;
+		CLogFile::Mode m_eBackend;
+		size_t m_nExtent;
+		CLogDurability m_Durability;
+		CLatencyHistogram m_WriteLatency;
+
+	};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ *  LoggerStats.cpp
+ *  MOOS
+ *
+ */
+
+#include "LoggerStats.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/statvfs.h>
+#endif
+
+
+CLoggerStats::CLoggerStats()
+{
+	for(int i = 0;i<NUM_FILES;i++)
+	{
+		m_Messages[i] = 0;
+		m_Bytes[i] = 0;
+		m_LastMessages[i] = 0;
+		m_LastBytes[i] = 0;
+		m_MessageRates[i] = 0;
+		m_ByteRates[i] = 0;
+	}
+	m_dfLastUpdate = -1;
+}
+
+void CLoggerStats::Update(double dfTimeNow)
+{
+	double dfInterval = dfTimeNow-m_dfLastUpdate;
+
+	for(int i = 0;i<NUM_FILES;i++)
+	{
+		//the first call only marks the start of the first interval
+		if(m_dfLastUpdate>=0 && dfInterval>0)
+		{
+			m_MessageRates[i] = (m_Messages[i]-m_LastMessages[i])/dfInterval;
+			m_ByteRates[i] = (m_Bytes[i]-m_LastBytes[i])/dfInterval;
+		}
+		m_LastMessages[i] = m_Messages[i];
+		m_LastBytes[i] = m_Bytes[i];
+	}
+
+	m_dfLastUpdate = dfTimeNow;
+}
+
+double CLoggerStats::GetMessageRate(File eFile)
+{
+	return m_MessageRates[eFile];
+}
+
+double CLoggerStats::GetByteRate(File eFile)
+{
+	return m_ByteRates[eFile];
+}
+
+unsigned long long CLoggerStats::GetMessages(File eFile)
+{
+	return m_Messages[eFile];
+}
+
+unsigned long long CLoggerStats::GetBytes(File eFile)
+{
+	return m_Bytes[eFile];
+}
+
+const char * CLoggerStats::GetFileName(File eFile)
+{
+	switch(eFile)
+	{
+		case ALOG: return "alog";
+		case XLOG: return "xlog";
+		case BLOG: return "blog";
+		case CLOG: return "clog";
+		case SLOG: return "slog";
+		case BSLOG: return "bslog";
+		case YLOG: return "ylog";
+		default: return "";
+	}
+}
+
+double CLoggerStats::GetFreeDiskSpace(const std::string & sDirectory)
+{
+#ifdef _WIN32
+	ULARGE_INTEGER nFree;
+	if(!GetDiskFreeSpaceExA(sDirectory.c_str(),&nFree,NULL,NULL))
+		return -1;
+	return (double)nFree.QuadPart;
+#else
+	struct statvfs Info;
+	if(statvfs(sDirectory.c_str(),&Info)!=0)
+		return -1;
+	//what an unprivileged process like us may use, not counting the root reserve
+	return (double)Info.f_bavail*Info.f_frsize;
+#endif
+}
@@ -0,0 +1,80 @@
+/*
+ *  LoggerStats.h
+ *  MOOS
+ *
+ */
+
+#ifndef CLOGGERSTATSH
+#define CLOGGERSTATSH
+
+#include <string>
+
+
+/*!
+    @class   CLoggerStats
+    @abstract    Counts what pLogger writes to each of its files and turns that into rates
+    @discussion  The mail and iterate code call Count() as they hand data to a file - that is
+				 two additions, cheap enough for every message. Every so often Update() works
+				 out messages and bytes per second since the previous Update().
+
+				 Not thread safe - everything is counted on the application thread.
+*/
+
+class CLoggerStats
+	{
+	public:
+		enum File
+		{
+			ALOG,
+			XLOG,
+			BLOG,
+			CLOG,
+			SLOG,
+			BSLOG,
+			YLOG,
+			NUM_FILES
+		};
+
+		CLoggerStats();
+
+		/** nMessages (entries, rows) and nBytes have been handed to a file */
+		void Count(File eFile, unsigned long long nMessages, unsigned long long nBytes)
+		{
+			m_Messages[eFile]+=nMessages;
+			m_Bytes[eFile]+=nBytes;
+		}
+
+		/** work out the rates over the time since the last Update() */
+		void Update(double dfTimeNow);
+
+		/** messages per second over the last interval */
+		double GetMessageRate(File eFile);
+
+		/** bytes per second over the last interval */
+		double GetByteRate(File eFile);
+
+		/** messages counted for a file altogether */
+		unsigned long long GetMessages(File eFile);
+
+		/** bytes counted for a file altogether */
+		unsigned long long GetBytes(File eFile);
+
+		/** the extension of a file e.g "alog" */
+		static const char * GetFileName(File eFile);
+
+		/** bytes free to us on the disk holding sDirectory, -1 if we can't tell */
+		static double GetFreeDiskSpace(const std::string & sDirectory);
+
+	protected:
+		unsigned long long m_Messages[NUM_FILES];
+		unsigned long long m_Bytes[NUM_FILES];
+
+		//counts at the last Update() and the rates since the one before
+		unsigned long long m_LastMessages[NUM_FILES];
+		unsigned long long m_LastBytes[NUM_FILES];
+		double m_MessageRates[NUM_FILES];
+		double m_ByteRates[NUM_FILES];
+		double m_dfLastUpdate;
+	};
+
+#endif
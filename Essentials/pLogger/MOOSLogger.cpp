@@ -45,7 +45,9 @@
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
+#include <cctype>
 #include <cstring>
+#include <limits>
 
 
 #ifndef _WIN32
@@ -66,10 +68,33 @@ using namespace std;
 #define DEFAULT_MONITOR_TIME 10.0
 #define MIN_SYNC_LOG_PERIOD 0.1
 #define DYNAMIC_NAME_SPACE 64
-#define DEFAULT_WILDCARD_TIME 1.0 //how often to call into the DB to get a list of all variables if wild card loggin is turned on
 #define DEFAULT_DOUBLE_PRECISION  5 //how many DP to use when logging double time stamps
-
-
+#define DEFAULT_DURABILITY "flush:1000ms" //when logs are flushed or synced unless told otherwise
+#define SYNC_COMMIT_PERIOD 1.0 //how often the slog and ylog are committed if the policy only gives an amount
+#define DURABLE_TIME_PUBLISH_PERIOD 1.0 //how often LOGGER_DURABLE_TIME is published
+#define DEFAULT_STATS_PERIOD 5.0 //how often PLOGGER_STATS is published
+#define BINARY_SLOG_HEADER_ALIGNMENT 4096 //rows in a .bslog start at a multiple of this
+#define DEFAULT_ALOG_INDEX_INTERVAL 64 //how many KB of alog between time entries in the .aidx
+#define ROTATION_PREPARE_FRACTION 0.9 //how full a segment is before its successor is prepared
+#define ROTATION_PREPARE_LEAD 30.0 //at most how many seconds before a timed rotation the next segment is prepared
+#define ROTATION_RETRY_MS 1000 //how long to wait before trying again to open a segment which failed to open
+#define DEFAULT_STAGING_DRAIN_SIZE 4 //how many MB are staged before being written out if StagingBuffer is set
+#define DEFAULT_STAGING_HIGH_WATER 80 //how full (%) the staging buffers get before LOGGER_STAGING_ALARM is raised
+#define SNAPSHOT_RETRY_PERIOD 1.0 //how long a snapshot waits if the last one is still being written
+#define DEFAULT_SHED_HIGH_WATER 80 //how full (%) the staging buffers stay before traffic is shed
+#define DEFAULT_SHED_AFTER 2.0 //how many seconds the fill must stay high (or low) before the shedding level changes
+#define DEFAULT_SHED_DECIMATION 10 //decimated traffic keeps one message in this many
+#define MAX_SHED_LEVEL 3 //bulk decimated, bulk dropped, normal decimated too
+#define SHED_REPORT_PERIOD 1.0 //how often what has been shed is written to the ylog
+#define LATENCY_REPORT_VARIABLES 20 //how many of the slowest variables PLOGGER_LATENCY lists
+
+
+
+bool _RotationThreadWorker(void * pParam)
+{
+	CMOOSLogger* pMe = (CMOOSLogger*) pParam;
+	return pMe->DoRotation();
+}
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -88,6 +113,10 @@ CMOOSLogger::CMOOSLogger()
     //by default make an a-log
     m_bAsynchronousLog = true;
 
+    //no wildcard patterns yet
+    m_nWildCardVersion = 0;
+    m_bWildCardSubscribed = false;
+
     //by default make an s-log
     m_bSynchronousLog = true;
 
@@ -103,6 +132,42 @@ CMOOSLogger::CMOOSLogger()
     //no s-log lines written yet
     m_nSyncLines = 0;
 
+    //by default slogs are text
+    m_bTextSyncLog = true;
+    m_bBinarySyncLog = false;
+    m_nResolvedSyncVars = 0;
+
+    //data reaches the OS at least once a second
+    m_Durability.Parse(DEFAULT_DURABILITY);
+    m_dfLastSyncCommitTime = 0;
+    m_dfSyncDurableTime = -1;
+    m_dfLastDurablePublishTime = 0;
+
+    m_dfStatsPeriod = DEFAULT_STATS_PERIOD;
+    m_dfLastStatsTime = 0;
+    m_bStatsConsole = false;
+    m_nWildCardVars = 0;
+    m_nPolicyEpoch = 0;
+    m_nSuppressedMsgs = 0;
+    m_dfStagingHighWater = DEFAULT_STAGING_HIGH_WATER/100.0;
+    m_bStagingAlarm = false;
+    m_nStagingDroppedMsgs = 0;
+    m_dfSnapshotAfter = 0;
+    m_dfSnapshotDue = -1;
+    m_nSnapshots = 0;
+    m_bOverloadShedding = false;
+    m_dfShedHighWater = DEFAULT_SHED_HIGH_WATER/100.0;
+    m_dfShedAfter = DEFAULT_SHED_AFTER;
+    m_nShedDecimation = DEFAULT_SHED_DECIMATION;
+    m_nShedLevel = 0;
+    m_nShedDirection = 0;
+    m_dfShedSince = 0;
+    m_dfLastShedReport = 0;
+    m_nShedMsgs = 0;
+    m_nShedReported = 0;
+    m_bLogReceiveTime = false;
+    m_bLatencyStats = false;
+
     //by default (if no mission file is specified) log to a local directory
     m_sPath = "./";
 
@@ -124,6 +189,29 @@ CMOOSLogger::CMOOSLogger()
 	//by default do not indicate data tyep with a D: or S: suffix
 	m_bMarkDataType = false;
 
+	//by default alogs are text
+	m_bTextAlog = true;
+	m_bColumnarLog = false;
+
+	//by default no seek index is written
+	m_bIndexAlog = false;
+	m_nAlogIndexInterval = DEFAULT_ALOG_INDEX_INTERVAL*1024;
+
+	//by default every binary payload is written out in full
+	m_bDedupBinary = false;
+
+	//by default one segment per session - no rotation
+	m_pSegment = &m_Segments[0];
+	m_nRotateBytes = 0;
+	m_dfRotatePeriod = 0;
+	m_nSegment = 0;
+	m_dfSegmentStartTime = 0;
+	m_eSpareState = SPARE_FREE;
+
+	//by default the alog is a single file
+	m_bShardBySource = false;
+	m_nShardBatch = 0;
+
     //lets always sort mail by time...
     SortMailByTime(true);
 
@@ -132,6 +220,10 @@ CMOOSLogger::CMOOSLogger()
 CMOOSLogger::~CMOOSLogger()
 {
 	ShutDown();
+
+	std::map<std::string, CLatencyHistogram*>::iterator q;
+	for(q = m_Latencies.begin();q!=m_Latencies.end();q++)
+		delete q->second;
 }
 
 bool CMOOSLogger::ShutDown()
@@ -143,33 +235,44 @@ bool CMOOSLogger::ShutDown()
 
 bool CMOOSLogger::CloseFiles()
 {
-    if(m_AsyncLogFile.is_open())
-    {
-        m_AsyncLogFile.close();
-    }
+	//let the rotation thread finish closing any retired segment
+	if(m_RotationThread.IsThreadRunning())
+	{
+		m_RotationSignal.Set();
+		m_RotationThread.Stop();
+	}
+
+    //blocks until everything queued has reached the disk
+	m_pSegment->Close();
+
+	//a spare made ready for a rotation which never came isn't wanted
+	CLogSegment & rSpare = m_pSegment==&m_Segments[0] ? m_Segments[1] : m_Segments[0];
+	if(m_eSpareState==SPARE_READY)
+		rSpare.Discard();
+	else
+		rSpare.Close();
+	m_eSpareState = SPARE_FREE;
+
+    //the segment writers commit as they stop - do the same for the slog and ylog
+    if(m_Durability.GetMode()!=CLogDurability::NONE)
+        CommitSyncFiles(MOOSTime());
+    m_dfSyncDurableTime = -1;
 
     if(m_SyncLogFile.is_open())
     {
         m_SyncLogFile.close();
     }
 
+    if(m_BinarySyncLogFile.is_open())
+    {
+        m_BinarySyncLogFile.close();
+    }
+
     if(m_SystemLogFile.is_open())
     {
         m_SystemLogFile.close();
     }
-	
-	//crucially make sure teh zipping thread has stopped
 
-#ifdef ZLIB_FOUND
-	
-	m_AlogZipper.Stop();
-	
-	if(m_bUseExcludedLog)
-	{
-	   m_XlogZipper.Stop();
-	}
-
-#endif
     return true;
 
 }
@@ -183,17 +286,23 @@ bool CMOOSLogger::OnConnectToServer()
     //additional variables that are intersting to us..
     m_Comms.Register("LOGGER_RESTART",0.5);
 
+    //MOOSTime() may have been stepped while we were away (eg by the skew found on connecting) - line up receive times again
+    m_ReceiveClock.Anchor();
+
+    //and everything we might wildcard log (or record)
+    if(m_bWildCardLogging || m_FlightRecorder.IsEnabled())
+        RegisterWildCards();
+
     return true;
 }
 
 bool CMOOSLogger::OnNewMail(MOOSMSG_LIST &NewMail)
 {
-    //these three calls look through the incoming mail
-    //and handle all appropriate logging
+    //these two calls look through the incoming mail and handle all
+    //appropriate logging - DoAsyncLog also keeps our variables up to date
+    //and admits variables which arrive through wildcard subscriptions
     DoAsyncLog(NewMail);
 
-    UpdateMOOSVariables(NewMail);
-
     LogSystemMessages(NewMail);
 
     //here we look for more unusual things
@@ -211,6 +320,12 @@ bool CMOOSLogger::OnNewMail(MOOSMSG_LIST &NewMail)
             OnLoggerRestart();
         }
 
+        //has something happened worth a snapshot?
+        if(!m_FlightRecorderTriggers.empty() && m_FlightRecorderTriggers.count(q->GetKey())>0)
+        {
+            RequestSnapshot(q->GetKey());
+        }
+
     }
 
     return true;
@@ -221,8 +336,8 @@ bool CMOOSLogger::OnStartUp()
 {
     //alway subscribe to these variables
     //they make up the sync log
-    AddMOOSVariable("MOOS_DEBUG","MOOS_DEBUG","",0);
-    AddMOOSVariable("MOOS_SYSTEM","MOOS_SYSTEM","",0);
+    AddLoggedVariable("MOOS_DEBUG",0);
+    AddLoggedVariable("MOOS_SYSTEM",0);
 
 	m_bSynchronousLog = false;
     //are we required to perform synchronous logs?
@@ -276,6 +391,231 @@ bool CMOOSLogger::OnStartUp()
 
     m_MissionReader.GetConfigurationParam("MarkDataType",m_bMarkDataType);
 
+	//do we want text alogs, binary columnar clogs or both?
+	std::string sLogFormat = "text";
+	m_MissionReader.GetConfigurationParam("LogFormat",sLogFormat);
+	if(MOOSStrCmp(sLogFormat,"columnar"))
+	{
+		m_bTextAlog = false;
+		m_bColumnarLog = true;
+	}
+	else if(MOOSStrCmp(sLogFormat,"both"))
+	{
+		m_bTextAlog = true;
+		m_bColumnarLog = true;
+	}
+	else if(!MOOSStrCmp(sLogFormat,"text"))
+	{
+		MOOSTrace("warning:\n\tLogFormat must be one of text, columnar or both - using text\n");
+	}
+
+	//do we want text slogs, binary (.bslog) rows of doubles or both?
+	std::string sSyncLogFormat = "text";
+	m_MissionReader.GetConfigurationParam("SyncLogFormat",sSyncLogFormat);
+	if(MOOSStrCmp(sSyncLogFormat,"binary"))
+	{
+		m_bTextSyncLog = false;
+		m_bBinarySyncLog = true;
+	}
+	else if(MOOSStrCmp(sSyncLogFormat,"both"))
+	{
+		m_bTextSyncLog = true;
+		m_bBinarySyncLog = true;
+	}
+	else if(!MOOSStrCmp(sSyncLogFormat,"text"))
+	{
+		MOOSTrace("warning:\n\tSyncLogFormat must be one of text, binary or both - using text\n");
+	}
+
+	//do we want a seek index written alongside the alog?
+	m_MissionReader.GetConfigurationParam("IndexAlogs",m_bIndexAlog);
+	int nIndexInterval = DEFAULT_ALOG_INDEX_INTERVAL;
+	if(m_MissionReader.GetConfigurationParam("AlogIndexInterval",nIndexInterval) && nIndexInterval>0)
+	{
+		m_nAlogIndexInterval = (unsigned long long)nIndexInterval*1024;
+	}
+
+	//should repeated binary payloads be stored once in the blog?
+	m_MissionReader.GetConfigurationParam("DedupBinary",m_bDedupBinary);
+	int nDedupCacheMB = 0;
+	if(m_MissionReader.GetConfigurationParam("DedupBinaryCache",nDedupCacheMB) && nDedupCacheMB>0)
+	{
+		for(int i = 0;i<2;i++)
+			m_Segments[i].m_BinaryLog.SetDedupCacheSize((size_t)nDedupCacheMB*1024*1024);
+	}
+
+	//how do the alog, xlog and clog get to disk? (see CLogFile)
+	std::string sBackend;
+	if(m_MissionReader.GetConfigurationParam("FileBackend",sBackend))
+	{
+		CLogFile::Mode eBackend = CLogFile::BUFFERED;
+		if(!CLogFile::ParseMode(sBackend,eBackend))
+			MOOSTrace("warning:\n\tFileBackend must be one of buffered, preallocate, direct or mmap - using buffered\n");
+
+		int nExtentMB = 0;
+		m_MissionReader.GetConfigurationParam("FileExtent",nExtentMB);
+		size_t nExtent = nExtentMB>0 ? (size_t)nExtentMB*1024*1024 : 0;
+
+		for(int i = 0;i<2;i++)
+		{
+			m_Segments[i].m_AlogWriter.SetBackend(eBackend,nExtent);
+			m_Segments[i].m_XlogWriter.SetBackend(eBackend,nExtent);
+			m_Segments[i].m_ColumnarLog.SetBackend(eBackend,nExtent);
+		}
+	}
+
+	//when are logs committed - "none", "flush:N ms" or "fdatasync:N ms" and/or "fdatasync:N MB"
+	std::string sDurability;
+	if(m_MissionReader.GetConfigurationParam("Durability",sDurability) && !m_Durability.Parse(sDurability))
+		MOOSTrace("warning:\n\tDurability must be none, flush:N ms or fdatasync:N ms[,N MB] - using %s\n",DEFAULT_DURABILITY);
+
+	for(int i = 0;i<2;i++)
+		m_Segments[i].SetDurability(m_Durability);
+
+	//when to raise LOGGER_STAGING_ALARM (% full of the fullest staging buffer or compression queue)
+	double dfHighWater = DEFAULT_STAGING_HIGH_WATER;
+	if(m_MissionReader.GetConfigurationParam("StagingHighWater",dfHighWater))
+	{
+		if(dfHighWater<=0 || dfHighWater>100)
+		{
+			MOOSTrace("warning:\n\tStagingHighWater must be a percentage - using %d\n",DEFAULT_STAGING_HIGH_WATER);
+			dfHighWater = DEFAULT_STAGING_HIGH_WATER;
+		}
+		m_dfStagingHighWater = dfHighWater/100.0;
+	}
+
+	//shed bulk (and then normal) traffic when the disk can't keep up? - critical is never shed
+	m_MissionReader.GetConfigurationParam("OverloadShedding",m_bOverloadShedding);
+	if(m_bOverloadShedding)
+	{
+		double dfShedHighWater = DEFAULT_SHED_HIGH_WATER;
+		if(m_MissionReader.GetConfigurationParam("ShedHighWater",dfShedHighWater) && (dfShedHighWater<=0 || dfShedHighWater>100))
+		{
+			MOOSTrace("warning:\n\tShedHighWater must be a percentage - using %d\n",DEFAULT_SHED_HIGH_WATER);
+			dfShedHighWater = DEFAULT_SHED_HIGH_WATER;
+		}
+		m_dfShedHighWater = dfShedHighWater/100.0;
+
+		if(m_MissionReader.GetConfigurationParam("ShedAfter",m_dfShedAfter) && m_dfShedAfter<0)
+			m_dfShedAfter = DEFAULT_SHED_AFTER;
+
+		int nDecimation = DEFAULT_SHED_DECIMATION;
+		if(m_MissionReader.GetConfigurationParam("ShedDecimation",nDecimation) && nDecimation<1)
+		{
+			MOOSTrace("warning:\n\tShedDecimation must be 1 or more - using %d\n",DEFAULT_SHED_DECIMATION);
+			nDecimation = DEFAULT_SHED_DECIMATION;
+		}
+		m_nShedDecimation = (unsigned int)nDecimation;
+	}
+
+	//how often to publish PLOGGER_STATS (0 for never) and whether to show them on the console
+	m_MissionReader.GetConfigurationParam("StatsPeriod",m_dfStatsPeriod);
+	m_bStatsConsole = GetFlagFromCommandLineOrConfigurationFile("stats");
+	if(m_bStatsConsole && m_dfStatsPeriod<=0)
+		m_dfStatsPeriod = DEFAULT_STATS_PERIOD;
+
+	//note when mail arrives - in the alog and/or as per variable latencies published with the stats
+	m_MissionReader.GetConfigurationParam("LogReceiveTime",m_bLogReceiveTime);
+	m_MissionReader.GetConfigurationParam("LatencyStats",m_bLatencyStats);
+	if(m_bLatencyStats && m_dfStatsPeriod<=0)
+		m_dfStatsPeriod = DEFAULT_STATS_PERIOD;
+	m_ReceiveClock.Anchor();
+
+	//keep the last few seconds of everything in memory for snapshots? e.g "60s", "256MB" or "60s,256MB"
+	std::string sFlightRecorder;
+	if(m_MissionReader.GetConfigurationParam("FlightRecorder",sFlightRecorder))
+	{
+		if(!m_FlightRecorder.Parse(sFlightRecorder))
+		{
+			MOOSTrace("warning:\n\tFlightRecorder must be a time (s, min) and/or a size (MB, GB) e.g 60s or 60s,256MB - not recording\n");
+		}
+		else
+		{
+			m_FlightRecorder.SetFormat(m_bMarkDataType,m_nDoublePrecision);
+
+			//variables whose every write takes a snapshot
+			std::string sTriggers;
+			m_MissionReader.GetConfigurationParam("FlightRecorderTrigger",sTriggers);
+			MOOSRemoveChars(sTriggers," \t");
+			while(!sTriggers.empty())
+				m_FlightRecorderTriggers.insert(MOOSChomp(sTriggers,","));
+
+			//how long after the request the snapshot is taken
+			m_MissionReader.GetConfigurationParam("FlightRecorderAfter",m_dfSnapshotAfter);
+		}
+	}
+
+	//split the alog between several files, each with its own writer thread?
+	if(!ConfigureShards())
+		return false;
+
+	//stage the alog, xlog and clog in RAM (StagingBuffer MB each) and write them out in
+	//large pieces (StagingDrainSize MB) so the disk sees big sequential writes and its
+	//stalls are soaked up by memory. Read once the shards (which copy it) are known
+	int nStagingMB = 0;
+	if(m_MissionReader.GetConfigurationParam("StagingBuffer",nStagingMB) && nStagingMB>0)
+	{
+		int nDrainMB = std::min(DEFAULT_STAGING_DRAIN_SIZE,nStagingMB);
+		if(m_MissionReader.GetConfigurationParam("StagingDrainSize",nDrainMB) && (nDrainMB<0 || nDrainMB>nStagingMB))
+		{
+			nDrainMB = std::min(DEFAULT_STAGING_DRAIN_SIZE,nStagingMB);
+			MOOSTrace("warning:\n\tStagingDrainSize must be between 0 and StagingBuffer - using %d MB\n",nDrainMB);
+		}
+
+		CLogWriter::OverflowPolicy eStagingPolicy = CLogWriter::BLOCK;
+		std::string sStagingPolicy;
+		if(m_MissionReader.GetConfigurationParam("StagingOverflowPolicy",sStagingPolicy))
+		{
+			if(MOOSStrCmp(sStagingPolicy,"drop_newest"))
+				eStagingPolicy = CLogWriter::DROP_NEWEST;
+			else if(!MOOSStrCmp(sStagingPolicy,"block"))
+				MOOSTrace("warning:\n\tStagingOverflowPolicy must be one of block or drop_newest - using block\n");
+		}
+
+		//the indexes are written as batches are queued - a batch dropped afterwards
+		//would leave its entries behind, pointing at bytes the next batch overwrites
+		if(eStagingPolicy!=CLogWriter::BLOCK && (m_bIndexAlog || !m_ShardNames.empty()))
+		{
+			MOOSTrace("warning:\n\tStagingOverflowPolicy %s would corrupt the alog and shard indexes (IndexAlogs, LogShard) - using block\n",sStagingPolicy.c_str());
+			eStagingPolicy = CLogWriter::BLOCK;
+		}
+
+		for(int i = 0;i<2;i++)
+			m_Segments[i].SetStaging((size_t)nStagingMB*1024*1024,(size_t)nDrainMB*1024*1024,eStagingPolicy);
+	}
+
+	//start a new segment of alog, xlog, blog and clog every so often? e.g "1GB", "10min" or "1GB,1h"
+	std::string sRotation;
+	if(m_MissionReader.GetConfigurationParam("RotateEvery",sRotation) && !ParseRotation(sRotation))
+	{
+		MOOSTrace("warning:\n\tRotateEvery must be a size (B, KB, MB, GB) and/or a time (s, min, h, d) e.g 1GB or 10min - not rotating\n");
+		m_nRotateBytes = 0;
+		m_dfRotatePeriod = 0;
+	}
+
+	//and compress the alog and xlog of a segment once it is closed? (names a codec as for CompressAlogs)
+	std::string sCompressRotated;
+	if(m_MissionReader.GetConfigurationParam("CompressRotated",sCompressRotated))
+	{
+		if(MOOSStrCmp(sCompressRotated,"TRUE") || sCompressRotated=="1")
+			sCompressRotated = "gzip";
+		if(MOOSStrCmp(sCompressRotated,"FALSE") || sCompressRotated=="0")
+			sCompressRotated = "";
+
+		CLogCodec * pCodec = sCompressRotated.empty() ? NULL : CLogCodec::Create(sCompressRotated);
+		if(pCodec!=NULL)
+		{
+			m_sCompressRotated = sCompressRotated;
+			delete pCodec;
+		}
+		else if(!sCompressRotated.empty())
+		{
+			MOOSTrace("warning:\n\tCompressRotated codec \"%s\" is not available (built with \"%s\") - rotated logs will not be compressed\n",
+				sCompressRotated.c_str(),
+				CLogCodec::GetAvailable().c_str());
+		}
+	}
+
     //do we have a path global name?
     if(!m_MissionReader.GetValue("GLOBALLOGPATH",m_sPath))
     {
@@ -305,16 +645,134 @@ bool CMOOSLogger::OnStartUp()
     m_MissionReader.GetConfigurationParam("FILE",m_sStemFileName);
 
 
-	//do we want to do zip logging
+	//do we want to do zip logging - "true" means gzip otherwise name a
+	//codec as codec[:level] e.g zstd:3, lz4 or gzip:6
 	m_bCompressAlog = false;
-	m_MissionReader.GetConfigurationParam("CompressAlogs",m_bCompressAlog);
+	std::string sCompress;
+	if(m_MissionReader.GetConfigurationParam("CompressAlogs",sCompress))
+	{
+		std::string sCodec = sCompress;
+		if(MOOSStrCmp(sCompress,"TRUE") || sCompress=="1")
+			sCodec = "gzip";
+		m_bCompressAlog = !(MOOSStrCmp(sCompress,"FALSE") || sCompress=="0");
 	
-	if(m_bCompressAlog)
+		CLogSegment & rFirst = m_Segments[0];
+		if(m_bCompressAlog)
+		{
+			if(!rFirst.m_AlogZipper.SetCodec(sCodec))
+			{
+				//fall back to whatever we do have
+				if(!rFirst.m_AlogZipper.HasCodec())
+				{
+					std::string sAvailable = CLogCodec::GetAvailable();
+					rFirst.m_AlogZipper.SetCodec(MOOSChomp(sAvailable,","));
+				}
+				MOOSTrace("warning:\n\tcompression codec \"%s\" is not available (built with \"%s\") - using %s\n",
+					sCodec.c_str(),
+					CLogCodec::GetAvailable().c_str(),
+					rFirst.m_AlogZipper.GetCodecName().c_str());
+			}
+
+			if(!rFirst.m_AlogZipper.HasCodec())
+			{
+				m_bCompressAlog = false;
+				MOOSTrace("warning:\n\talogs will not be compressed because no compression library was found at build time\n");
+			}
+		}
+
+		if(m_bCompressAlog)
+		{
+			//the xlog can use a different codec (it is usually small and rarely read)
+			sCodec = rFirst.m_AlogZipper.GetCodecName();
+			std::string sXlogCodec = sCodec;
+			if(m_MissionReader.GetConfigurationParam("XlogCodec",sXlogCodec))
+			{
+				CLogCodec * pCodec = CLogCodec::Create(sXlogCodec);
+				if(pCodec==NULL)
+				{
+					MOOSTrace("warning:\n\tXlogCodec \"%s\" is not available - using %s\n",
+						sXlogCodec.c_str(),
+						sCodec.c_str());
+					sXlogCodec = sCodec;
+				}
+				delete pCodec;
+			}
+
+			for(int i = 0;i<2;i++)
+			{
+				m_Segments[i].m_AlogZipper.SetCodec(sCodec);
+				m_Segments[i].m_XlogZipper.SetCodec(sXlogCodec);
+			}
+		}
+	}
+
+	//how much may queue up waiting to be compressed and what to do when it is full
+	int nQueueLimitMB = 0;
+	if(m_MissionReader.GetConfigurationParam("CompressQueueLimit",nQueueLimitMB) && nQueueLimitMB>0)
 	{
-#ifndef ZLIB_FOUND
-		m_bCompressAlog = false;
-		MOOSTrace("warning:\n\talogs will not be compressed because zlib was not found at build time");
-#endif
+		for(int i = 0;i<2;i++)
+		{
+			m_Segments[i].m_AlogZipper.SetQueueLimit((size_t)nQueueLimitMB*1024*1024);
+			m_Segments[i].m_XlogZipper.SetQueueLimit((size_t)nQueueLimitMB*1024*1024);
+		}
+	}
+
+	//more than one thread means compressing independent blocks in parallel
+	int nCompressThreads = 1;
+	if(m_MissionReader.GetConfigurationParam("CompressThreads",nCompressThreads) && nCompressThreads>1)
+	{
+		int nBlockKB = 0;
+		m_MissionReader.GetConfigurationParam("CompressBlockSize",nBlockKB);
+
+		for(int i = 0;i<2;i++)
+		{
+			m_Segments[i].m_AlogZipper.SetThreads(nCompressThreads);
+			m_Segments[i].m_XlogZipper.SetThreads(nCompressThreads);
+			if(nBlockKB>0)
+			{
+				m_Segments[i].m_AlogZipper.SetBlockSize((size_t)nBlockKB*1024);
+				m_Segments[i].m_XlogZipper.SetBlockSize((size_t)nBlockKB*1024);
+			}
+		}
+	}
+
+	//or write independent members (each with its own CRC) of so many MB with any number of
+	//threads, so a log cut short by a crash loses at most its last member - with a .zidx
+	//member index alongside
+	int nMemberMB = 0;
+	if(m_MissionReader.GetConfigurationParam("CompressMemberSize",nMemberMB) && nMemberMB>0)
+	{
+		for(int i = 0;i<2;i++)
+		{
+			m_Segments[i].m_AlogZipper.SetMemberSize((size_t)nMemberMB*1024*1024);
+			m_Segments[i].m_XlogZipper.SetMemberSize((size_t)nMemberMB*1024*1024);
+		}
+	}
+
+	std::string sOverflow;
+	if(m_MissionReader.GetConfigurationParam("CompressOverflowPolicy",sOverflow))
+	{
+		CZipper::OverflowPolicy ePolicy = CZipper::BLOCK;
+		if(MOOSStrCmp(sOverflow,"drop_oldest"))
+			ePolicy = CZipper::DROP_OLDEST;
+		else if(MOOSStrCmp(sOverflow,"spill"))
+			ePolicy = CZipper::SPILL;
+		else if(!MOOSStrCmp(sOverflow,"block"))
+			MOOSTrace("warning:\n\tCompressOverflowPolicy must be one of block, drop_oldest or spill - using block\n");
+
+		//indexes record alog offsets as batches are queued - a batch dropped or spilled later
+		//would leave every offset after it pointing at the wrong bytes
+		if(ePolicy!=CZipper::BLOCK && (m_bIndexAlog || !m_ShardNames.empty()))
+		{
+			MOOSTrace("warning:\n\tCompressOverflowPolicy %s would corrupt the alog and shard indexes (IndexAlogs, LogShard) - using block\n",sOverflow.c_str());
+			ePolicy = CZipper::BLOCK;
+		}
+
+		for(int i = 0;i<2;i++)
+		{
+			m_Segments[i].m_AlogZipper.SetOverflowPolicy(ePolicy);
+			m_Segments[i].m_XlogZipper.SetOverflowPolicy(ePolicy);
+		}
 	}
 	
 
@@ -403,6 +861,8 @@ bool CMOOSLogger::ConfigureLogging()
 		
 		//there was a request to allow multiple statements of the these patterns...hence the
 		//more  complicated parsing here
+		m_WildCardCriticalMatcher.Clear();
+		m_WildCardBulkMatcher.Clear();
 		STRING_LIST sList;
 		if(m_MissionReader.GetConfiguration(GetAppName(), sList))
 		{
@@ -428,9 +888,35 @@ bool CMOOSLogger::ConfigureLogging()
 						m_sWildCardOmitted.push_back(MOOSChomp(sVal));
 					}
 				}
+				else if(MOOSStrCmp("WildCardPriority",sTok))
+				{
+					//WildCardPriority = bulk : CAMERA_*,SONAR_RAW
+					std::string sPriority = MOOSChomp(sVal,":");
+					MOOSTrimWhiteSpace(sPriority);
+					MOOSRemoveChars(sVal," \t");
+
+					CWildcardMatcher * pMatcher = NULL;
+					if(MOOSStrCmp(sPriority,"CRITICAL"))
+						pMatcher = &m_WildCardCriticalMatcher;
+					else if(MOOSStrCmp(sPriority,"BULK"))
+						pMatcher = &m_WildCardBulkMatcher;
+					else if(!MOOSStrCmp(sPriority,"NORMAL"))
+						MOOSTrace("warning:\n\tWildCardPriority must be critical, normal or bulk - ignoring %s\n",q->c_str());
+
+					while(pMatcher!=NULL && !sVal.empty())
+						pMatcher->Add(MOOSChomp(sVal,","));
+				}
 			}
 		}
 		
+		//compile the patterns - any decisions already made may no longer hold
+		m_WildCardOmitMatcher.Clear();
+		m_WildCardAcceptMatcher.Clear();
+		for(size_t i = 0;i<m_sWildCardOmitted.size();i++)
+			m_WildCardOmitMatcher.Add(m_sWildCardOmitted[i]);
+		for(STRING_LIST::iterator p = m_sWildCardAccepted.begin();p!=m_sWildCardAccepted.end();p++)
+			m_WildCardAcceptMatcher.Add(*p);
+		m_nWildCardVersion++;
 	    
         m_bAsynchronousLog = true;
     }
@@ -439,8 +925,93 @@ bool CMOOSLogger::ConfigureLogging()
     if(!RegisterMOOSVariables())
         MOOSDebugWrite("Variable subscription is still pending - not terminal, but unusual");
 
+    if((m_bWildCardLogging || m_FlightRecorder.IsEnabled()) && m_Comms.IsConnected())
+        RegisterWildCards();
+
+    return true;
+
+}
+
+bool CMOOSLogger::ConfigureShards()
+{
+    std::string sShardBy;
+    if(m_MissionReader.GetConfigurationParam("ShardBy",sShardBy))
+    {
+        if(MOOSStrCmp(sShardBy,"SOURCE"))
+            m_bShardBySource = true;
+        else if(!MOOSStrCmp(sShardBy,"VARIABLE"))
+            MOOSTrace("warning:\n\tShardBy must be variable or source - sharding by variable\n");
+    }
+
+    //LogShard = nav : NAV_*,GPS_* (or LogShard = sensors : pSonar,pCamera when sharding by source)
+    //optionally on a disk of its own - LogShard = camera : CAMERA_* @ /disk2/logs
+    STRING_LIST sList;
+    if(m_MissionReader.GetConfiguration(GetAppName(), sList))
+    {
+        sList.reverse();
+        STRING_LIST::iterator q;
+        for(q = sList.begin();q!=sList.end();q++)
+        {
+            std::string sTok,sVal;
+            if(!CMOOSFileReader::GetTokenValPair(*q, sTok,sVal) || !MOOSStrCmp("LogShard",sTok))
+                continue;
+
+            std::string sName = MOOSChomp(sVal,":");
+            MOOSTrimWhiteSpace(sName);
+            std::string sPatterns = MOOSChomp(sVal,"@");
+            MOOSRemoveChars(sPatterns," \t");
+            std::string sDirectory = sVal;
+            MOOSTrimWhiteSpace(sDirectory);
+            if(sName.empty() || sPatterns.empty() || sName.find_first_of("/\\")!=std::string::npos)
+            {
+                MOOSTrace("warning:\n\tLogShard must be name : pattern[,pattern...] [@ directory] - ignoring %s\n",q->c_str());
+                continue;
+            }
+            if(std::find(m_ShardNames.begin(),m_ShardNames.end(),sName)!=m_ShardNames.end())
+                return MOOSFail("LogShard %s is named twice\n",sName.c_str());
+
+            if(!sDirectory.empty() && !CreateDirectory(sDirectory))
+                return MOOSFail("LogShard %s can't be written to %s\n",sName.c_str(),sDirectory.c_str());
+
+            CWildcardMatcher Matcher;
+            while(!sPatterns.empty())
+                Matcher.Add(MOOSChomp(sPatterns,","));
+
+            m_ShardNames.push_back(sName);
+            m_ShardDirectories.push_back(sDirectory);
+            m_ShardMatchers.push_back(Matcher);
+        }
+    }
+
+    if(m_ShardNames.empty())
+        return true;
+
+    if(!m_bTextAlog)
+    {
+        MOOSTrace("warning:\n\tLogShard splits the text alog which isn't being written - not sharding\n");
+        m_ShardNames.clear();
+        m_ShardDirectories.clear();
+        m_ShardMatchers.clear();
+        return true;
+    }
+
+    for(int i = 0;i<2;i++)
+        m_Segments[i].SetShards(m_ShardNames,m_ShardDirectories);
+    m_ShardEncoders.resize(m_ShardNames.size());
+
+    MOOSTrace("pLogger: alog split into %d shards by %s\n",(int)m_ShardNames.size()+1,m_bShardBySource ? "source" : "variable");
     return true;
+}
 
+unsigned int CMOOSLogger::DecideShard(const std::string & sName) const
+{
+    //the first shard whose patterns match
+    for(size_t i = 0;i<m_ShardMatchers.size();i++)
+    {
+        if(m_ShardMatchers[i].Matches(sName))
+            return (unsigned int)i+1;
+    }
+    return 0;
 }
 
 bool CMOOSLogger::HandleLogRequest(std::string sParam,std::string & sVar, bool bDynamic)
@@ -469,6 +1040,7 @@ bool CMOOSLogger::HandleLogRequest(std::string sParam,std::string & sVar, bool b
     }
 
 
+    string sOptions = sParam;
     string sFreq = MOOSChomp(sParam,",");
 
     double dfPeriod = MOOS_LOGGER_DEFAULT_PERIOD;
@@ -478,7 +1050,128 @@ bool CMOOSLogger::HandleLogRequest(std::string sParam,std::string & sVar, bool b
     }
 
     //OK lets make a (internal) MOOS variable to hold this data
-    AddMOOSVariable(sVar,sVar,"",dfPeriod);
+    AddLoggedVariable(sVar,dfPeriod);
+
+    //change based policies e.g LOG = DEPTH @ 0, DEADBAND=0.05, MAXGAP=10 or
+    //LOG = NAV_MODE @ 0, ONCHANGE (NOSYNC and MONITOR were dealt with above). MAXGAP
+    //alone means on change with a heartbeat
+    KeyRecord * pKey = m_Keys.Find(sVar);
+    bool bFirst = true;
+    while(pKey!=NULL && !sOptions.empty())
+    {
+        string sValue = MOOSChomp(sOptions,",");
+        string sOption = MOOSChomp(sValue,"=");
+        MOOSTrimWhiteSpace(sOption);
+        MOOSTrimWhiteSpace(sValue);
+
+        //the first is the period, already read
+        bool bPeriod = bFirst && MOOSIsNumeric(sOption);
+        bFirst = false;
+
+        if(sOption.empty() || bPeriod || MOOSStrCmp(sOption,"NOSYNC") || MOOSStrCmp(sOption,"MONITOR"))
+        {
+            continue;
+        }
+        else if(MOOSStrCmp(sOption,"ONCHANGE"))
+        {
+            pKey->bOnChange = true;
+        }
+        else if(MOOSStrCmp(sOption,"DEADBAND"))
+        {
+            if(!MOOSIsNumeric(sValue) || atof(sValue.c_str())<0)
+                MOOSTrace("Warning:\n\tignoring DEADBAND=%s for %s - it needs a value of 0 or more\n",sValue.c_str(),sVar.c_str());
+            else
+                pKey->dfDeadband = atof(sValue.c_str());
+        }
+        else if(MOOSStrCmp(sOption,"MAXGAP"))
+        {
+            if(!MOOSIsNumeric(sValue) || atof(sValue.c_str())<=0)
+                MOOSTrace("Warning:\n\tignoring MAXGAP=%s for %s - it needs a time in seconds\n",sValue.c_str(),sVar.c_str());
+            else
+                pKey->dfMaxGap = atof(sValue.c_str());
+        }
+        else if(MOOSStrCmp(sOption,"PRIORITY"))
+        {
+            //what goes first when the disk can't keep up
+            if(MOOSStrCmp(sValue,"CRITICAL"))
+                pKey->ePriority = CRITICAL;
+            else if(MOOSStrCmp(sValue,"BULK"))
+                pKey->ePriority = BULK;
+            else if(MOOSStrCmp(sValue,"NORMAL"))
+                pKey->ePriority = NORMAL;
+            else
+                MOOSTrace("Warning:\n\tignoring PRIORITY=%s for %s - it must be critical, normal or bulk\n",sValue.c_str(),sVar.c_str());
+        }
+        else
+        {
+            MOOSTrace("Warning:\n\tignoring unknown option %s for %s\n",sOption.c_str(),sVar.c_str());
+        }
+    }
+
+    if(pKey!=NULL)
+    {
+        if(pKey->dfMaxGap>0)
+            pKey->bOnChange = true;
+        pKey->bPolicy = pKey->bOnChange || pKey->dfDeadband>=0;
+        if(pKey->bPolicy)
+        {
+            MOOSTrace("  %s is logged on change%s%s\n",sVar.c_str(),
+                pKey->dfDeadband>0 ? MOOSFormat(" of more than %g",pKey->dfDeadband).c_str() : "",
+                pKey->dfMaxGap>0 ? MOOSFormat(" and at least every %gs",pKey->dfMaxGap).c_str() : "");
+        }
+    }
+
+    return true;
+}
+
+bool CMOOSLogger::IsLogDue(KeyRecord & rKey, const CMOOSMsg & rMsg)
+{
+    double dfTime = rMsg.GetTime();
+
+    //every file starts with a value, and a change of type is always a change
+    bool bDue = rKey.nPolicyEpoch!=m_nPolicyEpoch || rKey.cLastType!=rMsg.m_cDataType;
+
+    //the heartbeat - still logging an unchanging value once in a while
+    if(!bDue && rKey.dfMaxGap>0)
+        bDue = dfTime-rKey.dfLastLogged>=rKey.dfMaxGap;
+
+    if(!bDue)
+    {
+        //a deadband is measured from the value last logged so slow drift is still seen
+        if(rMsg.IsDouble())
+            bDue = rKey.dfDeadband>0 ? fabs(rMsg.m_dfVal-rKey.dfLastValue)>rKey.dfDeadband : rMsg.m_dfVal!=rKey.dfLastValue;
+        else
+            bDue = rMsg.m_sVal!=rKey.sLastValue;
+    }
+
+    if(!bDue)
+        return false;
+
+    rKey.nPolicyEpoch = m_nPolicyEpoch;
+    rKey.cLastType = rMsg.m_cDataType;
+    rKey.dfLastLogged = dfTime;
+    if(rMsg.IsDouble())
+        rKey.dfLastValue = rMsg.m_dfVal;
+    else
+        rKey.sLastValue = rMsg.m_sVal;
+
+    return true;
+}
+
+bool CMOOSLogger::AddLoggedVariable(const std::string & sVar, double dfPeriod)
+{
+    if(!AddMOOSVariable(sVar,sVar,"",dfPeriod))
+        return false;
+
+    //and remember everything about it we need for each message
+    KeyRecord Record;
+    Record.eLog = ALOG;
+    Record.pVar = GetMOOSVar(sVar);
+    Record.bWildCard = false;
+    Record.nWildCardVersion = 0;
+    Record.dfPeriod = dfPeriod;
+    Record.nShard = m_bShardBySource ? 0 : DecideShard(sVar);
+    m_Keys.Insert(sVar,Record);
 
     return true;
 }
@@ -536,129 +1229,533 @@ bool CMOOSLogger::Iterate()
         m_Comms.Notify("LOGGER_DIRECTORY",m_sLogDirectoryName.c_str());
     }
 
-    //are we requested to do wild card logging?
-    if(m_bWildCardLogging)
-        HandleWildCardLogging();
+    //timed rotation mustn't wait for mail to arrive
+    if(m_bAsynchronousLog)
+        CheckRotation();
+
+
+    //finally commit the slog and ylog as the durability policy says - this thread writes
+    //them so it commits them (the segment's writer threads look after their own files)
+    if(m_Durability.GetMode()!=CLogDurability::NONE)
+    {
+        double dfCommitPeriod = m_Durability.GetPeriod();
+        if(dfCommitPeriod<=0 && m_Durability.GetBytes()>0)
+            dfCommitPeriod = SYNC_COMMIT_PERIOD;
+
+        if(dfTimeNow-m_dfLastSyncCommitTime>=dfCommitPeriod)
+            CommitSyncFiles(dfTimeNow);
+    }
+
+    //is the disk keeping up?
+    if(m_bAsynchronousLog)
+        CheckStaging();
+
+    //a snapshot waiting for what follows the request?
+    if(m_dfSnapshotDue>0 && dfTimeNow>=m_dfSnapshotDue)
+        TakeSnapshot();
 
+    //how are we doing?
+    if(m_dfStatsPeriod>0 && dfTimeNow-m_dfLastStatsTime>=m_dfStatsPeriod)
+        UpdateStats(dfTimeNow);
 
-    //finally flush all files to be safe
-    m_SyncLogFile.flush();
-    m_AsyncLogFile.flush();
-    m_SystemLogFile.flush();
+    //and tell the world how much a power cut would cost
+    if(dfTimeNow-m_dfLastDurablePublishTime>=DURABLE_TIME_PUBLISH_PERIOD)
+    {
+        m_dfLastDurablePublishTime = dfTimeNow;
+        double dfDurable = GetDurableTime();
+        if(dfDurable>=0)
+            m_Comms.Notify("LOGGER_DURABLE_TIME",dfDurable);
+    }
 
 
 
     return true;
 }
 
-bool CMOOSLogger::HandleWildCardLogging()
+bool CMOOSLogger::CheckStaging()
 {
-    static double  dfLastWildCardTime = -1.0;
+    double dfFill = m_pSegment->GetStagingFill();
 
-    if(MOOSTime()-dfLastWildCardTime>DEFAULT_WILDCARD_TIME)
+    //raised at the high water mark and only cleared well below it so it doesn't chatter
+    if(!m_bStagingAlarm && dfFill>=m_dfStagingHighWater)
     {
-        MOOSMSG_LIST InMail;
-        if(m_Comms.ServerRequest("VAR_SUMMARY", InMail, 2.0, false))
-        {
-            MOOSAssert(InMail.size()==1);
-            std::string ss(InMail.begin()->GetString());
-            bool bHit = false;
-            while(!ss.empty())
-            {
-                std::string sVar = MOOSChomp(ss);
-                if(GetMOOSVar(sVar)==NULL)
-                {
-					bool bWouldNormallyReject = IsWildCardRejected(sVar);
-					bool bWouldNormallyAccept = IsWildCardAccepted(sVar);
-					bool bWanted = false;
-					
-					if(m_bUseExcludedLog)
-					{
-						bWanted = true;
-						if( bWouldNormallyAccept && !bWouldNormallyReject)
-						{
-							MOOSTrace("  Added wildcard logging of %-20s\n",sVar.c_str());
-							m_LogDestinations[sVar] = ALOG;
-						}
-						else 
-						{
-							MOOSTrace("  Added wildcard logging of %-20s  (xlog) \n",sVar.c_str());
-							m_LogDestinations[sVar] = XLOG;
-							
-						}
-					}
-				
-					else
-					{
-						if( bWouldNormallyAccept &&	!bWouldNormallyReject )
-						{
-							MOOSTrace("  Added wildcard logging of %-20s\n",sVar.c_str());
-							m_LogDestinations[sVar] = ALOG;
-							bWanted = true;
-						}
-						else if(bWouldNormallyAccept && bWouldNormallyReject)
-						{
-							//MOOSTrace("  denied added wildcard logging of %-20s   (fits Omit pattern as well as Accept pattern)\n",sVar.c_str());	
-							bWanted = false;
-						}
-					}
-					
-					if(bWanted)
-					{
-						//yep we want to know....
-						if(AddMOOSVariable(sVar,sVar,"",0.0))
-						{
-							bHit = true;
-						}		
-					}
-						
-                }
-            }
+        m_bStagingAlarm = true;
+        MOOSDebugWrite(MOOSFormat("log staging is %.0f%% full - the disk is not keeping up\n",dfFill*100.0));
+        m_Comms.Notify("LOGGER_STAGING_ALARM","true");
+    }
+    else if(m_bStagingAlarm && dfFill<m_dfStagingHighWater/2)
+    {
+        m_bStagingAlarm = false;
+        MOOSDebugWrite(MOOSFormat("log staging is down to %.0f%% full\n",dfFill*100.0));
+        m_Comms.Notify("LOGGER_STAGING_ALARM","false");
+    }
 
-            if(bHit)
-                RegisterMOOSVariables();
-        }
+    return m_bStagingAlarm;
+}
+
+void CMOOSLogger::UpdateShedding(double dfTimeNow)
+{
+    double dfFill = m_pSegment->GetStagingFill();
+
+    //which way is the fill pushing the level?
+    int nDirection = 0;
+    if(dfFill>=m_dfShedHighWater && m_nShedLevel<MAX_SHED_LEVEL)
+        nDirection = 1;
+    else if(dfFill<m_dfShedHighWater/2 && m_nShedLevel>0)
+        nDirection = -1;
+
+    //it has to push the same way for m_dfShedAfter seconds - a burst is what staging is for
+    bool bChanged = false;
+    if(nDirection!=m_nShedDirection)
+    {
+        m_nShedDirection = nDirection;
+        m_dfShedSince = dfTimeNow;
+    }
+    else if(nDirection!=0 && dfTimeNow-m_dfShedSince>=m_dfShedAfter)
+    {
+        m_nShedLevel+=nDirection;
+        m_dfShedSince = dfTimeNow;
+        bChanged = true;
+
+        MOOSDebugWrite(MOOSFormat("log staging is %.0f%% full - shedding level %d\n",dfFill*100.0,m_nShedLevel));
+        m_Comms.Notify("LOGGER_SHED_LEVEL",(double)m_nShedLevel);
+    }
+
+    //each change of level and what has been shed since the last report go in the ylog
+    if(bChanged || (m_nShedMsgs>m_nShedReported && dfTimeNow-m_dfLastShedReport>=SHED_REPORT_PERIOD))
+    {
+        LogSystemEvent("LOGGER_SHED",MOOSFormat("Level=%d,StagingFill=%.0f,Shed=%llu,TotalShed=%llu",
+            m_nShedLevel,dfFill*100.0,m_nShedMsgs-m_nShedReported,m_nShedMsgs));
+        m_nShedReported = m_nShedMsgs;
+        m_dfLastShedReport = dfTimeNow;
+    }
+}
+
+bool CMOOSLogger::IsShed(KeyRecord & rKey)
+{
+    bool bDecimate = false;
+    switch(rKey.ePriority)
+    {
+        case CRITICAL:
+            return false;
+        case BULK:
+            if(m_nShedLevel>=2)
+                return true;
+            bDecimate = m_nShedLevel>=1;
+            break;
+        case NORMAL:
+            bDecimate = m_nShedLevel>=3;
+            break;
+    }
+
+    //keep the first of every m_nShedDecimation
+    return bDecimate && (rKey.nShedCount++%m_nShedDecimation)!=0;
+}
+
+void CMOOSLogger::LogSystemEvent(const std::string & sKey, const std::string & sValue)
+{
+    if(!m_SystemLogFile.is_open())
+        return;
+
+    //laid out as the system messages are (see LogSystemMessages)
+    std::streampos Start = m_SystemLogFile.tellp();
+    m_SystemLogFile.setf(ios::left);
+    m_SystemLogFile<<setw(10)<<setprecision(7)<<MOOSTime()-GetAppStartTime()<<' ';
+    m_SystemLogFile<<setw(20)<<sKey.c_str()<<' ';
+    m_SystemLogFile<<setw(20)<<GetAppName().c_str()<<' ';
+    m_SystemLogFile<<setw(20)<<sValue.c_str()<<' ';
+    m_SystemLogFile<<'\n';
+
+    m_Stats.Count(CLoggerStats::YLOG,1,(unsigned long long)(m_SystemLogFile.tellp()-Start));
+}
+
+bool CMOOSLogger::RequestSnapshot(const std::string & sReason)
+{
+    if(!m_FlightRecorder.IsEnabled())
+        return MOOSFail("snapshot requested (%s) but there is no FlightRecorder\n",sReason.c_str());
+
+    //requests made while one is waiting are covered by it
+    if(m_dfSnapshotDue>0)
+        return true;
+
+    m_sSnapshotReason = sReason;
+    m_dfSnapshotDue = MOOSTime()+m_dfSnapshotAfter;
+
+    return m_dfSnapshotAfter>0 ? true : TakeSnapshot();
+}
 
-        dfLastWildCardTime = MOOSTime();
+bool CMOOSLogger::TakeSnapshot()
+{
+    //still writing the last one? - try again shortly
+    if(m_FlightRecorder.IsDumping())
+    {
+        m_dfSnapshotDue = MOOSTime()+SNAPSHOT_RETRY_PERIOD;
+        return false;
     }
 
+    m_dfSnapshotDue = -1;
+
+    std::string sStem = m_sLogDirectoryName+"/"+m_sLogRootName+MOOSFormat("_snapshot_%03d",++m_nSnapshots);
+    std::string sFileName = sStem+".alog";
+
+    std::stringstream ss;
+    DoLogBanner(ss,sFileName);
+
+    if(!m_FlightRecorder.Snapshot(sStem,ss.str(),GetAppStartTime()))
+        return MOOSFail("failed to start writing snapshot %s\n",sFileName.c_str());
+
+    MOOSTrace("writing %.1fs of traffic (%s) to %s\n",m_FlightRecorder.GetSpan(),m_sSnapshotReason.c_str(),sFileName.c_str());
+    m_Comms.Notify("LOGGER_SNAPSHOT_FILE",sFileName);
+
     return true;
 }
 
+bool CMOOSLogger::CommitSyncFiles(double dfTimeNow)
+{
+    m_dfLastSyncCommitTime = dfTimeNow;
+
+    bool bSync = m_Durability.GetMode()==CLogDurability::SYNC;
+    bool bOK = true;
+
+    if(m_SyncLogFile.is_open())
+    {
+        m_SyncLogFile.flush();
+        if(bSync)
+            bOK = CLogDurability::SyncFile(m_sSyncFileName) && bOK;
+    }
+
+    if(m_BinarySyncLogFile.is_open())
+    {
+        m_BinarySyncLogFile.flush();
+        if(bSync)
+            bOK = CLogDurability::SyncFile(m_sBinarySyncFileName) && bOK;
+    }
+
+    if(m_SystemLogFile.is_open())
+    {
+        m_SystemLogFile.flush();
+        if(bSync)
+            bOK = CLogDurability::SyncFile(m_sSystemFileName) && bOK;
+    }
 
-struct StringMatcher
+    //everything this thread wrote before now has been committed
+    if(bOK)
+        m_dfSyncDurableTime = dfTimeNow;
+    else
+        MOOSTrace("failed committing the slog or ylog\n");
+
+    return bOK;
+}
+
+double CMOOSLogger::GetDurableTime()
 {
-    std::string m_sString;
-    StringMatcher(const std::string & sStr)
+    //the earliest of all the files being written - a retiring segment counts until it is closed
+    double Times[3];
+    Times[0] = m_Segments[0].GetDurableTime();
+    Times[1] = m_Segments[1].GetDurableTime();
+    Times[2] = m_Durability.GetMode()==CLogDurability::NONE ? -1 : m_dfSyncDurableTime;
+
+    double dfDurable = -1;
+    for(int i = 0;i<3;i++)
     {
-        m_sString = sStr;
+        if(Times[i]>=0 && (dfDurable<0 || Times[i]<dfDurable))
+            dfDurable = Times[i];
     }
-    bool operator () (const std::string & sPattern) const
+    return dfDurable;
+}
+
+bool CMOOSLogger::UpdateStats(double dfTimeNow)
+{
+    m_dfLastStatsTime = dfTimeNow;
+
+    m_Stats.Update(dfTimeNow);
+
+    //latencies are reported for this interval alone
+    m_WriteLatency.Clear();
+    m_Segments[0].MoveWriteLatency(m_WriteLatency);
+    m_Segments[1].MoveWriteLatency(m_WriteLatency);
+
+    //so are the times mail takes to reach us
+    if(m_bLatencyStats)
+        m_Comms.Notify("PLOGGER_LATENCY",MakeLatencyString());
+
+    m_sStats = MakeStatsString();
+    m_Comms.Notify("PLOGGER_STATS",m_sStats);
+
+    if(m_bStatsConsole)
+        PrintStats();
+
+    return true;
+}
+
+std::string CMOOSLogger::MakeLatencyString()
+{
+    //gather this period's samples of each variable, noting the slowest
+    std::vector< std::pair<double, std::string> > Slowest;
+    m_ReceiveLatency.Clear();
+
+    std::map<std::string, CLatencyHistogram*>::iterator q;
+    for(q = m_Latencies.begin();q!=m_Latencies.end();q++)
     {
-        return MOOSWildCmp(sPattern,m_sString);
+        CLatencyHistogram & rLatency = *q->second;
+        unsigned long long nCount = rLatency.GetCount();
+        if(nCount==0)
+            continue;
+
+        std::string sEntry = MOOSFormat("%s=%llu/%.3f/%.3f/%.3f",q->first.c_str(),nCount,
+            rLatency.GetPercentile(0.5)*1000.0,rLatency.GetPercentile(0.99)*1000.0,rLatency.GetMax()*1000.0);
+        Slowest.push_back(std::make_pair(rLatency.GetPercentile(0.99),sEntry));
+
+        rLatency.MoveTo(m_ReceiveLatency);
     }
-};
 
-bool CMOOSLogger::IsWildCardRejected(const std::string & sVariableName) const
+    //worst first
+    std::sort(Slowest.begin(),Slowest.end());
+    std::reverse(Slowest.begin(),Slowest.end());
+
+    std::string sLatency;
+    for(size_t i = 0;i<Slowest.size() && i<LATENCY_REPORT_VARIABLES;i++)
+    {
+        if(i>0)
+            sLatency+=',';
+        sLatency+=Slowest[i].second;
+    }
+
+    m_sWorstLatency = Slowest.empty() ? std::string() : Slowest[0].second;
+    return sLatency;
+}
+
+std::string CMOOSLogger::MakeStatsString()
 {
-    return std::find_if(m_sWildCardOmitted.begin(),
-                        m_sWildCardOmitted.end(), 
-                        StringMatcher(sVariableName)) !=m_sWildCardOmitted.end();
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(1);
 
+    //rates of the files which have had anything written to them
+    const char * sSeparator = "";
+    for(int i = 0;i<CLoggerStats::NUM_FILES;i++)
+    {
+        CLoggerStats::File eFile = (CLoggerStats::File)i;
+        if(m_Stats.GetMessages(eFile)==0)
+            continue;
+
+        std::string sFile = CLoggerStats::GetFileName(eFile);
+        sFile[0] = toupper(sFile[0]);
+        ss<<sSeparator<<sFile<<"MsgRate="<<m_Stats.GetMessageRate(eFile);
+        ss<<","<<sFile<<"ByteRate="<<m_Stats.GetByteRate(eFile);
+        sSeparator = ",";
+    }
+
+    CLogSegment & rSegment = *m_pSegment;
+    unsigned long long nDropped = 0;
+    for(int i = 0;i<2;i++)
+    {
+        nDropped+=m_Segments[i].m_AlogZipper.GetDroppedMessages();
+        nDropped+=m_Segments[i].m_XlogZipper.GetDroppedMessages();
+    }
+
+    if(m_bCompressAlog)
+    {
+        ss<<sSeparator<<"AlogZipQueue="<<rSegment.m_AlogZipper.GetQueueDepth();
+        ss<<",AlogZipRatio="<<rSegment.m_AlogZipper.GetCompressionRatio();
+        if(m_bUseExcludedLog)
+        {
+            ss<<",XlogZipQueue="<<rSegment.m_XlogZipper.GetQueueDepth();
+            ss<<",XlogZipRatio="<<rSegment.m_XlogZipper.GetCompressionRatio();
+        }
+        sSeparator = ",";
+    }
+
+    //in milliseconds
+    ss<<std::setprecision(3);
+    ss<<sSeparator<<"Writes="<<m_WriteLatency.GetCount();
+    ss<<",WriteP50="<<m_WriteLatency.GetPercentile(0.5)*1000.0;
+    ss<<",WriteP99="<<m_WriteLatency.GetPercentile(0.99)*1000.0;
+    ss<<",WriteMax="<<m_WriteLatency.GetMax()*1000.0;
+
+    ss<<",StagingFill="<<rSegment.GetStagingFill()*100.0;
+
+    if(m_bLatencyStats)
+    {
+        ss<<",RecvP50="<<m_ReceiveLatency.GetPercentile(0.5)*1000.0;
+        ss<<",RecvP99="<<m_ReceiveLatency.GetPercentile(0.99)*1000.0;
+        ss<<",RecvMax="<<m_ReceiveLatency.GetMax()*1000.0;
+    }
+
+    if(m_FlightRecorder.IsEnabled())
+    {
+        ss<<",RecorderSpan="<<m_FlightRecorder.GetSpan();
+        ss<<",RecorderFill="<<m_FlightRecorder.GetFill()*100.0;
+        ss<<",Snapshots="<<m_nSnapshots;
+    }
+
+    ss<<",WildCardVars="<<m_nWildCardVars;
+    ss<<",DroppedMsgs="<<nDropped+m_nStagingDroppedMsgs;
+    ss<<",SuppressedMsgs="<<m_nSuppressedMsgs;
+    if(m_bOverloadShedding)
+        ss<<",ShedLevel="<<m_nShedLevel<<",ShedMsgs="<<m_nShedMsgs;
+
+    double dfFree = CLoggerStats::GetFreeDiskSpace(m_sLogDirectoryName);
+    if(dfFree>=0)
+        ss<<std::setprecision(0)<<",FreeDiskMB="<<dfFree/(1024.0*1024.0);
+
+    return ss.str();
+}
+
+void CMOOSLogger::PrintStats()
+{
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(1);
+
+    ss<<"\npLogger stats (last "<<m_dfStatsPeriod<<"s)\n";
+    ss<<"  "<<std::left<<std::setw(8)<<"file"<<std::right<<std::setw(12)<<"msgs/s"<<std::setw(12)<<"KB/s"<<"\n";
+    for(int i = 0;i<CLoggerStats::NUM_FILES;i++)
+    {
+        CLoggerStats::File eFile = (CLoggerStats::File)i;
+        if(m_Stats.GetMessages(eFile)==0)
+            continue;
+
+        ss<<"  "<<std::left<<std::setw(8)<<CLoggerStats::GetFileName(eFile)<<std::right;
+        ss<<std::setw(12)<<m_Stats.GetMessageRate(eFile);
+        ss<<std::setw(12)<<m_Stats.GetByteRate(eFile)/1024.0<<"\n";
+    }
+
+    if(m_bCompressAlog)
+    {
+        CLogSegment & rSegment = *m_pSegment;
+        ss<<"  alog zip queue "<<rSegment.m_AlogZipper.GetQueueDepth()/1024.0<<" KB, ratio "<<rSegment.m_AlogZipper.GetCompressionRatio()<<"\n";
+        if(m_bUseExcludedLog)
+            ss<<"  xlog zip queue "<<rSegment.m_XlogZipper.GetQueueDepth()/1024.0<<" KB, ratio "<<rSegment.m_XlogZipper.GetCompressionRatio()<<"\n";
+    }
+
+    ss<<std::setprecision(3);
+    ss<<"  write latency p50 "<<m_WriteLatency.GetPercentile(0.5)*1000.0<<" ms, p99 "<<m_WriteLatency.GetPercentile(0.99)*1000.0;
+    ss<<" ms, max "<<m_WriteLatency.GetMax()*1000.0<<" ms ("<<m_WriteLatency.GetCount()<<" writes)\n";
+    if(m_bLatencyStats)
+    {
+        ss<<"  receive latency p50 "<<m_ReceiveLatency.GetPercentile(0.5)*1000.0<<" ms, p99 "<<m_ReceiveLatency.GetPercentile(0.99)*1000.0;
+        ss<<" ms, max "<<m_ReceiveLatency.GetMax()*1000.0<<" ms";
+        if(!m_sWorstLatency.empty())
+            ss<<" - slowest "<<m_sWorstLatency;
+        ss<<"\n";
+    }
+
+    unsigned long long nDropped = 0;
+    for(int i = 0;i<2;i++)
+    {
+        nDropped+=m_Segments[i].m_AlogZipper.GetDroppedMessages();
+        nDropped+=m_Segments[i].m_XlogZipper.GetDroppedMessages();
+    }
+    if(m_FlightRecorder.IsEnabled())
+        ss<<"  flight recorder holds "<<std::setprecision(1)<<m_FlightRecorder.GetSpan()<<" s ("<<m_FlightRecorder.GetSize()/(1024.0*1024.0)<<" MB), "<<m_nSnapshots<<" snapshots\n";
+    ss<<"  staging "<<std::setprecision(0)<<m_pSegment->GetStagingFill()*100.0<<"% full"<<(m_bStagingAlarm ? " (alarm)" : "")<<"\n";
+    if(m_bOverloadShedding)
+        ss<<"  shedding level "<<m_nShedLevel<<", shed messages "<<m_nShedMsgs<<"\n";
+    ss<<"  wildcard variables "<<m_nWildCardVars<<", dropped messages "<<nDropped+m_nStagingDroppedMsgs<<", suppressed (unchanged) "<<m_nSuppressedMsgs;
+
+    double dfFree = CLoggerStats::GetFreeDiskSpace(m_sLogDirectoryName);
+    if(dfFree>=0)
+        ss<<std::setprecision(0)<<", free disk "<<dfFree/(1024.0*1024.0)<<" MB";
+    ss<<"\n";
+
+    MOOSTrace("%s",ss.str().c_str());
+}
+
+bool CMOOSLogger::RegisterWildCards()
+{
+    //the DB tells us about every variable matching a pattern, including ones which
+    //don't exist yet, so there is no need to keep asking it what variables there are.
+    //If there is an xlog we need everything - rejects go there - and the
+    //flight recorder keeps everything
+    m_bWildCardSubscribed = true;
+    if(m_bUseExcludedLog || m_sWildCardAccepted.empty() || m_FlightRecorder.IsEnabled())
+        return m_Comms.Register("*","*",0.0);
+
+    bool bOK = true;
+    std::list<std::string>::iterator q;
+    for(q = m_sWildCardAccepted.begin();q!=m_sWildCardAccepted.end();q++)
+    {
+        bOK = m_Comms.Register(*q,"*",0.0) && bOK;
+    }
+
+    return bOK;
+}
+
+CMOOSLogger::KeyRecord * CMOOSLogger::FindKey(const std::string & sKey)
+{
+    KeyRecord * pKey = m_Keys.Find(sKey);
+
+    //asked for by name, or decided by the current patterns?
+    if(pKey!=NULL && (!pKey->bWildCard || pKey->nWildCardVersion==m_nWildCardVersion))
+        return pKey;
+
+    //variables we have never seen before arrive through wildcard
+    //subscriptions - decide about them before they are logged
+    if(!m_bWildCardLogging)
+        return pKey;
+
+    return HandleWildCardLogging(sKey);
+}
+
+CMOOSLogger::KeyRecord * CMOOSLogger::HandleWildCardLogging(const std::string & sVar)
+{
+    KeyRecord Record;
+    Record.eLog = DecideWildCard(sVar);
+    Record.pVar = GetMOOSVar(sVar);
+    Record.bWildCard = true;
+    Record.nWildCardVersion = m_nWildCardVersion;
+    Record.nShard = m_bShardBySource ? 0 : DecideShard(sVar);
+    Record.ePriority = DecideWildCardPriority(sVar);
+
+    if(Record.eLog!=NOLOG && Record.pVar==NULL)
+    {
+        MOOSTrace("  Added wildcard logging of %-20s%s\n",sVar.c_str(),Record.eLog==XLOG ? "  (xlog) " : "");
+
+        //yep we want to know.... the subscription is already in place
+        //so this message and all that follow are logged
+        if(AddMOOSVariable(sVar,sVar,"",0.0))
+        {
+            Record.pVar = GetMOOSVar(sVar);
+            m_nWildCardVars++;
+        }
+        else
+            Record.eLog = NOLOG;
+    }
+
+    //remembered either way so each name is only judged once
+    return &m_Keys.Insert(sVar,Record);
+}
+
+bool CMOOSLogger::IsWildCardRejected(const std::string & sVariableName) const
+{
+    return m_WildCardOmitMatcher.Matches(sVariableName);
 }
 
 bool CMOOSLogger::IsWildCardAccepted(const std::string & sVariableName) const
 {
-    
     //we assume by default we want everything
-    if(m_sWildCardAccepted.empty())
+    if(m_WildCardAcceptMatcher.IsEmpty())
         return true;
-    
+
     //looks like some masks have been set
-    return std::find_if(m_sWildCardAccepted.begin(),
-                        m_sWildCardAccepted.end(), 
-                        StringMatcher(sVariableName)) !=m_sWildCardAccepted.end();
-    
+    return m_WildCardAcceptMatcher.Matches(sVariableName);
+}
+
+CMOOSLogger::LogType CMOOSLogger::DecideWildCard(const std::string & sVariableName) const
+{
+    if(IsWildCardAccepted(sVariableName) && !IsWildCardRejected(sVariableName))
+        return ALOG;
+
+    //rejects go to the xlog if there is one
+    return m_bUseExcludedLog ? XLOG : NOLOG;
+}
+
+CMOOSLogger::Priority CMOOSLogger::DecideWildCardPriority(const std::string & sVariableName) const
+{
+    //critical wins if a name matches both
+    if(m_WildCardCriticalMatcher.Matches(sVariableName))
+        return CRITICAL;
+
+    return m_WildCardBulkMatcher.Matches(sVariableName) ? BULK : NORMAL;
 }
 
 
@@ -702,78 +1799,78 @@ std::string CMOOSLogger::MakeLogName(string sStem)
 }
 
 
-bool CMOOSLogger::DoSyncLog(double dfTimeNow)
+bool CMOOSLogger::ResolveSyncColumns()
 {
-
-    //begin with time...
-    m_SyncLogFile<<setw(COLUMN_WIDTH)<<setprecision(7)<<dfTimeNow-GetAppStartTime()<<' ';
-
-    //now for all our variables...
-    int nLogVarsSize = m_SynchronousLogVars.size();
-    for(int nVar = 0; nVar<nLogVarsSize;nVar++)
+    //columns are only ever added (dynamic ones take the place of
+    //reserved ones) so only look up the names we haven't seen yet
+    for(;m_nResolvedSyncVars<m_SynchronousLogVars.size();m_nResolvedSyncVars++)
     {
-        string sVar = m_SynchronousLogVars[nVar];
+        const std::string & sVar = m_SynchronousLogVars[m_nResolvedSyncVars];
 
         //oops empty string!
         if(sVar.empty())
             continue;
 
-        //we want left justification
-        m_SyncLogFile.setf(ios::left);
-
-        //ok we have a name at column nVar...(numerical order retained in vector)
+        //variables in the map never move so the pointer stays good
         MOOSVARMAP::iterator q = m_MOOSVars.find(sVar);
+        m_SyncColumns.push_back(q==m_MOOSVars.end() ? NULL : &q->second);
+    }
 
-        if(q!=m_MOOSVars.end())
-        {
-            //OK so now we have the variable ..log it simply
-            CMOOSVariable & rVar = q->second;
+    return true;
+}
 
-            m_SyncLogFile<<setw(COLUMN_WIDTH);
+bool CMOOSLogger::DoSyncLog(double dfTimeNow)
+{
+    ResolveSyncColumns();
 
-            //has this variable changed since last time?
-            if(rVar.IsFresh())
-            {
-                //we can only write doubles
-                if(rVar.IsDouble())
-                {
-                    m_SyncLogFile<<rVar.GetAsString(COLUMN_WIDTH).c_str()<<' ';
-                }
-                else
-                {
-                    //signify string variables or other types by NaN
-                    //sync log is only for numbers
-                    m_SyncLogFile<<"NaN"<<' ';
-                }
+    //one row - time then every column, NaN for anything which isn't a fresh number
+    //here we also add columns for unclaimed dynamic variables
+    m_SyncRow.assign(1+m_SyncColumns.size()+m_UnusedDynamicVariables.size(),std::numeric_limits<double>::quiet_NaN());
+    m_SyncRow[0] = dfTimeNow-GetAppStartTime();
 
-                //we have used this variable so it is no longer fresh
-                rVar.SetFresh(false);
-            }
-            else
-            {
-                //NO!
-                m_SyncLogFile<<"NaN"<<' ';
-            }
+    for(size_t nCol = 0;nCol<m_SyncColumns.size();nCol++)
+    {
+        CMOOSVariable * pVar = m_SyncColumns[nCol];
 
+        //has this variable changed since last time?
+        if(pVar==NULL || !pVar->IsFresh())
+            continue;
 
-        }
+        //sync log is only for numbers - strings or other types are NaN
+        if(pVar->IsDouble())
+            m_SyncRow[nCol+1] = pVar->GetDoubleVal();
 
+        //we have used this variable so it is no longer fresh
+        pVar->SetFresh(false);
     }
 
-
-    //here we want to add columns for unclaimed dynamic variables;
-    for(unsigned int i = 0; i<m_UnusedDynamicVariables.size();i++)
+    if(m_bTextSyncLog)
     {
-            m_SyncLogFile<<setw(COLUMN_WIDTH);
-            m_SyncLogFile<<"NaN"<<' ';
-    }
+        //format into a reusable buffer - no stream manipulators and no flush per row
+        m_SyncEncoder.Clear();
+        for(size_t i = 0;i<m_SyncRow.size();i++)
+        {
+            if(m_SyncRow[i]!=m_SyncRow[i])
+                m_SyncEncoder.AppendPadded("NaN",COLUMN_WIDTH);
+            else
+                m_SyncEncoder.AppendGeneral(m_SyncRow[i],COLUMN_WIDTH,i==0 ? 7 : 6);
+            m_SyncEncoder.Append(' ');
+        }
+        m_SyncEncoder.Append('\n');
 
-    //put a new line in...
-    m_SyncLogFile<<endl;
+        m_SyncLogFile.write(m_SyncEncoder.GetBuffer().data(),m_SyncEncoder.Size());
+        m_Stats.Count(CLoggerStats::SLOG,1,m_SyncEncoder.Size());
 
-    //every few lines put a comment in
-    if((m_nSyncLines++)%30==0)
-        LabelSyncColumns();
+        //every few lines put a comment in
+        if((m_nSyncLines++)%30==0)
+            LabelSyncColumns();
+    }
+
+    if(m_bBinarySyncLog)
+    {
+        m_BinarySyncLogFile.write((const char*)&m_SyncRow[0],m_SyncRow.size()*sizeof(double));
+        m_Stats.Count(CLoggerStats::BSLOG,1,m_SyncRow.size()*sizeof(double));
+    }
 
     return true;
 }
@@ -801,6 +1898,16 @@ bool CMOOSLogger::OpenFile(std::ofstream & of,const std::string & sName,bool bBi
 
 bool CMOOSLogger::OpenSyncFile()
 {
+    //columns are resolved afresh for each file
+    m_SyncColumns.clear();
+    m_nResolvedSyncVars = 0;
+
+    if(m_bBinarySyncLog && !OpenBinarySyncFile())
+        return MOOSFail("Failed to Open bslog file");
+
+    if(!m_bTextSyncLog)
+        return true;
+
     if(!OpenFile(m_SyncLogFile,m_sSyncFileName))
         return MOOSFail("Failed to Open slog file");
 
@@ -851,6 +1958,91 @@ bool CMOOSLogger::OpenSyncFile()
 }
 
 
+bool CMOOSLogger::OpenBinarySyncFile()
+{
+    if(!OpenFile(m_BinarySyncLogFile,m_sBinarySyncFileName,true))
+        return false;
+
+    //a text header (padded to a whole number of pages) says what the columns are,
+    //then every row is the same number of doubles - NaN where the text slog says NaN.
+    //So in numpy: np.memmap(name,dtype='<f8',offset=HeaderBytes).reshape(-1,Columns)
+    unsigned short nOne = 1;
+    bool bLittleEndian = *(unsigned char*)&nOne==1;
+
+    std::stringstream ss;
+    DoLogBanner(ss,m_sBinarySyncFileName);
+    std::string sHeader = ss.str();
+
+    int nColumns = 1+(int)m_UnusedDynamicVariables.size();
+    for(size_t nVar = 0;nVar<m_SynchronousLogVars.size();nVar++)
+    {
+        if(!m_SynchronousLogVars[nVar].empty())
+            nColumns++;
+    }
+
+    sHeader+="%% BINARY SLOG\n";
+    size_t nHeaderBytesAt = sHeader.size()+strlen("%% HEADER BYTES  ");
+    sHeader+="%% HEADER BYTES  0000000000\n";
+    sHeader+=MOOSFormat("%%%% COLUMNS       %d\n",nColumns);
+    sHeader+=MOOSFormat("%%%% ENCODING      float64 %s endian\n",bLittleEndian ? "little" : "big");
+    sHeader+="%%   (1) TIME\n";
+
+    //now for all our variables say what the columns mean..
+    int nCount = 2;
+    for(size_t nVar = 0;nVar<m_SynchronousLogVars.size();nVar++)
+    {
+        //oops empty string!
+        if(m_SynchronousLogVars[nVar].empty())
+            continue;
+
+        sHeader+=MOOSFormat("%%%%   (%d) %s\n",nCount++,m_SynchronousLogVars[nVar].c_str());
+    }
+
+    //unclaimed dynamic columns get room for the name they will be given
+    m_BinaryDynamicNameIndex.clear();
+    STRING_LIST::iterator q;
+    for(q = m_UnusedDynamicVariables.begin();q!=m_UnusedDynamicVariables.end();q++)
+    {
+        sHeader+=MOOSFormat("%%%%   (%d) ",nCount++);
+        m_BinaryDynamicNameIndex[*q] = (std::streamoff)sHeader.size();
+        sHeader+=MOOSFormat("%-*s\n",DYNAMIC_NAME_SPACE,q->c_str());
+    }
+
+    sHeader+="%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%\n";
+
+    //pad with spaces (and a final newline) so the rows are page aligned
+    size_t nHeaderBytes = (sHeader.size()+1+BINARY_SLOG_HEADER_ALIGNMENT-1)/BINARY_SLOG_HEADER_ALIGNMENT*BINARY_SLOG_HEADER_ALIGNMENT;
+    sHeader.append(nHeaderBytes-sHeader.size()-1,' ');
+    sHeader+='\n';
+
+    std::string sBytes = MOOSFormat("%010d",(int)nHeaderBytes);
+    sHeader.replace(nHeaderBytesAt,sBytes.size(),sBytes);
+
+    m_BinarySyncLogFile.write(sHeader.data(),sHeader.size());
+
+    return m_BinarySyncLogFile.good();
+}
+
+bool CMOOSLogger::RenameSyncColumn(std::ofstream & File, std::streampos Where, const std::string & sName)
+{
+    if(!File.is_open())
+        return false;
+
+    //better remember where we are...
+    std::streampos pNow = File.tellp();
+
+    //go there...
+    File.seekp(Where);
+
+    //we only reserved a limited amount of space...
+    File<<setw(DYNAMIC_NAME_SPACE-1)<<left<<sName.substr(0,DYNAMIC_NAME_SPACE-1);
+
+    //and return from whence you came....
+    File.seekp(pNow);
+
+    return File.good();
+}
+
 bool CMOOSLogger::OpenSystemFile()
 {
 
@@ -860,6 +2052,9 @@ bool CMOOSLogger::OpenSystemFile()
 
     DoLogBanner(m_SystemLogFile,m_sSystemFileName);
 
+    //nothing in it is committed yet
+    m_dfSyncDurableTime = MOOSTime();
+
     return true;
 }
 
@@ -867,46 +2062,46 @@ bool CMOOSLogger::OpenSystemFile()
 
 bool CMOOSLogger::OpenAsyncFiles()
 {
+	//always start in the first segment
+	m_nSegment = 0;
+	m_pSegment = &m_Segments[0];
+	m_eSpareState = SPARE_FREE;
 
-
-		
-	if(m_bCompressAlog)
+	for(int i = 0;i<2;i++)
 	{
-		//we need to write a banner to a compressed stream
-		std::stringstream ss;
-		DoLogBanner(ss,m_sAsyncFileName);
-		m_AlogZipper.Push(ss.str());
-
-		if(m_bUseExcludedLog)
-		{
-			m_XlogZipper.Push(ss.str());
-		}
+		m_Segments[i].SetContents(m_bTextAlog,
+			m_bColumnarLog,
+			m_bCompressAlog,
+			m_bUseExcludedLog,
+			m_bIndexAlog,
+			m_nAlogIndexInterval,
+			m_bDedupBinary);
 	}
-	else
-	{
-		//usual banner write to a regular alog file
-		if(!OpenFile(m_AsyncLogFile,m_sAsyncFileName))
-			return MOOSFail("Failed to Open alog file");
 
-		DoLogBanner(m_AsyncLogFile,m_sAsyncFileName);
-		
-		if(m_bUseExcludedLog)
-		{
-			if(!OpenFile(m_ExcludeLogFile, m_sExcludeFileName))
-				return MOOSFail("failed to open xlog log");
-		}
+	std::string sRootName = MakeSegmentRootName(m_nSegment);
+	std::string sAsyncFileName = m_sLogDirectoryName+"/"+sRootName+".alog";
+
+	std::stringstream ss;
+	DoLogBanner(ss,sAsyncFileName,true);
+
+	if(!m_pSegment->Open(m_sLogDirectoryName,sRootName,ss.str(),GetAppStartTime()))
+	{
+		MOOSDebugWrite(MOOSFormat("ERROR: Failed to open log files: %s",sAsyncFileName.c_str()));
+		return MOOSFail("Failed to open the asynchronous log files");
 	}
 
-	//also open a binary log file - this is always created
+	if(m_bCompressAlog)
+		MOOSTrace("pLogger: Alog compression is enabled (%s)\n",m_pSegment->m_AlogZipper.GetCodecName().c_str());
 
-    //*note* that the binary file is _not_ compressed
-    //no matter what flags you set - this is so that
-    //we can jump around in it using memory offsets
+	m_dfSegmentStartTime = MOOSLocalTime();
 
-	if(!OpenFile(m_BinaryLogFile,m_sBinaryFileName))
-		return MOOSFail("Failed to Open blog file");
-	
-	m_BinaryCursor = m_BinaryLogFile.tellp();
+	//segments after this one are opened and closed in the background
+	if(m_nRotateBytes>0 || m_dfRotatePeriod>0)
+	{
+		m_RotationThread.Initialise(_RotationThreadWorker,this);
+		if(!m_RotationThread.Start())
+			return MOOSFail("Failed to start the log rotation thread");
+	}
 
     return true;
 }
@@ -919,11 +2114,16 @@ bool CMOOSLogger::LogSystemMessages(MOOSMSG_LIST &NewMail)
 
     double dfTimeNow = MOOSTime();
 
+    std::streampos Start = -1;
+    unsigned long long nLogged = 0;
+
     for(p = NewMail.begin();p!=NewMail.end();p++)
     {
         CMOOSMsg & rMsg = *p;
         if(IsSystemMessage(rMsg.m_sKey) && !rMsg.IsSkewed(dfTimeNow))
         {
+            if(nLogged++==0)
+                Start = m_SystemLogFile.tellp();
 
             m_SystemLogFile<<setw(10)<<setprecision(7)<<rMsg.m_dfTime-GetAppStartTime()<<' ';
 
@@ -940,10 +2140,14 @@ bool CMOOSLogger::LogSystemMessages(MOOSMSG_LIST &NewMail)
                 MOOSRemoveChars(rMsg.m_sVal,"\n");
                 m_SystemLogFile<<setw(20)<<rMsg.m_sVal.c_str()<<' ';
             }
-            m_SystemLogFile<<endl;
+            //no flush here - the ylog is committed with the slog (see Iterate)
+            m_SystemLogFile<<'\n';
         }
     }
 
+    if(nLogged>0)
+        m_Stats.Count(CLoggerStats::YLOG,nLogged,(unsigned long long)(m_SystemLogFile.tellp()-Start));
+
     return true;
 }
 
@@ -955,7 +2159,7 @@ bool CMOOSLogger::IsSystemMessage(string &sKey)
     return false;
 }
 
-bool CMOOSLogger::DoLogBanner(ostream &os, string &sFileName)
+bool CMOOSLogger::DoLogBanner(ostream &os, string &sFileName, bool bAsync)
 {
     os<<"%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%\n";
     os<<"%% LOG FILE:       "<<sFileName.c_str()<<endl;
@@ -963,6 +2167,8 @@ bool CMOOSLogger::DoLogBanner(ostream &os, string &sFileName)
     os<<"%% LOGSTART        "<<setw(20)<<setprecision(12)<<GetAppStartTime()<<endl;
     if(m_bMarkDataType)
     	os<<"%% DATATYPE MARKING ON\n";
+    if(bAsync && m_bLogReceiveTime)
+    	os<<"%% RECEIVE TIME ON\n";
     os<<"%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%\n";
 
     return true;
@@ -1086,6 +2292,8 @@ bool CMOOSLogger::CreateDirectory(const std::string & sDirectory)
 
 bool CMOOSLogger::OnNewSession()
 {
+	//variables logged on change start afresh in the new files
+	m_nPolicyEpoch++;
 
 	//what is the root name of all log files?
 	m_sLogRootName = MakeLogName(m_sStemFileName);
@@ -1124,13 +2332,11 @@ bool CMOOSLogger::OnNewSession()
     }
     
 
-    m_sAsyncFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".alog";
-    m_sExcludeFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".xlog";    
 	m_sSyncFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".slog";
+	m_sBinarySyncFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".bslog";
     m_sSystemFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".ylog";
     m_sMissionCopyName = m_sLogDirectoryName+"/"+m_sLogRootName+"._moos";
     m_sHoofCopyName = m_sLogDirectoryName+"/"+m_sLogRootName+"._hoof";
-	m_sBinaryFileName = m_sLogDirectoryName+"/"+m_sLogRootName+".blog";
 	
     if(!OpenAsyncFiles())
         return MOOSFail("Error:\n\tUnable to open Asynchronous log file\n");
@@ -1143,35 +2349,178 @@ bool CMOOSLogger::OnNewSession()
 
     if(!CopyMissionFile())
         MOOSTrace("Warning:\n\tunable to create a back up of the mission file\n");
-	
-	
-	if(m_bCompressAlog)
+
+    return true;
+}
+
+std::string CMOOSLogger::MakeSegmentRootName(int nSegment)
+{
+	//when rotating every segment gets a number, otherwise names are as they always were
+	if(m_nRotateBytes>0 || m_dfRotatePeriod>0)
+		return MOOSFormat("%s_%03d",m_sLogRootName.c_str(),nSegment);
+
+	return m_sLogRootName;
+}
+
+bool CMOOSLogger::ParseRotation(std::string sRotation)
+{
+	m_nRotateBytes = 0;
+	m_dfRotatePeriod = 0;
+
+	while(!sRotation.empty())
 	{
-#ifdef ZLIB_FOUND
-		//restart the a log zipper
-		MOOSTrace("pLogger: Alog compression is enabled\n");
-		if(m_AlogZipper.IsRunning())
-		{
-			m_AlogZipper.Stop();
-		}
-		m_AlogZipper.Start(m_sAsyncFileName);
+		std::string sLimit = MOOSChomp(sRotation,",");
+		MOOSTrimWhiteSpace(sLimit);
+
+		//a number followed by its unit
+		size_t nUnit = sLimit.find_first_not_of("0123456789.");
+		if(nUnit==0 || nUnit==std::string::npos)
+			return false;
+
+		double dfValue = atof(sLimit.substr(0,nUnit).c_str());
+		std::string sUnit = sLimit.substr(nUnit);
+		MOOSTrimWhiteSpace(sUnit);
+		if(dfValue<=0)
+			return false;
+
+		if(MOOSStrCmp(sUnit,"B"))
+			m_nRotateBytes = (unsigned long long)dfValue;
+		else if(MOOSStrCmp(sUnit,"KB"))
+			m_nRotateBytes = (unsigned long long)(dfValue*1024);
+		else if(MOOSStrCmp(sUnit,"MB"))
+			m_nRotateBytes = (unsigned long long)(dfValue*1024*1024);
+		else if(MOOSStrCmp(sUnit,"GB"))
+			m_nRotateBytes = (unsigned long long)(dfValue*1024*1024*1024);
+		else if(MOOSStrCmp(sUnit,"s") || MOOSStrCmp(sUnit,"sec"))
+			m_dfRotatePeriod = dfValue;
+		else if(MOOSStrCmp(sUnit,"min"))
+			m_dfRotatePeriod = dfValue*60;
+		else if(MOOSStrCmp(sUnit,"h"))
+			m_dfRotatePeriod = dfValue*3600;
+		else if(MOOSStrCmp(sUnit,"d"))
+			m_dfRotatePeriod = dfValue*86400;
+		else
+			return false;
+	}
 
-		//restart the Xlog zipper
-		if(m_XlogZipper.IsRunning())
-		{
-			m_XlogZipper.Stop();
-		}
-		m_XlogZipper.Start(m_sExcludeFileName);
-		
+	return m_nRotateBytes>0 || m_dfRotatePeriod>0;
+}
 
-#else
-		m_bCompressAlog = false;
-		MOOSTrace("WARNING: alogs will not be compressed because zlib was not found at build time");
-#endif
+bool CMOOSLogger::CheckRotation()
+{
+	if(m_nRotateBytes==0 && m_dfRotatePeriod<=0)
+		return true;
+
+	unsigned long long nSize = m_pSegment->GetSize();
+	double dfElapsed = MOOSLocalTime()-m_dfSegmentStartTime;
+
+	//timed rotations get the next segment ready a little in advance
+	double dfLead = std::min(ROTATION_PREPARE_LEAD,0.1*m_dfRotatePeriod);
+
+	bool bDue = (m_nRotateBytes>0 && nSize>=m_nRotateBytes) ||
+		(m_dfRotatePeriod>0 && dfElapsed>=m_dfRotatePeriod);
+
+	bool bSoon = bDue ||
+		(m_nRotateBytes>0 && nSize>=ROTATION_PREPARE_FRACTION*m_nRotateBytes) ||
+		(m_dfRotatePeriod>0 && dfElapsed>=m_dfRotatePeriod-dfLead);
+
+	if(!bSoon)
+		return true;
+
+	m_RotationLock.Lock();
+
+	if(m_eSpareState==SPARE_FREE)
+	{
+		//ask the rotation thread to open the next segment
+		m_sSpareRootName = MakeSegmentRootName(m_nSegment+1);
+
+		std::stringstream ss;
+		std::string sAsyncFileName = m_sLogDirectoryName+"/"+m_sSpareRootName+".alog";
+		DoLogBanner(ss,sAsyncFileName,true);
+		m_sSpareBanner = ss.str();
+
+		m_eSpareState = SPARE_PREPARING;
+		m_RotationSignal.Set();
+	}
+	else if(m_eSpareState==SPARE_READY && bDue)
+	{
+		//the swap - from here on mail goes to the new segment and the
+		//rotation thread closes the old one. If the spare isn't ready yet
+		//we just keep writing where we are
+		m_pSegment = m_pSegment==&m_Segments[0] ? &m_Segments[1] : &m_Segments[0];
+		m_nSegment++;
+		m_nPolicyEpoch++;
+		m_dfSegmentStartTime = MOOSLocalTime();
+
+		m_eSpareState = SPARE_RETIRING;
+		m_RotationSignal.Set();
 	}
-	
 
-    return true;
+	m_RotationLock.UnLock();
+
+	return true;
+}
+
+bool CMOOSLogger::ProcessRotation()
+{
+	m_RotationLock.Lock();
+	SpareState eState = m_eSpareState;
+	CLogSegment & rSpare = m_pSegment==&m_Segments[0] ? m_Segments[1] : m_Segments[0];
+	std::string sRootName = m_sSpareRootName;
+	std::string sBanner = m_sSpareBanner;
+	m_RotationLock.UnLock();
+
+	bool bOK = true;
+	switch(eState)
+	{
+		case SPARE_PREPARING:
+			//no point opening files just to remove them again
+			if(m_RotationThread.IsQuitRequested())
+				break;
+
+			bOK = rSpare.Open(m_sLogDirectoryName,sRootName,sBanner,GetAppStartTime());
+			if(!bOK)
+			{
+				MOOSTrace("pLogger: failed to open log segment %s - will try again\n",sRootName.c_str());
+				rSpare.Discard();
+				MOOSPause(ROTATION_RETRY_MS);
+			}
+
+			m_RotationLock.Lock();
+			m_eSpareState = bOK ? SPARE_READY : SPARE_FREE;
+			m_RotationLock.UnLock();
+			break;
+
+		case SPARE_RETIRING:
+			bOK = rSpare.Close();
+			if(!m_sCompressRotated.empty())
+				bOK = rSpare.CompressClosedFiles(m_sCompressRotated) && bOK;
+
+			m_RotationLock.Lock();
+			m_eSpareState = SPARE_FREE;
+			m_RotationLock.UnLock();
+			break;
+
+		default:
+			break;
+	}
+
+	return bOK;
+}
+
+bool CMOOSLogger::DoRotation()
+{
+	while(!m_RotationThread.IsQuitRequested())
+	{
+		m_RotationSignal.Wait(500);
+
+		ProcessRotation();
+	}
+
+	//a segment retired just before we were asked to quit still needs closing
+	ProcessRotation();
+
+	return true;
 }
 
 
@@ -1205,124 +2554,304 @@ bool CMOOSLogger::OnLoggerRestart()
 
 CMOOSLogger::LogType CMOOSLogger::GetDestinationLog(const std::string & sMsg)
 {
-	std::map<std::string,LogType>::iterator q =  m_LogDestinations.find(sMsg);
-	if( q==m_LogDestinations.end())
+	KeyRecord * pKey = m_Keys.Find(sMsg);
+	if(pKey==NULL)
 		return UNKNOWN;
 	else 
-		return q->second;
+		return pKey->eLog;
 	
 }
 
 bool CMOOSLogger::DoAsyncLog(MOOSMSG_LIST &NewMail)
 {
-    //log asynchronously...
-    if(m_bAsynchronousLog)
-    {
-        MOOSMSG_LIST::iterator q;
+	double dfTimeNow = MOOSTime();
+
+	//the whole batch arrived together
+	double dfReceived = (m_bLogReceiveTime || m_bLatencyStats) ? m_ReceiveClock.GetTime() : dfTimeNow;
+
+	//everything in a batch goes to the same segment
+	CLogSegment & rSegment = *m_pSegment;
+
+	//one reusable buffer per destination (alog, xlog) - these keep their
+	//memory between calls so formatting a batch costs no allocation
+	m_AsyncEncoder[0].Clear();
+	m_AsyncEncoder[1].Clear();
+	unsigned long long nEntries[2] = {0,0};
+
+	//alog entries for the shards are gathered the same way - with the time of the
+	//first entry each gets so the shard index can place the batch
+	bool bSharded = !rSegment.m_Shards.empty();
+	unsigned long long nShardEntries = 0;
+	std::vector<unsigned long long> ShardEntries(m_ShardEncoders.size(),0);
+	double dfFirstTime = -1;
+	std::vector<double> ShardFirstTimes(m_ShardEncoders.size(),-1.0);
+	for(size_t j = 0;j<m_ShardEncoders.size();j++)
+		m_ShardEncoders[j].Clear();
+
+	//is the disk keeping up? - decided once a batch. A batch holding critical entries is
+	//never discarded by the staging buffers, it waits for room instead
+	if(m_bOverloadShedding && m_bAsynchronousLog)
+		UpdateShedding(dfTimeNow);
+	bool bCritical = false;
+
+	MOOSMSG_LIST::iterator q;
+	for(q = NewMail.begin();q!=NewMail.end();q++)
+	{
+		CMOOSMsg & rMsg = *q;
 
-		std::stringstream sStream[2];
+		//the flight recorder keeps everything, logged or not
+		if(m_FlightRecorder.IsEnabled())
+			m_FlightRecorder.Add(rMsg,GetSourceString(rMsg));
 
-        for(q = NewMail.begin();q!=NewMail.end();q++)
-        {
-            CMOOSMsg & rMsg = *q;
+		//one look up says whether (and where) we log this kind of message
+		//and gives the variable which holds it for the synchronous log
+		KeyRecord * pKey = FindKey(rMsg.m_sKey);
+		if(pKey==NULL || pKey->pVar==NULL)
+			continue;
 
-            //now see if we are logging this kind of message..
-            //if so we will have a variable named after it...
-            //which is used for the synchronous case..
-            if(m_MOOSVars.find(rMsg.m_sKey)!=m_MOOSVars.end())
-            {
-				
-				
-				std::stringstream sEntry;
-				
-				sEntry.setf(ios::left);
-				
-				sEntry.setf(ios::fixed);
+		if(!rMsg.IsSkewed(dfTimeNow))
+			pKey->pVar->Set(rMsg);
 
-				sEntry<<setw(15)<<setprecision(3)<<rMsg.GetTime()-GetAppStartTime()<<' ';
+		//how long did it take to get here?
+		if(m_bLatencyStats && rMsg.GetTime()!=-1)
+		{
+			if(pKey->pLatency==NULL)
+			{
+				CLatencyHistogram * & pLatency = m_Latencies[rMsg.m_sKey];
+				if(pLatency==NULL)
+					pLatency = new CLatencyHistogram;
+				pKey->pLatency = pLatency;
+			}
+			pKey->pLatency->Add(dfReceived-rMsg.GetTime());
+		}
 
-				sEntry<<setw(20)<<rMsg.GetKey()<<' ';
+		//log asynchronously...
+		if(!m_bAsynchronousLog || pKey->eLog==NOLOG)
+			continue;
 
-				//fill in the src string
-			    std::string sSrcString = rMsg.GetSource();
+		//a wildcard subscription brings every message - keep to the rate
+		//asked for on the LOG line as the DB would have
+		if(pKey->dfPeriod>0 && m_bWildCardSubscribed)
+		{
+			if(pKey->dfLastPeriodic>=0 && rMsg.GetTime()-pKey->dfLastPeriodic<pKey->dfPeriod)
+				continue;
+			pKey->dfLastPeriodic = rMsg.GetTime();
+		}
 
-				if(m_bLogAuxSrc && !rMsg.GetSourceAux().empty() )
-				{
-					//if the AuxSrc string is empty just write nothing
-					sSrcString+=":"+rMsg.GetSourceAux();
-				}
-				if(m_bMarkExternalCommunityMessages)
-				{
-					//yes we are being asked to log external deliveries
-					if(rMsg.m_sOriginatingCommunity!=m_Comms.GetCommunityName())
-					{
-						//yes this is from an external community
-						sSrcString+="@"+rMsg.m_sOriginatingCommunity;
-					}
-				}
-			    sEntry<<setw(15)<<sSrcString<<' ';
+		//shed the least important traffic first while the disk is falling behind
+		if(m_nShedLevel>0 && IsShed(*pKey))
+		{
+			m_nShedMsgs++;
+			continue;
+		}
+		bCritical = bCritical || pKey->ePriority==CRITICAL;
 
+		//variables logged on change are judged before any formatting so a message
+		//which isn't logged costs a comparison (the synchronous log still sees it)
+		if(pKey->bPolicy && !IsLogDue(*pKey,rMsg))
+		{
+			m_nSuppressedMsgs++;
+			continue;
+		}
 
-				if(rMsg.IsDataType(MOOS_STRING) || rMsg.IsDataType(MOOS_DOUBLE))
-				{
-					if(m_bMarkDataType)
-						sEntry<<(rMsg.IsDouble() ? "D:" : "S:");
+		int i = (m_bUseExcludedLog && pKey->eLog==XLOG) ? 1 : 0;
 
-					sEntry<<rMsg.GetAsString(12,m_nDoublePrecision)<<' ';
+		if(i==0 && m_bColumnarLog)
+		{
+			unsigned long long nBefore = rSegment.m_ColumnarLog.GetSize();
+			rSegment.m_ColumnarLog.Add(rMsg,rMsg.GetTime()-GetAppStartTime(),GetSourceString(rMsg));
+			m_Stats.Count(CLoggerStats::CLOG,1,rSegment.m_ColumnarLog.GetSize()-nBefore);
 
-				}
-				else if(rMsg.IsDataType(MOOS_BINARY_STRING))
-				{
-					//here we append to the binary log and begin each line with a summary....
-					m_BinaryLogFile<<sEntry.str();
-					
-					//write in coordinates in the alog
-					sEntry<<"<MOOS_BINARY>File="<<(m_sLogRootName+".blog")<<",Offset="<<m_BinaryLogFile.tellp()<<",Bytes="<<rMsg.m_sVal.size()<<"</MOOS_BINARY>";
-					
-					//write the binary data to file
-					m_BinaryLogFile.write(rMsg.m_sVal.data(), rMsg.m_sVal.size());
-					
-					//add a new line so even the binary log file is broadly human readable
-					m_BinaryLogFile<<std::endl;
-					
-				}
-				
-				
-				
-				int i=0;
-				if(m_bUseExcludedLog)
-				{
-					switch(GetDestinationLog(rMsg.m_sKey))
-					{
-						case XLOG: i = 1; break;
-						case ALOG: i = 0; break;
-						default:
-							i = 0;
-					}
-				}
-                sStream[i]<<sEntry.str()<<endl;
-				
-				
-            }
-        }
-		
-		if(m_bCompressAlog)
+			//binary data is stored in the clog itself
+			if(!m_bTextAlog)
+				continue;
+		}
+
+		unsigned int nShard = 0;
+		if(i==0 && bSharded)
+		{
+			if(!m_bShardBySource)
+			{
+				nShard = pKey->nShard;
+			}
+			else
+			{
+				//a handful of sources - decide about each once
+				std::map<std::string, unsigned int>::iterator s = m_SourceShards.find(rMsg.m_sSrc);
+				if(s==m_SourceShards.end())
+					s = m_SourceShards.insert(std::make_pair(rMsg.m_sSrc,DecideShard(rMsg.m_sSrc))).first;
+				nShard = s->second;
+			}
+		}
+
+		CAlogEncoder & rEntry = nShard==0 ? m_AsyncEncoder[i] : m_ShardEncoders[nShard-1];
+		size_t nEntryStart = rEntry.Size();
+
+		if(nShard!=0)
 		{
-			//send to the worker thread...
-			m_AlogZipper.Push(sStream[0].str());
-			m_XlogZipper.Push(sStream[1].str());
+			nShardEntries++;
+			ShardEntries[nShard-1]++;
+			if(ShardFirstTimes[nShard-1]<0)
+				ShardFirstTimes[nShard-1] = rMsg.GetTime()-GetAppStartTime();
 		}
 		else
 		{
-			//a regular write
-			if(m_AsyncLogFile.is_open())
-				m_AsyncLogFile<<sStream[0].str();
+			nEntries[i]++;
+			if(i==0 && dfFirstTime<0)
+				dfFirstTime = rMsg.GetTime()-GetAppStartTime();
+		}
+
+		if(i==0 && nShard==0 && rSegment.m_AlogIndex.IsOpen())
+		{
+			rSegment.m_AlogIndex.AddEntry(rMsg.GetTime()-GetAppStartTime(),rMsg.m_sKey,rSegment.m_nAlogBytes+nEntryStart);
+		}
+
+		rEntry.AppendFixed(rMsg.GetTime()-GetAppStartTime(),15,3);
+		rEntry.Append(' ');
+
+		if(m_bLogReceiveTime)
+		{
+			rEntry.AppendFixed(dfReceived-GetAppStartTime(),15,3);
+			rEntry.Append(' ');
+		}
+
+		rEntry.AppendPadded(rMsg.m_sKey,20);
+		rEntry.Append(' ');
+
+		rEntry.AppendPadded(GetSourceString(rMsg),15);
+		rEntry.Append(' ');
+
+
+		if(rMsg.IsDataType(MOOS_STRING) || rMsg.IsDataType(MOOS_DOUBLE))
+		{
+			if(m_bMarkDataType)
+				rEntry.Append(rMsg.IsDouble() ? "D:" : "S:");
+
+			if(rMsg.GetTime()==-1)
+			{
+				//unset messages are rare enough not to need a fast path
+				rEntry.Append(rMsg.GetAsString(12,m_nDoublePrecision));
+			}
+			else if(rMsg.IsDouble())
+			{
+				rEntry.AppendFixed(rMsg.m_dfVal,12,m_nDoublePrecision);
+			}
+			else
+			{
+				rEntry.Append(rMsg.m_sVal);
+			}
+			rEntry.Append(' ');
+
+		}
+		else if(rMsg.IsDataType(MOOS_BINARY_STRING))
+		{
+			//here we append to the binary log and begin each line with a summary.... the
+			//record is queued for the blog thread which tells us where the payload will be
+			unsigned long long nBlogBefore = rSegment.m_BinaryLog.GetSize();
+			unsigned long long nOffset = rSegment.m_BinaryLog.Add(rEntry.GetBuffer().data()+nEntryStart, rEntry.Size()-nEntryStart, rMsg.m_sVal);
+			m_Stats.Count(CLoggerStats::BLOG,1,rSegment.m_BinaryLog.GetSize()-nBlogBefore);
 			
-			if(m_ExcludeLogFile.is_open())
-				m_ExcludeLogFile<<sStream[1].str();
+			//write in coordinates in the alog
+			rEntry.Append("<MOOS_BINARY>File=");
+			rEntry.Append(rSegment.m_sRootName);
+			rEntry.Append(".blog,Offset=");
+			rEntry.AppendInteger((long long)nOffset);
+			rEntry.Append(",Bytes=");
+			rEntry.AppendInteger((long long)rMsg.m_sVal.size());
+			rEntry.Append("</MOOS_BINARY>");
 		}
-    }
-    return true;
+
+		rEntry.Append('\n');
+	}
+
+	if(!m_bAsynchronousLog)
+		return true;
+
+	//say where this batch went in each file before it is queued
+	if(bSharded)
+	{
+		if(dfFirstTime>=0)
+			rSegment.m_ShardIndex.AddBatch(m_nShardBatch,0,rSegment.m_nAlogBytes,dfFirstTime);
+
+		unsigned long long nShardBytes = 0;
+		for(size_t j = 0;j<m_ShardEncoders.size();j++)
+		{
+			if(ShardFirstTimes[j]<0)
+				continue;
+
+			CLogShard & rShard = *rSegment.m_Shards[j];
+			rSegment.m_ShardIndex.AddBatch(m_nShardBatch,(unsigned int)j+1,rShard.GetSize(),ShardFirstTimes[j]);
+			nShardBytes+=m_ShardEncoders[j].Size();
+
+			//each shard has its own writer thread so they fill (and wait on) their disks in parallel
+			if(!rShard.Push(m_ShardEncoders[j].GetBuffer(),bCritical))
+				m_nStagingDroppedMsgs+=ShardEntries[j];
+		}
+		rSegment.m_ShardIndex.Flush();
+		m_Stats.Count(CLoggerStats::ALOG,nShardEntries,nShardBytes);
+		m_nShardBatch++;
+	}
+
+	rSegment.m_nAlogBytes+=m_AsyncEncoder[0].Size();
+	m_Stats.Count(CLoggerStats::ALOG,nEntries[0],m_AsyncEncoder[0].Size());
+	m_Stats.Count(CLoggerStats::XLOG,nEntries[1],m_AsyncEncoder[1].Size());
+
+	if(m_bCompressAlog)
+	{
+		//send to the worker thread... a batch which couldn't be queued or spilled is lost
+		if(rSegment.m_AlogZipper.IsRunning() && !rSegment.m_AlogZipper.Push(m_AsyncEncoder[0].GetBuffer(),bCritical))
+		{
+			rSegment.m_nAlogBytes-=m_AsyncEncoder[0].Size();
+			m_nStagingDroppedMsgs+=nEntries[0];
+		}
+
+		if(rSegment.m_XlogZipper.IsRunning() && !rSegment.m_XlogZipper.Push(m_AsyncEncoder[1].GetBuffer(),bCritical))
+			m_nStagingDroppedMsgs+=nEntries[1];
+	}
+	else
+	{
+		//hand to the writer threads - this never touches the disk. If staging was full
+		//and the batch dropped the alog didn't grow (there is no index to have listed it -
+		//drop_newest isn't allowed with one)
+		if(rSegment.m_AlogWriter.IsRunning() && !rSegment.m_AlogWriter.Push(m_AsyncEncoder[0].GetBuffer(),bCritical))
+		{
+			rSegment.m_nAlogBytes-=m_AsyncEncoder[0].Size();
+			m_nStagingDroppedMsgs+=nEntries[0];
+		}
+
+		if(rSegment.m_XlogWriter.IsRunning() && !rSegment.m_XlogWriter.Push(m_AsyncEncoder[1].GetBuffer(),bCritical))
+			m_nStagingDroppedMsgs+=nEntries[1];
+	}
+
+	//time for a new segment?
+	CheckRotation();
+
+	return true;
+}
+
+const std::string & CMOOSLogger::GetSourceString(const CMOOSMsg & rMsg)
+{
+	//built in a member string so that once it has grown no allocation is needed
+	m_sSourceString = rMsg.m_sSrc;
+
+	if(m_bLogAuxSrc && !rMsg.m_sSrcAux.empty() )
+	{
+		//if the AuxSrc string is empty just write nothing
+		m_sSourceString+=':';
+		m_sSourceString+=rMsg.m_sSrcAux;
+	}
+	if(m_bMarkExternalCommunityMessages)
+	{
+		//yes we are being asked to log external deliveries
+		if(rMsg.m_sOriginatingCommunity!=m_Comms.GetCommunityName())
+		{
+			//yes this is from an external community
+			m_sSourceString+='@';
+			m_sSourceString+=rMsg.m_sOriginatingCommunity;
+		}
+	}
+
+	return m_sSourceString;
 }
 
 bool CMOOSLogger::CopyMissionFile()
@@ -1418,6 +2947,11 @@ bool CMOOSLogger::OnCommandMsg(CMOOSMsg Msg)
     {
         HandleDynamicLogRequest(sParam);
     }
+    else if(MOOSStrCmp(sTask,"LOGGER_SNAPSHOT") || MOOSStrCmp(sCmd,"LOGGER_SNAPSHOT"))
+    {
+        //LOGGER_SNAPSHOT or LOGGER_SNAPSHOT=why
+        RequestSnapshot(sParam.empty() ? std::string("LOGGER_SNAPSHOT") : sParam);
+    }
     else if(MOOSStrCmp(sTask,"COPY_FILE_REQUEST"))
     {
         HandleCopyFileRequest(sParam);
@@ -1493,23 +3027,13 @@ bool CMOOSLogger::HandleDynamicLogRequest(std::string sRequest)
             std::string sDynamic = m_UnusedDynamicVariables.front();
 
             //remember where the next string will be..
-            if(m_DynamicNameIndex.find(sDynamic)==m_DynamicNameIndex.end())
+            if(m_bTextSyncLog && m_DynamicNameIndex.find(sDynamic)==m_DynamicNameIndex.end())
             {
                 MOOSAssert("this is a logical error - call PMN");
             }
 
 
-            //better remember where we are...
-            std::streampos pNow =  m_SyncLogFile.tellp();
-
-            //where do we write the new name to?
-            std::streampos p = m_DynamicNameIndex[sDynamic];
-
-            //go there...
-            m_SyncLogFile.seekp(p);
-
-            //write the as yet unclaimed name - note we are also writing a tonne of spare space so we can
-            //later acccess the file here and write a new MOOS variable name..
+            //write the name over the placeholder - we left a tonne of spare space there
             if(sNewVar.size()>DYNAMIC_NAME_SPACE-1)
             {
                 //we only reserved a limited amount of space...
@@ -1518,10 +3042,11 @@ bool CMOOSLogger::HandleDynamicLogRequest(std::string sRequest)
                     DYNAMIC_NAME_SPACE-1);
             }
 
-            m_SyncLogFile<<setw(DYNAMIC_NAME_SPACE-1)<<left<<sNewVar;;
+            if(m_bTextSyncLog)
+                RenameSyncColumn(m_SyncLogFile,m_DynamicNameIndex[sDynamic],sNewVar);
 
-            //and return from whence you came....
-            m_SyncLogFile.seekp(pNow);
+            if(m_BinaryDynamicNameIndex.find(sDynamic)!=m_BinaryDynamicNameIndex.end())
+                RenameSyncColumn(m_BinarySyncLogFile,m_BinaryDynamicNameIndex[sDynamic],sNewVar);
 
             //pop the name of a now used, dynamic variable
             m_UnusedDynamicVariables.pop_front();
@@ -1551,6 +3076,32 @@ std::string CMOOSLogger::MakeStatusString()
     std::stringstream ss;
     ss<<CMOOSApp::MakeStatusString()<<",";
     ss<<"LogAuxSrc="<<std::boolalpha<<m_bLogAuxSrc;
+    CLogSegment & rSegment = *m_pSegment;
+    if(m_nRotateBytes>0 || m_dfRotatePeriod>0)
+    {
+        ss<<",Segment="<<m_nSegment;
+    }
+    if(m_bDedupBinary)
+    {
+        ss<<",BlogDuplicateBytes="<<rSegment.m_BinaryLog.GetDuplicateBytes();
+    }
+    if(!m_sStats.empty())
+    {
+        ss<<","<<m_sStats;
+    }
+    if(m_bCompressAlog)
+    {
+        ss<<",AlogCodec="<<rSegment.m_AlogZipper.GetCodecName();
+        ss<<",AlogZipQueue="<<rSegment.m_AlogZipper.GetQueueDepth();
+        ss<<",AlogZipDropped="<<rSegment.m_AlogZipper.GetDroppedBytes();
+        ss<<",AlogZipSpilled="<<rSegment.m_AlogZipper.GetSpilledBytes();
+        if(m_bUseExcludedLog)
+        {
+            ss<<",XlogZipQueue="<<rSegment.m_XlogZipper.GetQueueDepth();
+            ss<<",XlogZipDropped="<<rSegment.m_XlogZipper.GetDroppedBytes();
+            ss<<",XlogZipSpilled="<<rSegment.m_XlogZipper.GetSpilledBytes();
+        }
+    }
     return ss.str();
 }
 
@@ -37,7 +37,15 @@
 #include <fstream>
 #include <set>
 #include <string>
-#include "Zipper.h"
+#include "AlogEncoder.h"
+#include "LogSegment.h"
+#include "LoggerStats.h"
+#include "LatencyHistogram.h"
+#include "LogSignal.h"
+#include "KeyTable.h"
+#include "WildcardMatcher.h"
+#include "FlightRecorder.h"
+#include "MonotonicClock.h"
 
 #if _WIN32
     #include <windows.h>
@@ -76,6 +84,9 @@ public:
 	/** call to shut everything down and exit cleanly */
 	bool ShutDown();
 
+	/** a loop preparing and retiring log segments in the background (if rotating) */
+	bool DoRotation();
+
 
 protected:
 
@@ -83,7 +94,8 @@ protected:
     bool HandleLogRequest(std::string sParam,std::string &sNewVariable, bool bDynamic= false);
     bool HandleDynamicLogRequest(std::string sRequest);
     bool HandleCopyFileRequest(std::string sFileToCopy);
-    bool HandleWildCardLogging();
+    bool AddLoggedVariable(const std::string & sVar, double dfPeriod);
+    bool RegisterWildCards();
     bool IsWildCardAccepted(const std::string & sVariableName) const;
     bool IsWildCardRejected(const std::string & sVariableName) const;
 
@@ -93,33 +105,48 @@ protected:
     bool OnLoggerRestart();
     bool AddSyncLineOfTimes(double dfTimeNow=-1);
     bool LabelSyncColumns();
-    bool DoLogBanner(std::ostream & os,std::string & sFileName);
+    bool DoLogBanner(std::ostream & os,std::string & sFileName, bool bAsync = false);
     bool IsSystemMessage(std::string & sKey);
     bool LogSystemMessages(MOOSMSG_LIST & NewMail);
     bool OpenAsyncFiles();
     bool OpenSystemFile();
     bool CloseFiles();
     bool OpenSyncFile();
+    bool OpenBinarySyncFile();
+    bool ResolveSyncColumns();
+    bool RenameSyncColumn(std::ofstream & File, std::streampos Where, const std::string & sName);
     bool DoSyncLog(double dfTimeNow);
     std::string MakeLogName(std::string sStem);
     bool OpenFile(std::ofstream & of,const std::string & sName, bool bBinary = false);
     bool OnNewSession();
+    std::string MakeSegmentRootName(int nSegment);
+    bool CheckRotation();
+    bool ProcessRotation();
+    bool ParseRotation(std::string sRotation);
     bool CreateDirectory(const std::string & sDirectory);
     std::string MakeStatusString();
+    bool CommitSyncFiles(double dfTimeNow);
+    double GetDurableTime();
+    bool UpdateStats(double dfTimeNow);
+    std::string MakeStatsString();
+    void PrintStats();
+    std::string MakeLatencyString();
+    bool CheckStaging();
+    void UpdateShedding(double dfTimeNow);
+    void LogSystemEvent(const std::string & sKey, const std::string & sValue);
+    bool RequestSnapshot(const std::string & sReason);
+    bool TakeSnapshot();
+    const std::string & GetSourceString(const CMOOSMsg & rMsg);
 
-    std::ofstream m_AsyncLogFile;
-    std::ofstream m_ExcludeLogFile;
     std::ofstream m_SyncLogFile;
+    std::ofstream m_BinarySyncLogFile;
     std::ofstream m_SystemLogFile;
-    std::ofstream m_BinaryLogFile;
 
 	
 	std::string m_sLogRootName;
-    std::string m_sAsyncFileName;
-	std::string m_sExcludeFileName;
     std::string m_sSyncFileName;
+    std::string m_sBinarySyncFileName;
     std::string m_sSystemFileName;
-    std::string m_sBinaryFileName;
 
     std::string m_sMissionCopyName;
     std::string m_sHoofCopyName;
@@ -139,8 +166,91 @@ protected:
 
 	//variables to do with compressed logging...
 	bool	m_bCompressAlog;
-	CZipper m_AlogZipper;
-	CZipper m_XlogZipper;
+
+	//the alog, xlog, blog, clog and index are written as a segment - there are two
+	//so that when rotating the next can be made ready while the current one fills
+	CLogSegment m_Segments[2];
+	CLogSegment * m_pSegment;
+
+	//rotation - a new segment every so many bytes and/or seconds (0 for never)
+	unsigned long long m_nRotateBytes;
+	double m_dfRotatePeriod;
+	std::string m_sCompressRotated;
+	int m_nSegment;
+	double m_dfSegmentStartTime;
+
+	//the rotation thread opens the spare segment and closes retired ones
+	enum SpareState
+	{
+		SPARE_FREE,
+		SPARE_PREPARING,
+		SPARE_READY,
+		SPARE_RETIRING
+	};
+	CMOOSThread m_RotationThread;
+	CMOOSLock m_RotationLock;
+	CLogSignal m_RotationSignal;
+	SpareState m_eSpareState;
+	std::string m_sSpareRootName;
+	std::string m_sSpareBanner;
+
+	//reusable formatting buffers for alog and xlog entries
+	CAlogEncoder m_AsyncEncoder[2];
+	std::string m_sSourceString;
+
+	//what form do slogs take - text (.slog) and/or rows of doubles (.bslog)
+	bool m_bTextSyncLog;
+	bool m_bBinarySyncLog;
+
+	//the variable behind each slog column - looked up as columns are added not every row
+	std::vector<CMOOSVariable*> m_SyncColumns;
+	size_t m_nResolvedSyncVars;
+
+	//a reusable slog row, as numbers and as text
+	std::vector<double> m_SyncRow;
+	CAlogEncoder m_SyncEncoder;
+
+	//when do files get flushed or synced (see CLogDurability). The segment's writer
+	//threads commit their own files, the slog, bslog and ylog are committed by Iterate
+	CLogDurability m_Durability;
+	double m_dfLastSyncCommitTime;
+	double m_dfSyncDurableTime;
+	double m_dfLastDurablePublishTime;
+
+	//self instrumentation - published as PLOGGER_STATS every m_dfStatsPeriod seconds
+	//(0 for never) and printed to the console if run with --stats
+	CLoggerStats m_Stats;
+	CLatencyHistogram m_WriteLatency;
+
+	//when mail reaches the logger - read once a batch from a clock which never steps.
+	//With LogReceiveTime each alog and xlog line carries it as a second time column
+	//(the banner says RECEIVE TIME ON). With LatencyStats the time from each message's
+	//time stamp to its receipt is kept per variable and the worst variables of each
+	//stats period are published as PLOGGER_LATENCY (VAR=msgs/p50/p99/max in ms, worst
+	//p99 first). Receipt is when the mail loop takes delivery so AppTick bounds the
+	//resolution
+	CMonotonicClock m_ReceiveClock;
+	bool m_bLogReceiveTime;
+	bool m_bLatencyStats;
+	std::map<std::string, CLatencyHistogram*> m_Latencies;
+	CLatencyHistogram m_ReceiveLatency;
+	std::string m_sWorstLatency;
+	double m_dfStatsPeriod;
+	double m_dfLastStatsTime;
+	bool m_bStatsConsole;
+	std::string m_sStats;
+	unsigned int m_nWildCardVars;
+
+	//what form do alogs take - text (.alog) and/or binary columns (.clog)
+	bool m_bTextAlog;
+	bool m_bColumnarLog;
+
+	//sidecar seek index of the alog
+	bool m_bIndexAlog;
+	unsigned long long m_nAlogIndexInterval;
+
+	//optionally store repeated blog payloads once
+	bool m_bDedupBinary;
 	
 	
     //how many synline have been written?
@@ -165,9 +275,6 @@ protected:
     
     //name of a file where logger summary is written
     std::string     m_sSummaryFile;
-	
-	//current position of bianry file pointer
-	std::streampos m_BinaryCursor;
 
 
     //housekeeping variables for checking that monotired messages
@@ -183,11 +290,155 @@ protected:
 		YLOG,
 		SLOG,
 		ALOG,
+		NOLOG,
 		UNKNOWN
 	};
 	
 	CMOOSLogger::LogType GetDestinationLog(const std::string & sStr);
-	std::map<std::string, LogType> m_LogDestinations;
+
+	//where a wildcard candidate should go - ALOG, XLOG or NOLOG
+	CMOOSLogger::LogType DecideWildCard(const std::string & sVariableName) const;
+
+	//how much a variable matters when the disk can't keep up - bulk is shed
+	//first, then normal, and critical never
+	enum Priority
+	{
+		CRITICAL,
+		NORMAL,
+		BULK
+	};
+
+	//the priority a wildcard candidate is logged with (see WildCardPriority)
+	CMOOSLogger::Priority DecideWildCardPriority(const std::string & sVariableName) const;
+
+	//everything a message needs to know about its key, in one place
+	struct KeyRecord
+	{
+		//where it is logged
+		LogType eLog;
+
+		//the variable holding its latest value (NULL if we don't keep one)
+		CMOOSVariable * pVar;
+
+		//decided by the wildcard patterns - and with which version of them
+		bool bWildCard;
+		unsigned int nWildCardVersion;
+
+		//change based logging from the LOG line (see IsLogDue) - log only when the
+		//value changes (by more than dfDeadband if that isn't negative) or when
+		//dfMaxGap seconds (if positive) have passed since it was last logged
+		bool bPolicy;
+		bool bOnChange;
+		double dfDeadband;
+		double dfMaxGap;
+
+		//the period asked for on the LOG line - only enforced here when a wildcard
+		//subscription brings every message (otherwise the DB does it)
+		double dfPeriod;
+		double dfLastPeriodic;
+
+		//what was last logged, when and to which files
+		char cLastType;
+		double dfLastValue;
+		std::string sLastValue;
+		double dfLastLogged;
+		unsigned int nPolicyEpoch;
+
+		//which alog shard its entries go to (0 is the alog itself) when sharding by variable
+		unsigned int nShard;
+
+		//what is shed first under overload and a count for keeping one message in so many
+		Priority ePriority;
+		unsigned int nShedCount;
+
+		//how long its messages take to reach us (owned by m_Latencies, made when first needed)
+		CLatencyHistogram * pLatency;
+
+		KeyRecord() : eLog(ALOG), pVar(NULL), bWildCard(false), nWildCardVersion(0),
+			bPolicy(false), bOnChange(false), dfDeadband(-1), dfMaxGap(0),
+			dfPeriod(0), dfLastPeriodic(-1), cLastType(0), dfLastValue(0), dfLastLogged(0), nPolicyEpoch(0),
+			nShard(0), ePriority(NORMAL), nShedCount(0), pLatency(NULL) {}
+	};
+
+	/** should a message of a variable with a change based policy be logged (updates what was last logged) */
+	bool IsLogDue(KeyRecord & rKey, const CMOOSMsg & rMsg);
+
+	//bumped with each new set of files so every file starts with a value of every variable
+	unsigned int m_nPolicyEpoch;
+
+	//messages not logged because their value hadn't changed
+	unsigned long long m_nSuppressedMsgs;
+
+	//how full the staging buffers may get (0 to 1) before LOGGER_STAGING_ALARM is raised,
+	//whether it is raised and how many messages were discarded because staging was full
+	double m_dfStagingHighWater;
+	bool m_bStagingAlarm;
+	unsigned long long m_nStagingDroppedMsgs;
+
+	//the last few seconds of all traffic, written out as a snapshot alog when
+	//LOGGER_SNAPSHOT is commanded or one of the trigger variables is written -
+	//m_dfSnapshotAfter seconds later so what follows is caught too
+	CFlightRecorder m_FlightRecorder;
+	std::set<std::string> m_FlightRecorderTriggers;
+	double m_dfSnapshotAfter;
+	double m_dfSnapshotDue;
+	std::string m_sSnapshotReason;
+	unsigned int m_nSnapshots;
+
+	//the alog split into shards (LogShard = name : pattern,pattern [@ directory]) by variable
+	//name or, with ShardBy = source, by the name of the process which sent the message. A name
+	//no shard's patterns match stays in the alog (shard 0). A shard without a directory of its
+	//own (an empty entry) is written alongside the alog
+	bool m_bShardBySource;
+	std::vector<std::string> m_ShardNames;
+	std::vector<std::string> m_ShardDirectories;
+	std::vector<CWildcardMatcher> m_ShardMatchers;
+	std::map<std::string, unsigned int> m_SourceShards;
+	std::vector<CAlogEncoder> m_ShardEncoders;
+	unsigned long long m_nShardBatch;
+
+	//overload shedding (OverloadShedding = true) - when the fullest staging buffer or
+	//compression queue stays above m_dfShedHighWater for m_dfShedAfter seconds the level
+	//goes up by one: 1 keeps one in m_nShedDecimation bulk messages, 2 drops all bulk and
+	//3 also keeps one in m_nShedDecimation normal messages. It comes down a level at a time
+	//once the fill has stayed below half the high water mark for as long. Every change of
+	//level and, while shedding, what has been shed each SHED_REPORT_PERIOD goes in the ylog
+	bool m_bOverloadShedding;
+	double m_dfShedHighWater;
+	double m_dfShedAfter;
+	unsigned int m_nShedDecimation;
+	int m_nShedLevel;
+	int m_nShedDirection;
+	double m_dfShedSince;
+	double m_dfLastShedReport;
+	unsigned long long m_nShedMsgs;
+	unsigned long long m_nShedReported;
+
+	/** should a message be shed at the current level (counts towards decimation) */
+	bool IsShed(KeyRecord & rKey);
+
+	/** read ShardBy and LogShard from the configuration and tell the segments */
+	bool ConfigureShards();
+
+	/** which shard (0 for the alog itself) a variable or source name belongs to */
+	unsigned int DecideShard(const std::string & sName) const;
+
+	/** the record for a key - admitting new names through the wildcard patterns - or NULL */
+	KeyRecord * FindKey(const std::string & sKey);
+
+	/** decide about a name seen for the first time through a wildcard subscription */
+	KeyRecord * HandleWildCardLogging(const std::string & sVar);
+
+	//every key we know about (including the ones we've decided not to log) - built
+	//as variables are registered so each message costs a single hash look up
+	CKeyTable<KeyRecord> m_Keys;
+
+	//bumped whenever the wildcard patterns change so old decisions are made again
+	unsigned int m_nWildCardVersion;
+
+	//set once a wildcard subscription (at full rate) is in place - named variables
+	//then arrive at full rate too so their LOG periods must be kept here
+	bool m_bWildCardSubscribed;
 
 private:
     //this is a collection of file position pointers which we will use
@@ -195,6 +446,7 @@ private:
     //as and when they come in (housekeeping for the header block on
     //slog files)
     std::map< std::string, std::streampos > m_DynamicNameIndex;
+    std::map< std::string, std::streampos > m_BinaryDynamicNameIndex;
     
     // collection of strings which specify names (can use wild card * and ? ) which
     // should be ommited from dynamic logging
@@ -205,6 +457,14 @@ private:
     // should be allowed in dynamic logging. If empty all strings are assumed to be wanted
     // unless they are in m_sDynamicMasked
     std::list< std::string >  m_sWildCardAccepted;
+
+    // the two sets of patterns above compiled for matching
+    CWildcardMatcher m_WildCardOmitMatcher;
+    CWildcardMatcher m_WildCardAcceptMatcher;
+
+    // wildcard variables logged as critical or bulk rather than normal
+    CWildcardMatcher m_WildCardCriticalMatcher;
+    CWildcardMatcher m_WildCardBulkMatcher;
     
 };
 
@@ -0,0 +1,46 @@
+/*
+ *  MonotonicClock.cpp
+ *  MOOS
+ *
+ */
+
+#include "MonotonicClock.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+
+CMonotonicClock::CMonotonicClock()
+{
+	Anchor();
+}
+
+void CMonotonicClock::Anchor()
+{
+	m_dfAnchorMOOS = MOOSTime();
+	m_dfAnchorMono = GetSeconds();
+}
+
+double CMonotonicClock::GetTime() const
+{
+	//MOOSTime() runs faster than real time under a time warp
+	return m_dfAnchorMOOS+(GetSeconds()-m_dfAnchorMono)*GetMOOSTimeWarp();
+}
+
+double CMonotonicClock::GetSeconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER Frequency, Count;
+	::QueryPerformanceFrequency(&Frequency);
+	::QueryPerformanceCounter(&Count);
+	return (double)Count.QuadPart/(double)Frequency.QuadPart;
+#else
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return Now.tv_sec+Now.tv_nsec*1e-9;
+#endif
+}
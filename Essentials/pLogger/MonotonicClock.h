@@ -0,0 +1,45 @@
+/*
+ *  MonotonicClock.h
+ *  MOOS
+ *
+ */
+
+#ifndef CMONOTONICCLOCKH
+#define CMONOTONICCLOCKH
+
+
+/*!
+    @class   CMonotonicClock
+    @abstract    A clock which never steps, lined up with MOOSTime() when it is anchored
+    @discussion  MOOSTime() follows the system clock so an NTP correction or a change of
+				 time zone can make it jump - and a latency measured across the jump is
+				 nonsense. This clock counts from the platform's monotonic clock, scaled by
+				 the MOOS time warp, on from MOOSTime() as it was at Anchor() - so its times
+				 can be compared with the time stamps of messages (warped or not) but only ever
+				 move forwards at a steady rate. Re-anchor if MOOSTime() may have been stepped,
+				 eg on (re)connecting to the DB.
+*/
+
+class CMonotonicClock
+	{
+	public:
+		CMonotonicClock();
+
+		/** line the clock up with MOOSTime() as it is now */
+		void Anchor();
+
+		/** seconds, comparable with (warped) MOOSTime() at the last Anchor() */
+		double GetTime() const;
+
+		/** seconds from an arbitrary (fixed) origin on the platform's monotonic clock */
+		static double GetSeconds();
+
+	protected:
+		/** MOOSTime() at the last Anchor() */
+		double m_dfAnchorMOOS;
+
+		/** GetSeconds() at the last Anchor() */
+		double m_dfAnchorMono;
+	};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ *  ShardIndex.cpp
+ *  MOOS
+ *
+ */
+
+#include "ShardIndex.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+
+
+CShardIndex::CShardIndex()
+{
+	m_bOpen = false;
+}
+
+CShardIndex::~CShardIndex()
+{
+	Close();
+}
+
+bool CShardIndex::IsOpen()
+{
+	return m_bOpen;
+}
+
+bool CShardIndex::Open(const std::string & sIndexFileName, const std::vector<std::string> & Files)
+{
+	if(m_bOpen)
+		Close();
+
+	if(!m_Writer.Start(sIndexFileName))
+		return false;
+
+	std::string sHeader = "%% SHARD INDEX\n";
+	for(size_t i = 0;i<Files.size();i++)
+		sHeader+=MOOSFormat("%%%% SHARD %u %s\n",(unsigned int)i,Files[i].c_str());
+	m_Writer.Push(sHeader);
+
+	m_sLines.clear();
+	m_bOpen = true;
+	return true;
+}
+
+bool CShardIndex::Close()
+{
+	if(!m_bOpen)
+		return true;
+
+	Flush();
+
+	m_bOpen = false;
+	return m_Writer.Stop();
+}
+
+void CShardIndex::AddBatch(unsigned long long nBatch, unsigned int nShard, unsigned long long nOffset, double dfTime)
+{
+	if(!m_bOpen)
+		return;
+
+	m_sLines+=MOOSFormat("B %llu %u %llu %.3f\n",nBatch,nShard,nOffset,dfTime);
+}
+
+void CShardIndex::Flush()
+{
+	if(m_sLines.empty())
+		return;
+
+	m_Writer.Push(m_sLines);
+	m_sLines.clear();
+}
@@ -0,0 +1,69 @@
+/*
+ *  ShardIndex.h
+ *  MOOS
+ *
+ */
+
+#ifndef CSHARDINDEXH
+#define CSHARDINDEXH
+
+#include <string>
+#include <vector>
+#include "LogWriter.h"
+
+
+/*!
+    @class   CShardIndex
+    @abstract    The merged time index (.sidx) of an alog split into shards
+    @discussion  A small text file of a header naming the files
+
+				 %% SHARD n file
+						shard 0 is the alog itself, the rest are the CLogShard files in
+						the order they were configured. A file alongside the index is
+						named alone, one given a directory of its own (LogShard ... @ dir)
+						by its full path. Files compressed once their
+						segment closed (CompressRotated) have since gained the codec's
+						extension
+
+				 followed by a line for every batch of mail and every file it reached
+
+				 B batch shard offset time
+						batch (counting from 0) put entries into shard starting at that
+						(uncompressed) byte offset, the first of them at that time
+
+				 Within a file entries are in the order they arrived. To rebuild the order of
+				 arrival across files take the batches in turn and merge each batch's pieces
+				 by time - mail is sorted by time before it is logged. To seek to a time find
+				 the last B line of each shard before it.
+*/
+
+class CShardIndex
+	{
+	public:
+		CShardIndex();
+		~CShardIndex();
+
+		/*!
+		 @function   Open
+		 @abstract   start a new index of the files named (shard 0 first)
+		 */
+		bool Open(const std::string & sIndexFileName, const std::vector<std::string> & Files);
+
+		/** write anything queued and close the index */
+		bool Close();
+
+		bool IsOpen();
+
+		/** record that a batch put entries into a shard from nOffset on, the first at dfTime */
+		void AddBatch(unsigned long long nBatch, unsigned int nShard, unsigned long long nOffset, double dfTime);
+
+		/** queue what AddBatch() has gathered - once per batch of mail */
+		void Flush();
+
+	protected:
+		bool m_bOpen;
+		std::string m_sLines;
+		CLogWriter m_Writer;
+	};
+
+#endif
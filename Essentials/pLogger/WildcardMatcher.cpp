@@ -0,0 +1,116 @@
+/*
+ *  WildcardMatcher.cpp
+ *  MOOS
+ *
+ */
+
+#include "WildcardMatcher.h"
+
+
+CWildcardMatcher::CWildcardMatcher()
+{
+	Clear();
+}
+
+void CWildcardMatcher::Clear()
+{
+	m_Nodes.clear();
+	m_Nodes.push_back(Node());
+	m_nPatterns = 0;
+}
+
+bool CWildcardMatcher::IsEmpty() const
+{
+	return m_nPatterns==0;
+}
+
+void CWildcardMatcher::Add(const std::string & sPattern)
+{
+	size_t nWild = sPattern.find_first_of("*?");
+	size_t nPrefix = nWild==std::string::npos ? sPattern.size() : nWild;
+
+	//walk (and where need be grow) the trie along the literal prefix
+	size_t nNode = 0;
+	for(size_t i = 0;i<nPrefix;i++)
+	{
+		std::map<char, size_t>::iterator q = m_Nodes[nNode].Children.find(sPattern[i]);
+		if(q!=m_Nodes[nNode].Children.end())
+		{
+			nNode = q->second;
+		}
+		else
+		{
+			m_Nodes.push_back(Node());
+			m_Nodes[nNode].Children[sPattern[i]] = m_Nodes.size()-1;
+			nNode = m_Nodes.size()-1;
+		}
+	}
+
+	if(nWild==std::string::npos)
+		m_Nodes[nNode].bLiteral = true;
+	else
+		m_Nodes[nNode].Globs.push_back(sPattern.substr(nWild));
+
+	m_nPatterns++;
+}
+
+bool CWildcardMatcher::Matches(const std::string & sName) const
+{
+	size_t nNode = 0;
+	for(size_t i = 0;;i++)
+	{
+		const Node & rNode = m_Nodes[nNode];
+
+		//patterns whose literal part is sName[0..i) - does the rest match?
+		for(size_t j = 0;j<rNode.Globs.size();j++)
+		{
+			if(GlobMatch(rNode.Globs[j].c_str(), sName.c_str()+i))
+				return true;
+		}
+
+		if(i==sName.size())
+			return rNode.bLiteral;
+
+		std::map<char, size_t>::const_iterator q = rNode.Children.find(sName[i]);
+		if(q==rNode.Children.end())
+			return false;
+
+		nNode = q->second;
+	}
+}
+
+bool CWildcardMatcher::GlobMatch(const char * pGlob, const char * pName)
+{
+	//on a mismatch go back to the last '*' and let it swallow one more
+	//character - never more than one star's worth of backtracking
+	const char * pStar = NULL;
+	const char * pResume = NULL;
+
+	while(*pName!='\0')
+	{
+		if(*pGlob=='*')
+		{
+			pStar = pGlob++;
+			pResume = pName;
+		}
+		else if(*pGlob=='?' || *pGlob==*pName)
+		{
+			pGlob++;
+			pName++;
+		}
+		else if(pStar!=NULL)
+		{
+			pGlob = pStar+1;
+			pName = ++pResume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while(*pGlob=='*')
+		pGlob++;
+
+	return *pGlob=='\0';
+}
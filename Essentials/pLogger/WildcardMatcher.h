@@ -0,0 +1,69 @@
+/*
+ *  WildcardMatcher.h
+ *  MOOS
+ *
+ */
+
+#ifndef CWILDCARDMATCHERH
+#define CWILDCARDMATCHERH
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/*!
+    @class   CWildcardMatcher
+    @abstract    Does a name match any of a set of wildcard patterns (as MOOSWildCmp)?
+    @discussion  The patterns are compiled once rather than each being tried in turn against
+				 every name. The literal part of each pattern, up to its first '*' or '?', is
+				 put in a trie. Matching walks the name down the trie, so only patterns whose
+				 literal prefix the name actually has are looked at any further - and then only
+				 the rest of the pattern (from the wildcard on) is matched, by a linear glob
+				 matcher. Patterns without wildcards are matched entirely by the trie.
+
+				 '*' matches any run of characters, '?' any single character.
+*/
+
+class CWildcardMatcher
+	{
+	public:
+		CWildcardMatcher();
+
+		/** forget all patterns */
+		void Clear();
+
+		/** add a pattern */
+		void Add(const std::string & sPattern);
+
+		/** true if there are no patterns */
+		bool IsEmpty() const;
+
+		/** does sName match any of the patterns? */
+		bool Matches(const std::string & sName) const;
+
+	protected:
+
+		/** does pName match pGlob (which may contain '*' and '?') */
+		static bool GlobMatch(const char * pGlob, const char * pName);
+
+		struct Node
+		{
+			Node() : bLiteral(false) {}
+
+			//next node for each following character
+			std::map<char, size_t> Children;
+
+			//the remainders (from the first wildcard) of patterns with this literal prefix
+			std::vector<std::string> Globs;
+
+			//a pattern with no wildcards ends here
+			bool bLiteral;
+		};
+
+		//m_Nodes[0] is the root (the empty prefix)
+		std::vector<Node> m_Nodes;
+		size_t m_nPatterns;
+	};
+
+#endif
@@ -8,12 +8,24 @@
  */
 
 #include "Zipper.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
-#ifdef ZLIB_FOUND
-#define ZIP_FLUSH_SIZE 2048
-#include <zlib.h>
-#endif
+//how often (bytes of input) an indexed stream gets a point readers can start from
+#define ZIP_RESTART_INTERVAL (1024*1024)
+
+//the zipping thread is woken as soon as this much is queued...
+#define ZIP_WAKE_SIZE (64*1024)
+//...and in any case this often (ms) so nothing waits long to be compressed
+#define ZIP_MAX_LATENCY_MS 250
+//default bound on data waiting to be compressed
+#define ZIP_DEFAULT_QUEUE_LIMIT (64*1024*1024)
+//default size of independently compressed blocks
+#define ZIP_DEFAULT_BLOCK_SIZE (1024*1024)
+//a part filled block is compressed anyway once it is this old (seconds)
+#define ZIP_BLOCK_MAX_AGE 1.0
 
 
 bool _ZipThreadWorker(void * pParam)
@@ -22,16 +34,159 @@ bool _ZipThreadWorker(void * pParam)
 	return pMe->DoZipLogging();
 }
 
+bool _ZipBlockWorker(void * pParam)
+{
+	CZipper* pMe = (CZipper*) pParam;
+	return pMe->DoBlockCompression();
+}
+
+CZipper::CZipper()
+{
+	//gzip unless told otherwise - NULL if zlib wasn't found
+	m_pCodec = CLogCodec::Create("gzip");
+	m_pIndex = NULL;
+	m_nQueuedBytes = 0;
+	m_nInFlightBytes = 0;
+	m_nQueueLimit = ZIP_DEFAULT_QUEUE_LIMIT;
+	m_eOverflowPolicy = BLOCK;
+	m_nDroppedBytes = 0;
+	m_nDroppedMessages = 0;
+	m_nSpilledBytes = 0;
+	m_nBytesIn = 0;
+	m_nBytesOut = 0;
+	m_nThreads = 1;
+	m_nBlockSize = ZIP_DEFAULT_BLOCK_SIZE;
+	m_bMembers = false;
+	m_pMemberIndex = NULL;
+	m_bWorkersQuit = false;
+	m_nCompressedOffset = 0;
+}
+
+CZipper::~CZipper()
+{
+	Stop();
+	delete m_pCodec;
+}
+
+bool CZipper::SetCodec(const std::string & sSpecification)
+{
+	CLogCodec * pCodec = CLogCodec::Create(sSpecification);
+	if(pCodec==NULL)
+		return false;
+
+	delete m_pCodec;
+	m_pCodec = pCodec;
+	return true;
+}
+
+bool CZipper::HasCodec()
+{
+	return m_pCodec!=NULL;
+}
+
+std::string CZipper::GetCodecName() const
+{
+	if(m_pCodec==NULL)
+		return "none";
+
+	//the default level is negative, which Create() wouldn't parse back
+	if(m_pCodec->GetLevel()<0)
+		return m_pCodec->GetName();
+	return MOOSFormat("%s:%d",m_pCodec->GetName().c_str(),m_pCodec->GetLevel());
+}
+
+std::string CZipper::GetExtension()
+{
+	if(m_pCodec==NULL)
+		return "";
+	return m_pCodec->GetExtension();
+}
+
+void CZipper::SetThreads(unsigned int nThreads)
+{
+	m_nThreads = nThreads>0 ? nThreads : 1;
+}
+
+void CZipper::SetBlockSize(size_t nBytes)
+{
+	m_nBlockSize = nBytes>0 ? nBytes : ZIP_DEFAULT_BLOCK_SIZE;
+}
+
+void CZipper::SetMemberSize(size_t nBytes)
+{
+	m_bMembers = nBytes>0;
+	if(m_bMembers)
+		m_nBlockSize = nBytes;
+}
+
+void CZipper::CopySettings(const CZipper & Other)
+{
+	if(Other.m_pCodec!=NULL)
+		SetCodec(Other.GetCodecName());
+
+	m_nThreads = Other.m_nThreads;
+	m_nBlockSize = Other.m_nBlockSize;
+	m_bMembers = Other.m_bMembers;
+	m_nQueueLimit = Other.m_nQueueLimit;
+	m_eOverflowPolicy = Other.m_eOverflowPolicy;
+	m_Durability.SetPolicy(Other.m_Durability);
+}
+
+void CZipper::SetIndex(CAlogIndex * pIndex)
+{
+	m_pIndex = pIndex;
+}
+
+void CZipper::SetQueueLimit(size_t nBytes)
+{
+	m_nQueueLimit = nBytes;
+}
+
+void CZipper::SetOverflowPolicy(OverflowPolicy ePolicy)
+{
+	m_eOverflowPolicy = ePolicy;
+}
+
 bool CZipper::Start(const std::string sFileBaseName)
 {
+	if(m_pCodec==NULL)
+		return false;
+
 	m_sFileName = sFileBaseName;
+
+	m_Lock.Lock();
+	m_nInFlightBytes = 0;
+	m_nDroppedBytes = 0;
+	m_nSpilledBytes = 0;
+	m_nBytesIn = 0;
+	m_nBytesOut = 0;
+	m_Lock.UnLock();
+
+	m_Durability.Reset(MOOSTime());
+
 	m_Thread.Initialise(_ZipThreadWorker, this);
 	return m_Thread.Start();
 }
 
 bool CZipper::Stop()
 {
-	return m_Thread.Stop();
+	//wake the thread so it notices promptly
+	m_WorkSignal.Set();
+	bool bOK = m_Thread.Stop();
+
+	m_SpillWriter.Stop();
+
+	return bOK;
+}
+
+void CZipper::SetDurability(const CLogDurability & Policy)
+{
+	m_Durability.SetPolicy(Policy);
+}
+
+double CZipper::GetDurableTime()
+{
+	return m_Durability.GetDurableTime();
 }
 
 bool CZipper::IsRunning()
@@ -39,95 +194,552 @@ bool CZipper::IsRunning()
 	return m_Thread.IsThreadRunning();
 }
 
-bool CZipper::Push(const std::string & sStr)
+size_t CZipper::GetQueueDepth()
+{
+	m_Lock.Lock();
+	size_t nDepth = m_nQueuedBytes+m_nInFlightBytes;
+	m_Lock.UnLock();
+	return nDepth;
+}
+
+size_t CZipper::GetQueueLimit()
+{
+	return m_nQueueLimit;
+}
+
+unsigned long long CZipper::GetDroppedBytes()
 {
-	if(sStr.size()!=0)
+	m_Lock.Lock();
+	unsigned long long nDropped = m_nDroppedBytes;
+	m_Lock.UnLock();
+	return nDropped;
+}
+
+unsigned long long CZipper::GetDroppedMessages()
+{
+	m_Lock.Lock();
+	unsigned long long nDropped = m_nDroppedMessages;
+	m_Lock.UnLock();
+	return nDropped;
+}
+
+double CZipper::GetCompressionRatio()
+{
+	m_Lock.Lock();
+	double dfRatio = m_nBytesOut>0 ? (double)m_nBytesIn/m_nBytesOut : 0.0;
+	m_Lock.UnLock();
+	return dfRatio;
+}
+
+CLatencyHistogram & CZipper::GetWriteLatency()
+{
+	return m_WriteLatency;
+}
+
+unsigned long long CZipper::GetSpilledBytes()
+{
+	m_Lock.Lock();
+	unsigned long long nSpilled = m_nSpilledBytes;
+	m_Lock.UnLock();
+	return nSpilled;
+}
+
+bool CZipper::MakeRoom(size_t nBytes, bool bKeep)
+{
+	//before we start (eg the banner) there is nobody to drain the queue
+	if(!IsRunning())
+		return true;
+
+	while(m_nQueuedBytes+m_nInFlightBytes>0 && m_nQueuedBytes+m_nInFlightBytes+nBytes>m_nQueueLimit)
 	{
-		m_Lock.Lock();
-		m_ZipBuffer.push_back(sStr);
+		//what is already being compressed can't be dropped - wait for it whatever the policy
+		OverflowPolicy ePolicy = (m_ZipBuffer.empty() || bKeep) ? BLOCK : m_eOverflowPolicy;
+		switch(ePolicy)
+		{
+			case BLOCK:
+				m_Lock.UnLock();
+				m_WorkSignal.Set();
+				m_SpaceSignal.Wait(ZIP_MAX_LATENCY_MS);
+				m_Lock.Lock();
+				if(!IsRunning())
+					return true;
+				break;
+
+			case DROP_OLDEST:
+				m_nQueuedBytes-=m_ZipBuffer.front().size();
+				m_nDroppedBytes+=m_ZipBuffer.front().size();
+				m_nDroppedMessages+=std::count(m_ZipBuffer.front().begin(),m_ZipBuffer.front().end(),'\n');
+				m_ZipBuffer.pop_front();
+				break;
+
+			case SPILL:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool CZipper::Push(const std::string & sStr, bool bKeep)
+{
+	if(sStr.size()==0)
+		return true;
+
+	m_Lock.Lock();
+
+	if(!MakeRoom(sStr.size(),bKeep))
+	{
+		//no room - this goes uncompressed to the side file instead
+		m_nSpilledBytes+=sStr.size();
 		m_Lock.UnLock();
+
+		if(!m_SpillWriter.IsRunning() && !m_SpillWriter.Start(m_sFileName+".spill"))
+		{
+			std::cerr<<"failed to open spill file "<<m_sFileName<<".spill\n";
+			return false;
+		}
+		return m_SpillWriter.Push(sStr);
 	}
+
+	m_ZipBuffer.push_back(sStr);
+	m_nQueuedBytes+=sStr.size();
+	bool bWake = m_nQueuedBytes>=ZIP_WAKE_SIZE;
+
+	m_Lock.UnLock();
+
+	if(bWake)
+		m_WorkSignal.Set();
+
 	return true;
 }
 
 
+bool CZipper::TakeQueued(std::list<std::string> & Work)
+{
+	m_Lock.Lock();
+	{
+		Work.splice(Work.end(),m_ZipBuffer);
+		m_nInFlightBytes+=m_nQueuedBytes;
+		m_nQueuedBytes = 0;
+	}
+	m_Lock.UnLock();
+
+	return !Work.empty();
+}
+
+void CZipper::Done(size_t nBytes)
+{
+	m_Lock.Lock();
+	m_nInFlightBytes-=std::min(nBytes,m_nInFlightBytes);
+	m_Lock.UnLock();
+
+	m_SpaceSignal.Set();
+}
+
 bool CZipper::DoZipLogging()
 {
-#ifdef ZLIB_FOUND
-	
-	std::string sZipFile = m_sFileName+".gz";
-	gzFile TheZipFile =  gzopen(sZipFile.c_str(),"wb");
-	
-	
-	
-	int nTotalWritten = 0;
-	int nSinceLastFlush = 0;
-	while(!m_Thread.IsQuitRequested())
+	bool bOK = (m_nThreads>1 || m_bMembers) ? DoBlockZipping() : DoStreamZipping();
+
+	m_Durability.Closed();
+	return bOK;
+}
+
+bool CZipper::DoStreamZipping()
+{
+	std::string sZipFile = m_sFileName+m_pCodec->GetExtension();
+	if(!m_pCodec->Open(sZipFile))
+	{
+		std::cerr<<"failed to open "<<sZipFile<<"\n";
+		return false;
+	}
+
+	unsigned long long nTotalWritten = 0;
+	unsigned long long nSinceLastRestart = 0;
+	bool bQuit = false;
+	while(!bQuit)
 	{
-		MOOSPause(1000);
+		//sleep until enough is queued or the latency limit is up - once asked
+		//to quit we go round one last time to drain whatever is left
+		bQuit = m_Thread.IsQuitRequested();
+		if(!bQuit)
+			m_WorkSignal.Wait(m_Durability.GetWaitMS(ZIP_MAX_LATENCY_MS));
 		
+		//everything pushed before now is in this batch
+		double dfQueuedBefore = MOOSTime();
+
 		std::list<std::string > Work;
-		Work.clear();
-		
-		m_Lock.Lock();
+		if(!TakeQueued(Work))
 		{
-			Work.splice(Work.begin(),m_ZipBuffer);
+			m_Durability.Written(0, dfQueuedBefore);
+			continue;
 		}
-		m_Lock.UnLock();
-		
 		
+		//the codec compresses as it writes so this isn't timed - only commits are
+		unsigned long long nBatch = 0;
 		std::list<std::string >::iterator q;
-		
 		for(q = Work.begin();q!=Work.end();q++)
 		{
-			int nWritten = gzwrite(TheZipFile, q->c_str(), q->size() );
-			
-			if(nWritten<=0)
-			{	
-				int Error;
-				gzerror(TheZipFile, &Error);
-				switch(Error)
-				{
-					case Z_ERRNO:
-						std::cerr<<"Z_ERRNO\n";
-						break;
-					case Z_STREAM_ERROR	:
-						std::cerr<<"Z_STREAM_ERROR\n";
-						break;
-					case Z_BUF_ERROR:
-						std::cerr<<"Z_BUF_ERROR\n";
-						break;
-					case Z_MEM_ERROR:
-						std::cerr<<"Z_MEM_ERROR\n";
-						break;
-				}
+			bool bWritten = m_pCodec->Write(q->data(), q->size());
+			Done(q->size());
+			if(!bWritten)
+			{
+				std::cerr<<"failed writing to "<<sZipFile<<"\n";
+				continue;
 			}
-			else
+
+			nBatch+=q->size();
+			nTotalWritten+=q->size();
+			nSinceLastRestart+=q->size();
+
+			unsigned long long nCompressedOffset;
+			if(m_pIndex!=NULL && nSinceLastRestart>ZIP_RESTART_INTERVAL && m_pCodec->Restart(nCompressedOffset))
 			{
-				nTotalWritten+=nWritten;
-				nSinceLastFlush+=nWritten;
-				
-				if(nSinceLastFlush>ZIP_FLUSH_SIZE)
-				{	
-					gzflush(TheZipFile, Z_SYNC_FLUSH);
-					nSinceLastFlush = 0;
-				}
-				
+				if(m_pCodec->StartsMember())
+					m_pIndex->AddMemberStart(nTotalWritten, nCompressedOffset);
+				else
+					m_pIndex->AddRestartPoint(nTotalWritten, nCompressedOffset);
+				nSinceLastRestart = 0;
 			}
 		}
-		Work.clear();
-		
-		
-		
-		
+
+		m_Durability.Written(nBatch, dfQueuedBefore);
+
+		m_Lock.Lock();
+		m_nBytesIn = nTotalWritten;
+		m_nBytesOut = m_pCodec->GetCompressedSize();
+		m_Lock.UnLock();
+
+		//a flush costs compression ratio (and a sync much more) so one covers many batches
+		if(m_Durability.IsCommitDue(MOOSTime()))
+			CommitStream();
 	}
-	gzflush(TheZipFile, Z_SYNC_FLUSH);
-	gzflush(TheZipFile, Z_FINISH);
-	gzclose(TheZipFile);
+
+	if(m_Durability.GetMode()!=CLogDurability::NONE)
+		CommitStream();
+
+	m_pCodec->Close();
 	MOOSTrace("closed compressed  file %s \n",sZipFile.c_str());
 	
-#endif
 	return true;
-	
 }
 
+
+bool CZipper::DoBlockZipping()
+{
+	std::string sZipFile = m_sFileName+m_pCodec->GetExtension();
+	FILE * pFile = fopen(sZipFile.c_str(),"wb");
+	if(pFile==NULL)
+	{
+		std::cerr<<"failed to open "<<sZipFile<<"\n";
+		return false;
+	}
+
+	//the member index names the file it indexes (without its directory)
+	std::string sMemberIndex = m_sFileName+".zidx";
+	m_sMemberLines.clear();
+	m_pMemberIndex = fopen(sMemberIndex.c_str(),"w");
+	if(m_pMemberIndex==NULL)
+		std::cerr<<"failed to open member index "<<sMemberIndex<<"\n";
+	else
+		fprintf(m_pMemberIndex,"%%%% MEMBER INDEX %s\n",sZipFile.substr(sZipFile.find_last_of("/\\")+1).c_str());
+
+	//start the pool of compressing threads
+	m_bWorkersQuit = false;
+	m_nCompressedOffset = 0;
+	for(unsigned int i = 0;i<m_nThreads;i++)
+	{
+		CMOOSThread * pWorker = new CMOOSThread;
+		pWorker->Initialise(_ZipBlockWorker, this);
+		pWorker->Start();
+		m_Workers.push_back(pWorker);
+	}
+
+	unsigned long long nOffset = 0;
+	Block * pBlock = NULL;
+	double dfBlockStarted = 0;
+	double dfPreviousTake = MOOSTime();
+
+	bool bQuit = false;
+	while(!bQuit)
+	{
+		bQuit = m_Thread.IsQuitRequested();
+		if(!bQuit)
+			m_WorkSignal.Wait(m_Durability.GetWaitMS(ZIP_MAX_LATENCY_MS));
+
+		//everything pushed before now is in this take
+		double dfTake = MOOSTime();
+
+		std::list<std::string > Work;
+		TakeQueued(Work);
+
+		//gather whole pushes (so blocks end on line boundaries) into blocks
+		std::list<std::string >::iterator q;
+		for(q = Work.begin();q!=Work.end();q++)
+		{
+			if(pBlock==NULL)
+			{
+				pBlock = new Block;
+				pBlock->Input.reserve(m_nBlockSize+q->size());
+				pBlock->bDone = false;
+				pBlock->nOffset = nOffset;
+				dfBlockStarted = MOOSLocalTime();
+			}
+
+			pBlock->Input.append(*q);
+			nOffset+=q->size();
+
+			if(pBlock->Input.size()>=m_nBlockSize)
+			{
+				//a block ending part way through a take only completes the takes before it
+				std::list<std::string >::iterator r = q;
+				pBlock->dfQueuedBefore = ++r==Work.end() ? dfTake : dfPreviousTake;
+				DispatchBlock(pBlock, pFile);
+				pBlock = NULL;
+			}
+		}
+		dfPreviousTake = dfTake;
+
+		//don't let a trickle of data sit uncompressed for ever
+		if(pBlock!=NULL && (bQuit || MOOSLocalTime()-dfBlockStarted>ZIP_BLOCK_MAX_AGE))
+		{
+			pBlock->dfQueuedBefore = dfTake;
+			DispatchBlock(pBlock, pFile);
+			pBlock = NULL;
+		}
+
+		WriteFinishedBlocks(pFile, m_nThreads*2);
+
+		//nothing held back anywhere - all that was pushed has been written
+		if(pBlock==NULL && m_BlocksInFlight.empty())
+			m_Durability.Written(0, dfTake);
+
+		if(m_Durability.IsCommitDue(MOOSTime()))
+			CommitBlocks(pFile);
+	}
+
+	//wait for and write everything still in flight
+	WriteFinishedBlocks(pFile, 0);
+	if(m_Durability.GetMode()!=CLogDurability::NONE)
+		CommitBlocks(pFile);
+
+	m_BlockLock.Lock();
+	m_bWorkersQuit = true;
+	m_BlockLock.UnLock();
+
+	for(unsigned int i = 0;i<m_Workers.size();i++)
+	{
+		m_BlockSignal.Set();
+		m_Workers[i]->Stop();
+		delete m_Workers[i];
+	}
+	m_Workers.clear();
+
+	bool bClosed = fclose(pFile)==0;
+	if(m_pMemberIndex!=NULL)
+	{
+		if(bClosed)
+			FlushMemberIndex();
+		fclose(m_pMemberIndex);
+		m_pMemberIndex = NULL;
+	}
+	MOOSTrace("closed compressed  file %s \n",sZipFile.c_str());
+
+	return true;
+}
+
+void CZipper::DispatchBlock(Block * pBlock, FILE * pFile)
+{
+	//bound the work (and memory) in flight
+	WriteFinishedBlocks(pFile, m_nThreads*2-1);
+
+	m_BlocksInFlight.push_back(pBlock);
+
+	m_BlockLock.Lock();
+	m_BlocksToCompress.push_back(pBlock);
+	m_BlockLock.UnLock();
+
+	m_BlockSignal.Set();
+}
+
+void CZipper::WriteFinishedBlocks(FILE * pFile, size_t nMaxInFlight)
+{
+	while(!m_BlocksInFlight.empty())
+	{
+		Block * pBlock = m_BlocksInFlight.front();
+
+		m_BlockLock.Lock();
+		bool bDone = pBlock->bDone;
+		m_BlockLock.UnLock();
+
+		if(!bDone)
+		{
+			//blocks must be written in order so we can only wait for the oldest
+			if(m_BlocksInFlight.size()<=nMaxInFlight)
+				break;
+
+			m_BlockDoneSignal.Wait(ZIP_MAX_LATENCY_MS);
+			continue;
+		}
+
+		double dfStart = MOOSLocalTime();
+		size_t nWritten = fwrite(pBlock->Output.data(), 1, pBlock->Output.size(), pFile);
+		m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+		Done(pBlock->Input.size());
+
+		if(nWritten!=pBlock->Output.size())
+		{
+			//lost - it is in neither index and isn't durable. Whatever part of it did
+			//go out still moves the members after it along
+			std::cerr<<"failed writing compressed block to "<<m_sFileName<<m_pCodec->GetExtension()<<"\n";
+			m_nCompressedOffset+=nWritten;
+
+			m_Lock.Lock();
+			m_nDroppedBytes+=pBlock->Input.size();
+			m_nDroppedMessages+=std::count(pBlock->Input.begin(),pBlock->Input.end(),'\n');
+			m_Lock.UnLock();
+
+			m_BlocksInFlight.pop_front();
+			delete pBlock;
+			continue;
+		}
+
+		//listed only now it is written (the .zidx once it is flushed too)
+		if(m_pIndex!=NULL)
+			m_pIndex->AddMemberStart(pBlock->nOffset, m_nCompressedOffset);
+		if(m_pMemberIndex!=NULL)
+		{
+			m_sMemberLines+=MOOSFormat("M %llu %llu %llu %.3f %.3f\n",pBlock->nOffset,m_nCompressedOffset,
+				(unsigned long long)pBlock->Output.size(),pBlock->dfFirstTime,pBlock->dfLastTime);
+		}
+		m_nCompressedOffset+=pBlock->Output.size();
+
+		m_Lock.Lock();
+		m_nBytesIn+=pBlock->Input.size();
+		m_nBytesOut+=pBlock->Output.size();
+		m_Lock.UnLock();
+		m_Durability.Written(pBlock->Output.size(), pBlock->dfQueuedBefore);
+
+		m_BlocksInFlight.pop_front();
+		delete pBlock;
+	}
+}
+
+bool CZipper::CommitBlocks(FILE * pFile)
+{
+	double dfStart = MOOSLocalTime();
+	bool bOK = fflush(pFile)==0;
+	if(bOK && m_Durability.GetMode()==CLogDurability::SYNC)
+		bOK = CLogDurability::SyncFile(fileno(pFile));
+
+	//after the data so what it lists is there - it is never synced as a lost
+	//tail can be rebuilt by walking the members
+	if(bOK)
+		FlushMemberIndex();
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+
+	if(!bOK)
+	{
+		std::cerr<<"failed committing "<<m_sFileName<<m_pCodec->GetExtension()<<"\n";
+		return false;
+	}
+
+	m_Durability.Committed(MOOSTime());
+	return true;
+}
+
+void CZipper::FlushMemberIndex()
+{
+	if(m_pMemberIndex==NULL || m_sMemberLines.empty())
+		return;
+
+	fwrite(m_sMemberLines.data(), 1, m_sMemberLines.size(), m_pMemberIndex);
+	fflush(m_pMemberIndex);
+	m_sMemberLines.clear();
+}
+
+bool CZipper::CommitStream()
+{
+	double dfStart = MOOSLocalTime();
+	bool bOK = m_Durability.GetMode()==CLogDurability::SYNC ? m_pCodec->Sync() : m_pCodec->Flush();
+	m_WriteLatency.Add(MOOSLocalTime()-dfStart);
+	if(!bOK)
+	{
+		std::cerr<<"failed committing "<<m_sFileName<<m_pCodec->GetExtension()<<"\n";
+		return false;
+	}
+
+	m_Durability.Committed(MOOSTime());
+	return true;
+}
+
+bool CZipper::DoBlockCompression()
+{
+	for(;;)
+	{
+		Block * pBlock = NULL;
+
+		m_BlockLock.Lock();
+		bool bQuit = m_bWorkersQuit;
+		if(!m_BlocksToCompress.empty())
+		{
+			pBlock = m_BlocksToCompress.front();
+			m_BlocksToCompress.pop_front();
+		}
+		bool bMore = !m_BlocksToCompress.empty();
+		m_BlockLock.UnLock();
+
+		if(pBlock==NULL)
+		{
+			if(bQuit)
+				break;
+
+			m_BlockSignal.Wait(ZIP_MAX_LATENCY_MS);
+			continue;
+		}
+
+		//pass the wake up on to another worker
+		if(bMore)
+			m_BlockSignal.Set();
+
+		if(!m_pCodec->CompressBlock(pBlock->Input, pBlock->Output))
+			std::cerr<<"failed to compress block for "<<m_sFileName<<"\n";
+		GetTimeRange(pBlock->Input, pBlock->dfFirstTime, pBlock->dfLastTime);
+
+		m_BlockLock.Lock();
+		pBlock->bDone = true;
+		m_BlockLock.UnLock();
+
+		m_BlockDoneSignal.Set();
+	}
+
+	return true;
+}
+
+void CZipper::GetTimeRange(const std::string & Input, double & dfFirstTime, double & dfLastTime)
+{
+	dfFirstTime = -1;
+	dfLastTime = -1;
+
+	//blocks end on line boundaries and every entry starts with its time - only
+	//the banner (lines starting %%) doesn't
+	size_t nLine = 0;
+	while(nLine<Input.size() && Input[nLine]=='%')
+	{
+		nLine = Input.find('\n',nLine);
+		if(nLine==std::string::npos)
+			return;
+		nLine++;
+	}
+	if(nLine>=Input.size())
+		return;
+
+	dfFirstTime = atof(Input.c_str()+nLine);
+
+	//the start of the last line
+	size_t nEnd = Input.size()-1;
+	if(Input[nEnd]=='\n' && nEnd>0)
+		nEnd--;
+	size_t nLast = Input.rfind('\n',nEnd);
+	nLast = nLast==std::string::npos || nLast<nLine ? nLine : nLast+1;
+	dfLastTime = atof(Input.c_str()+nLast);
+}
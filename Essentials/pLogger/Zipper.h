@@ -11,23 +11,78 @@
 #define CZIPPERH
 
 #include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include <cstdio>
+#include <list>
 #include <string>
+#include <vector>
+#include "AlogIndex.h"
+#include "LogCodec.h"
+#include "LogSignal.h"
+#include "LogWriter.h"
+#include "LogDurability.h"
+#include "LatencyHistogram.h"
 
 
 /*!
     @class   CZipper
     @abstract    Lauches a thread to write strings to a compressed (zipped file)
-    @discussion  Uses the zlib library to write strings to file. Compressions is done in a background thread
+    @discussion  Writes strings to file through a CLogCodec - gzip by default, zstd or lz4 if they
+				 were found at build time. Compressions is done in a background thread
+				 which is woken when enough data is queued or, at the latest, after a short fixed
+				 latency. The queue is bounded, what happens when it is full is set by the
+				 overflow policy - except for data pushed with bKeep (eg critical entries)
+				 which always waits for room.
+
+				 By default one thread compresses a single gzip stream. With more than one
+				 thread the data is cut into blocks (on line boundaries) which a pool of workers compress
+				 as independent members (gzip members, zstd or lz4 frames), written in order. A
+				 sequence of members is still a valid file but compression speed now scales with cores.
+
+				 SetMemberSize() asks for members even with one thread. Each member carries its own
+				 check (the gzip CRC, the zstd or lz4 content checksum) so a file cut short by a crash
+				 or power loss loses at most its last member - everything before it decompresses with
+				 the usual tools.
+
+				 Whenever members are written a sidecar member index (sFileBaseName.zidx e.g
+				 mission.alog.zidx) is kept, a line for each member as it is written
+
+				 M offset compressed-offset compressed-bytes first-time last-time
+						the member at compressed-offset holds the input from offset on, and the
+						first and last alog entries in it have those times (-1 if it has none)
+
+				 so readers can seek by time or decompress members in parallel. A member is only
+				 listed once it has been written and flushed to the file (the lines are held back
+				 until the file is committed or closed) so the index never points past the data,
+				 and a member which failed to be written is never listed at all.
+
+				 When the compressed file is flushed (so a reader can decode everything written so
+				 far) or synced to the disk is set by a CLogDurability policy.
 */
 
 class CZipper
 	{
 	public:
-		
+		CZipper();
+		~CZipper();
+
+		/*!
+		 @enum OverflowPolicy
+		 @abstract what Push() does when the queue is at its limit
+		 @constant BLOCK wait for the zipping thread to make room (nothing is lost)
+		 @constant DROP_OLDEST discard the oldest queued data to make room
+		 @constant SPILL write the new data uncompressed to a side file (<name>.spill)
+		 */
+		enum OverflowPolicy
+		{
+			BLOCK,
+			DROP_OLDEST,
+			SPILL
+		};
+
 		/*!
 		 @function     Start
 		 @abstract   Start the zipper specifying name of file. 
-		 @discussion Start the zipper specifying name of file, a .gz will be added
+		 @discussion Start the zipper specifying name of file, the codec's extension will be added
 		 @param	sFileNameBase  the base name of the compressed file. e.g t.txt will become t.txt.gz
 		 */
 		bool Start(const std::string sFileBaseName);
@@ -52,21 +107,222 @@ class CZipper
 		 @abstract   Push a string onto the 
 		 @discussion Add a string to teh background threads work. This will eventually be added
 		 @param sStr  the string which should be ashoved into the compressed file
+		 @param bKeep wait for room rather than drop or spill anything, whatever the policy
 		 */		
-		bool Push(const std::string & sStr);
+		bool Push(const std::string & sStr, bool bKeep = false);
+
+		/*!
+		 @function   SetIndex
+		 @abstract   Record decompression restart points in an alog index
+		 @discussion When set the stream is fully flushed every so often and the compressed and
+					 uncompressed offsets of that point are added to the index so readers can
+					 start decompressing there. Set before Start(), pass NULL to turn off
+		 */
+		void SetIndex(CAlogIndex * pIndex);
+
+		/*!
+		 @function   SetQueueLimit
+		 @abstract   Set the most data (bytes) which may be waiting to be compressed
+		 */
+		void SetQueueLimit(size_t nBytes);
+
+		/*!
+		 @function   SetOverflowPolicy
+		 @abstract   Set what happens to pushed data when the queue is full
+		 */
+		void SetOverflowPolicy(OverflowPolicy ePolicy);
+
+		/*!
+		 @function   SetCodec
+		 @abstract   Choose the compression format as "codec[:level]" e.g "zstd:3", "lz4" or "gzip:6"
+		 @discussion Set before Start(). Returns false (and keeps the current codec) if the
+					 codec is unknown or was not built in
+		 */
+		bool SetCodec(const std::string & sSpecification);
+
+		/** false if there is no codec at all (no compression libraries were found) */
+		bool HasCodec();
+
+		/** e.g "zstd:3", or just "gzip" at the codec's default level - fit to pass to SetCodec() */
+		std::string GetCodecName() const;
+
+		/** the extension added to compressed file names e.g ".gz" */
+		std::string GetExtension();
+
+		/*!
+		 @function   SetThreads
+		 @abstract   How many threads compress - more than one selects block parallel compression
+		 @discussion Set before Start()
+		 */
+		void SetThreads(unsigned int nThreads);
+
+		/*!
+		 @function   SetBlockSize
+		 @abstract   How many bytes of input make up one independently compressed block
+		 @discussion Only used for block parallel compression. Set before Start()
+		 */
+		void SetBlockSize(size_t nBytes);
+
+		/*!
+		 @function   SetMemberSize
+		 @abstract   Write independent members of (about) nBytes of input, with a member index
+		 @discussion However many threads compress. 0 for a single stream (with one thread).
+					 A member is also ended once its first line is ZIP_BLOCK_MAX_AGE old.
+					 Set before Start()
+		 */
+		void SetMemberSize(size_t nBytes);
+
+		/** take the codec, threading, queue and durability settings of another zipper, set before Start() */
+		void CopySettings(const CZipper & Other);
+
+		/** when the zipping thread flushes or syncs the compressed file, set before Start() */
+		void SetDurability(const CLogDurability & Policy);
+
+		/** the time before which everything pushed is committed (see CLogDurability) */
+		double GetDurableTime();
+
+		/*!
+		 @function   GetQueueDepth
+		 @abstract   how many bytes are waiting to be compressed
+		 @discussion includes what the zipping thread has taken but not yet compressed (or,
+					 with blocks, written) - all of it counts towards the queue limit
+		 */
+		size_t GetQueueDepth();
+
+		/** the most bytes which may wait to be compressed (see SetQueueLimit) */
+		size_t GetQueueLimit();
+
+		/*!
+		 @function   GetDroppedBytes
+		 @abstract   how many bytes have been discarded because the queue was full
+		 */
+		unsigned long long GetDroppedBytes();
+
+		/*!
+		 @function   GetDroppedMessages
+		 @abstract   how many log lines have been discarded because the queue was full
+		 @discussion counts for the life of the zipper, not just the current file
+		 */
+		unsigned long long GetDroppedMessages();
+
+		/*!
+		 @function   GetCompressionRatio
+		 @abstract   bytes in over bytes out for the current file so far, 0 before anything is written
+		 */
+		double GetCompressionRatio();
+
+		/** how long each write (block mode) and commit of compressed data took - not the compressing */
+		CLatencyHistogram & GetWriteLatency();
+
+		/*!
+		 @function   GetSpilledBytes
+		 @abstract   how many bytes have been written to the spill file because the queue was full
+		 */
+		unsigned long long GetSpilledBytes();
 
 
 		//worker function
 		bool DoZipLogging();
+
+		//block compression worker function
+		bool DoBlockCompression();
 		
 	protected:
 
+		/** make room for nBytes according to the overflow policy (BLOCK if bKeep, call locked), false if they should not be queued */
+		bool MakeRoom(size_t nBytes, bool bKeep);
+
+		/** take everything queued by Push() (it stays in flight until Done()), returns false if there was nothing */
+		bool TakeQueued(std::list<std::string> & Work);
+
+		/** nBytes taken by TakeQueued() are compressed and written - the room they took is free */
+		void Done(size_t nBytes);
+
+		/** one gzip stream written by this thread */
+		bool DoStreamZipping();
+
+		/** independent members compressed by a pool of workers */
+		bool DoBlockZipping();
+
+		/** a block of input and, once a worker has been at it, its compressed form */
+		struct Block
+		{
+			std::string Input;
+			std::string Output;
+			bool bDone;
+			unsigned long long nOffset;
+			//everything pushed before this is in this or an earlier block
+			double dfQueuedBefore;
+			//the times of the first and last alog entries in it (-1 if none)
+			double dfFirstTime;
+			double dfLastTime;
+		};
+
+		/** the times of the first and last entries of some alog text (-1 if there are none) */
+		static void GetTimeRange(const std::string & Input, double & dfFirstTime, double & dfLastTime);
+
+		/** hand a block to the workers (waiting if too many are in flight) */
+		void DispatchBlock(Block * pBlock, FILE * pFile);
+
+		/** write finished blocks in order, waiting while more than nMaxInFlight are unwritten */
+		void WriteFinishedBlocks(FILE * pFile, size_t nMaxInFlight);
+
+		/** flush or sync the block file as the durability policy says */
+		bool CommitBlocks(FILE * pFile);
+
+		/** write out the .zidx lines held back - only once the data they list has been flushed */
+		void FlushMemberIndex();
+
+		/** flush or sync the codec's stream as the durability policy says */
+		bool CommitStream();
+
 		CMOOSLock   m_Lock;
 		CMOOSThread m_Thread;
 		
+		//set when there is enough work to be worth waking for / when there is space
+		CLogSignal m_WorkSignal;
+		CLogSignal m_SpaceSignal;
 		
 		std::list<std::string> m_ZipBuffer;
+		size_t m_nQueuedBytes;
+		size_t m_nInFlightBytes;
+		size_t m_nQueueLimit;
+		OverflowPolicy m_eOverflowPolicy;
+
+		unsigned long long m_nDroppedBytes;
+		unsigned long long m_nDroppedMessages;
+		unsigned long long m_nSpilledBytes;
+
+		//uncompressed and compressed bytes written to the current file
+		unsigned long long m_nBytesIn;
+		unsigned long long m_nBytesOut;
+
+		CLatencyHistogram m_WriteLatency;
+		CLogWriter m_SpillWriter;
+
 		std::string m_sFileName;
+
+		CAlogIndex * m_pIndex;
+
+		CLogCodec * m_pCodec;
+		CLogDurability m_Durability;
+
+		//block parallel compression
+		unsigned int m_nThreads;
+		size_t m_nBlockSize;
+		bool m_bMembers;
+		FILE * m_pMemberIndex;
+
+		//.zidx lines of members written to the file but not yet flushed from it
+		std::string m_sMemberLines;
+		std::vector<CMOOSThread*> m_Workers;
+		CMOOSLock m_BlockLock;
+		CLogSignal m_BlockSignal;
+		CLogSignal m_BlockDoneSignal;
+		std::list<Block*> m_BlocksToCompress;
+		std::list<Block*> m_BlocksInFlight;
+		bool m_bWorkersQuit;
+		unsigned long long m_nCompressedOffset;
 		
 	};
 
@@ -0,0 +1,174 @@
+/*
+ *  CodecBench.cpp
+ *  MOOS
+ *
+ *  Compares the compression codecs pLogger can use on a recorded alog:
+ *
+ *  pLoggerCodecBench file.alog [codec[:level] ...] [--block=KB]
+ *
+ *  with no codecs named every one built in is tried at a few levels. Each codec is run
+ *  as a stream (as the single threaded zipper does, in small writes with a flush every
+ *  batch) and a block at a time (as each worker of the block parallel zipper does).
+ */
+
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "LogCodec.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//the size of the writes the stream sees (a typical batch of entries from the mail thread)
+#define BENCH_WRITE_SIZE (16*1024)
+//the stream is flushed this often as the zipper does once per wake up
+#define BENCH_FLUSH_SIZE (1024*1024)
+
+
+namespace
+{
+	bool ReadFile(const std::string & sFileName, std::string & Contents)
+	{
+		std::ifstream In(sFileName.c_str(), std::ios::binary);
+		if(!In.is_open())
+			return false;
+
+		std::stringstream ss;
+		ss<<In.rdbuf();
+		Contents = ss.str();
+		return true;
+	}
+
+	long long FileSize(const std::string & sFileName)
+	{
+		std::ifstream In(sFileName.c_str(), std::ios::binary|std::ios::ate);
+		if(!In.is_open())
+			return -1;
+		return (long long)In.tellg();
+	}
+
+	/** compress as the stream zipper would, returns seconds taken or -1 */
+	double RunStream(CLogCodec & rCodec, const std::string & Input, const std::string & sOutFile, long long & nCompressed)
+	{
+		double dfStart = MOOSLocalTime();
+
+		if(!rCodec.Open(sOutFile))
+			return -1;
+
+		size_t nSinceFlush = 0;
+		for(size_t nDone = 0;nDone<Input.size();nDone+=BENCH_WRITE_SIZE)
+		{
+			size_t nBytes = Input.size()-nDone<BENCH_WRITE_SIZE ? Input.size()-nDone : BENCH_WRITE_SIZE;
+			if(!rCodec.Write(Input.data()+nDone, nBytes))
+				return -1;
+
+			nSinceFlush+=nBytes;
+			if(nSinceFlush>=BENCH_FLUSH_SIZE)
+			{
+				rCodec.Flush();
+				nSinceFlush = 0;
+			}
+		}
+
+		if(!rCodec.Close())
+			return -1;
+
+		double dfTaken = MOOSLocalTime()-dfStart;
+		nCompressed = FileSize(sOutFile);
+		remove(sOutFile.c_str());
+		return dfTaken;
+	}
+
+	/** compress independent blocks as each block worker would, returns seconds taken or -1 */
+	double RunBlocks(CLogCodec & rCodec, const std::string & Input, size_t nBlockSize, long long & nCompressed)
+	{
+		double dfStart = MOOSLocalTime();
+
+		nCompressed = 0;
+		std::string Block, Output;
+		for(size_t nDone = 0;nDone<Input.size();nDone+=nBlockSize)
+		{
+			Block.assign(Input, nDone, nBlockSize);
+			if(!rCodec.CompressBlock(Block, Output))
+				return -1;
+			nCompressed+=Output.size();
+		}
+
+		return MOOSLocalTime()-dfStart;
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	std::string sAlog;
+	std::vector<std::string> Codecs;
+	size_t nBlockSize = 1024*1024;
+	bool bHelp = false;
+
+	for(int i = 1;i<argc;i++)
+	{
+		std::string sArg = argv[i];
+		if(sArg.find("--block=")==0)
+			nBlockSize = (size_t)atoi(sArg.substr(8).c_str())*1024;
+		else if(sArg=="-h" || sArg=="--help")
+			bHelp = true;
+		else if(sAlog.empty())
+			sAlog = sArg;
+		else
+			Codecs.push_back(sArg);
+	}
+
+	if(bHelp || sAlog.empty() || nBlockSize==0)
+	{
+		std::cerr<<"usage: pLoggerCodecBench file.alog [codec[:level] ...] [--block=KB]\n";
+		std::cerr<<"codecs built in: "<<CLogCodec::GetAvailable()<<"\n";
+		return 1;
+	}
+
+	if(Codecs.empty())
+	{
+		const char * Defaults[] = {"gzip:1","gzip:6","zstd:1","zstd:3","zstd:9","lz4:0","lz4:9"};
+		for(size_t i = 0;i<sizeof(Defaults)/sizeof(Defaults[0]);i++)
+			Codecs.push_back(Defaults[i]);
+	}
+
+	std::string Input;
+	if(!ReadFile(sAlog, Input) || Input.empty())
+	{
+		std::cerr<<"cannot read "<<sAlog<<"\n";
+		return 1;
+	}
+
+	double dfMB = Input.size()/(1024.0*1024.0);
+	printf("%s: %.1f MB, blocks of %u KB\n\n", sAlog.c_str(), dfMB, (unsigned int)(nBlockSize/1024));
+	printf("%-10s %12s %8s %12s %8s\n", "codec", "stream MB/s", "ratio", "block MB/s", "ratio");
+
+	for(size_t i = 0;i<Codecs.size();i++)
+	{
+		CLogCodec * pCodec = CLogCodec::Create(Codecs[i]);
+		if(pCodec==NULL)
+		{
+			printf("%-10s not built in\n", Codecs[i].c_str());
+			continue;
+		}
+
+		long long nStream = 0, nBlocks = 0;
+		double dfStream = RunStream(*pCodec, Input, sAlog+".bench"+pCodec->GetExtension(), nStream);
+		double dfBlocks = RunBlocks(*pCodec, Input, nBlockSize, nBlocks);
+
+		if(dfStream<0 || dfBlocks<0 || nStream<=0 || nBlocks<=0)
+			printf("%-10s failed\n", Codecs[i].c_str());
+		else
+			printf("%-10s %12.1f %8.2f %12.1f %8.2f\n",
+				Codecs[i].c_str(),
+				dfMB/dfStream, (double)Input.size()/nStream,
+				dfMB/dfBlocks, (double)Input.size()/nBlocks);
+
+		delete pCodec;
+	}
+
+	return 0;
+}
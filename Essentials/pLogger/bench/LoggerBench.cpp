@@ -0,0 +1,400 @@
+/*
+ *  LoggerBench.cpp
+ *  MOOS
+ *
+ *  Measures the whole logger - mail handling, formatting, compression and writing -
+ *  without a MOOSDB:
+ *
+ *  pLoggerBench [directory] [--messages=N] [--batch=N] [--keys=N] [--mix=D,S,B]
+ *               [--string=bytes] [--binary=bytes] [--wildcard=pattern,...]
+ *               [--omit=pattern,...] [--set=Param=Value ...]
+ *
+ *  A mission file is written to the directory and a CMOOSLogger started from it. Batches
+ *  of synthetic mail - doubles, strings and binary data (in the percentages given by
+ *  --mix) spread over a number of keys - are handed straight to OnNewMail() and Iterate()
+ *  is called after each, as the application thread would. With --wildcard the keys are
+ *  admitted by wildcard logging, otherwise each is named by a Log line. Any other
+ *  configuration is passed with --set, so that formats and compression can be compared
+ *  by running once for each e.g
+ *
+ *  pLoggerBench /tmp --set=CompressAlogs=gzip
+ *  pLoggerBench /tmp --set=CompressAlogs=zstd:3 --set=CompressThreads=4
+ *  pLoggerBench /tmp --set=LogFormat=columnar
+ *
+ *  Messages and bytes per second are reported over the time from the first mail to the
+ *  files being closed (so including draining the writer threads) along with the time the
+ *  application thread spent in OnNewMail(), the CPU used by the process and the number of
+ *  allocations made.
+ */
+
+#include "MOOS/libMOOS/MOOSLib.h"
+#include "MOOSLogger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+//the name the logger runs under (and so its configuration block)
+#define BENCH_APP_NAME "pLoggerBench"
+//how many different sources the mail appears to come from
+#define BENCH_SOURCES 8
+
+
+//the replacement allocation functions must say what the standard library's do
+#if __cplusplus>=201103L
+	#define BENCH_THROWS_BAD_ALLOC
+	#define BENCH_THROWS_NOTHING noexcept
+#else
+	#define BENCH_THROWS_BAD_ALLOC throw(std::bad_alloc)
+	#define BENCH_THROWS_NOTHING throw()
+#endif
+
+
+//every allocation made by the process (any thread) is counted
+namespace
+{
+	volatile unsigned long long g_nAllocations = 0;
+	volatile unsigned long long g_nAllocatedBytes = 0;
+
+	void CountAllocation(size_t nBytes)
+	{
+#ifdef __GNUC__
+		__sync_fetch_and_add(&g_nAllocations,1ULL);
+		__sync_fetch_and_add(&g_nAllocatedBytes,(unsigned long long)nBytes);
+#else
+		g_nAllocations++;
+		g_nAllocatedBytes+=nBytes;
+#endif
+	}
+}
+
+void * operator new(size_t nBytes) BENCH_THROWS_BAD_ALLOC
+{
+	CountAllocation(nBytes);
+	void * p = malloc(nBytes ? nBytes : 1);
+	if(p==NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void * operator new[](size_t nBytes) BENCH_THROWS_BAD_ALLOC
+{
+	return operator new(nBytes);
+}
+
+void operator delete(void * p) BENCH_THROWS_NOTHING
+{
+	free(p);
+}
+
+void operator delete[](void * p) BENCH_THROWS_NOTHING
+{
+	free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void * p, size_t) BENCH_THROWS_NOTHING
+{
+	free(p);
+}
+
+void operator delete[](void * p, size_t) BENCH_THROWS_NOTHING
+{
+	free(p);
+}
+#endif
+
+
+namespace
+{
+	/** a logger we can start from a mission file and feed by hand */
+	class CBenchLogger : public CMOOSLogger
+	{
+	public:
+		bool Start(const std::string & sMissionFile)
+		{
+			m_sAppName = BENCH_APP_NAME;
+			m_sMissionFile = sMissionFile;
+			m_MissionReader.SetAppName(m_sAppName);
+			if(!m_MissionReader.SetFile(sMissionFile))
+				return false;
+			return OnStartUp();
+		}
+
+		CLoggerStats & GetStats()
+		{
+			return m_Stats;
+		}
+
+		std::string GetLogDirectory()
+		{
+			return m_sLogDirectoryName;
+		}
+	};
+
+	/** user plus system CPU seconds used by the process so far */
+	double GetCPUTime()
+	{
+#ifdef _WIN32
+		FILETIME Creation,Exit,Kernel,User;
+		if(!GetProcessTimes(GetCurrentProcess(),&Creation,&Exit,&Kernel,&User))
+			return 0;
+		ULARGE_INTEGER nKernel,nUser;
+		nKernel.LowPart = Kernel.dwLowDateTime;
+		nKernel.HighPart = Kernel.dwHighDateTime;
+		nUser.LowPart = User.dwLowDateTime;
+		nUser.HighPart = User.dwHighDateTime;
+		return (nKernel.QuadPart+nUser.QuadPart)*1e-7;
+#else
+		struct rusage Usage;
+		if(getrusage(RUSAGE_SELF,&Usage)!=0)
+			return 0;
+		return Usage.ru_utime.tv_sec+Usage.ru_utime.tv_usec*1e-6+
+			Usage.ru_stime.tv_sec+Usage.ru_stime.tv_usec*1e-6;
+#endif
+	}
+
+	/** the upper case name of a Param=Value setting */
+	std::string GetSettingName(std::string sSetting)
+	{
+		std::string sName = MOOSChomp(sSetting,"=");
+		MOOSTrimWhiteSpace(sName);
+		MOOSToUpper(sName);
+		return sName;
+	}
+
+	/** add a setting unless the user has given their own */
+	void AddDefault(std::vector<std::string> & Settings, const std::string & sSetting)
+	{
+		std::string sName = GetSettingName(sSetting);
+		for(size_t i = 0;i<Settings.size();i++)
+		{
+			if(GetSettingName(Settings[i])==sName)
+				return;
+		}
+		Settings.push_back(sSetting);
+	}
+
+	bool WriteMissionFile(const std::string & sFileName, const std::vector<std::string> & Settings)
+	{
+		std::ofstream Out(sFileName.c_str());
+		if(!Out.is_open())
+			return false;
+
+		Out<<"ServerHost = localhost\n";
+		Out<<"ServerPort = 9000\n";
+		Out<<"Community = bench\n\n";
+		Out<<"ProcessConfig = "<<BENCH_APP_NAME<<"\n{\n";
+		for(size_t i = 0;i<Settings.size();i++)
+			Out<<"\t"<<Settings[i]<<"\n";
+		Out<<"}\n";
+
+		return Out.good();
+	}
+
+	std::string GetKeyName(int nKey)
+	{
+		return MOOSFormat("BENCH_VAR_%04d",nKey);
+	}
+
+	/** what the key carries, as the --mix percentages share out the keys */
+	char GetKeyType(int nKey, int nKeys, int nDoublePercent, int nStringPercent)
+	{
+		int nPercent = nKey*100/nKeys;
+		if(nPercent<nDoublePercent)
+			return MOOS_DOUBLE;
+		if(nPercent<nDoublePercent+nStringPercent)
+			return MOOS_STRING;
+		return MOOS_BINARY_STRING;
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	std::string sDirectory = ".";
+	unsigned long long nMessages = 1000000;
+	int nBatch = 100;
+	int nKeys = 500;
+	int nMix[3] = {70,25,5};
+	size_t nStringSize = 32;
+	size_t nBinarySize = 1024;
+	std::string sWildCards;
+	std::string sOmit;
+	std::vector<std::string> Settings;
+	bool bDirectorySet = false;
+
+	for(int i = 1;i<argc;i++)
+	{
+		std::string sArg = argv[i];
+		if(sArg.find("--messages=")==0)
+			nMessages = strtoull(sArg.substr(11).c_str(),NULL,10);
+		else if(sArg.find("--batch=")==0)
+			nBatch = atoi(sArg.substr(8).c_str());
+		else if(sArg.find("--keys=")==0)
+			nKeys = atoi(sArg.substr(7).c_str());
+		else if(sArg.find("--mix=")==0)
+		{
+			std::string sMix = sArg.substr(6);
+			for(int j = 0;j<3;j++)
+				nMix[j] = atoi(MOOSChomp(sMix,",").c_str());
+		}
+		else if(sArg.find("--string=")==0)
+			nStringSize = (size_t)atoi(sArg.substr(9).c_str());
+		else if(sArg.find("--binary=")==0)
+			nBinarySize = (size_t)atoi(sArg.substr(9).c_str());
+		else if(sArg.find("--wildcard=")==0)
+			sWildCards = sArg.substr(11);
+		else if(sArg.find("--omit=")==0)
+			sOmit = sArg.substr(7);
+		else if(sArg.find("--set=")==0 && sArg.find('=',6)!=std::string::npos)
+			Settings.push_back(sArg.substr(6));
+		else if(!bDirectorySet && sArg[0]!='-')
+		{
+			sDirectory = sArg;
+			bDirectorySet = true;
+		}
+		else
+		{
+			std::cerr<<"usage: pLoggerBench [directory] [--messages=N] [--batch=N] [--keys=N] [--mix=D,S,B]\n"
+				<<"                    [--string=bytes] [--binary=bytes] [--wildcard=pattern,...]\n"
+				<<"                    [--omit=pattern,...] [--set=Param=Value ...]\n";
+			return 1;
+		}
+	}
+
+	if(nMessages==0 || nBatch<=0 || nKeys<=0 || nMix[0]<0 || nMix[1]<0 || nMix[2]<0 || nMix[0]+nMix[1]+nMix[2]!=100)
+	{
+		std::cerr<<"messages, batch and keys must be more than zero and the mix must add up to 100\n";
+		return 1;
+	}
+
+	//the user's settings come first, ours fill in what they haven't said
+	AddDefault(Settings,"Path = "+sDirectory);
+	AddDefault(Settings,"File = "+std::string(BENCH_APP_NAME));
+	AddDefault(Settings,"FileTimeStamp = false");
+	AddDefault(Settings,"AsyncLog = true");
+	AddDefault(Settings,"SyncLog = true @ 0.2");
+	AddDefault(Settings,"DynamicSyncLogColumns = 0");
+	if(!sWildCards.empty())
+	{
+		AddDefault(Settings,"WildcardLogging = true");
+		Settings.push_back("WildCardPattern = "+sWildCards);
+		if(!sOmit.empty())
+			Settings.push_back("WildCardOmitPattern = "+sOmit);
+	}
+	else
+	{
+		AddDefault(Settings,"WildcardLogging = false");
+		for(int k = 0;k<nKeys;k++)
+			Settings.push_back("Log = "+GetKeyName(k)+" @ 0");
+	}
+
+	std::string sMissionFile = sDirectory+"/"+BENCH_APP_NAME+".moos";
+	if(!WriteMissionFile(sMissionFile,Settings))
+	{
+		std::cerr<<"cannot write "<<sMissionFile<<"\n";
+		return 1;
+	}
+
+	CBenchLogger Logger;
+	if(!Logger.Start(sMissionFile))
+	{
+		std::cerr<<"the logger would not start from "<<sMissionFile<<"\n";
+		return 1;
+	}
+
+	//the mail is made once and restamped for each batch so we measure the logger not the generator
+	std::vector<CMOOSMsg> Templates;
+	unsigned long long nPayload = 0;
+	std::string sString(nStringSize,'s');
+	std::string sBinary(nBinarySize,'\0');
+	for(size_t j = 0;j<sBinary.size();j++)
+		sBinary[j] = (char)(j*131+7);
+
+	for(int k = 0;k<nKeys;k++)
+	{
+		char cType = GetKeyType(k,nKeys,nMix[0],nMix[1]);
+		CMOOSMsg Msg;
+		if(cType==MOOS_DOUBLE)
+			Msg = CMOOSMsg(MOOS_NOTIFY,GetKeyName(k),k*1.234567);
+		else
+		{
+			Msg = CMOOSMsg(MOOS_NOTIFY,GetKeyName(k),cType==MOOS_STRING ? sString : sBinary);
+			if(cType==MOOS_BINARY_STRING)
+				Msg.MarkAsBinary();
+		}
+		Msg.m_sSrc = MOOSFormat("pSource%d",k%BENCH_SOURCES);
+		Msg.m_sOriginatingCommunity = "bench";
+		Templates.push_back(Msg);
+	}
+
+	printf("%llu messages in batches of %d over %d keys (%d%% double, %d%% string of %u bytes, %d%% binary of %u bytes)\n",
+		nMessages,nBatch,nKeys,nMix[0],nMix[1],(unsigned int)nStringSize,nMix[2],(unsigned int)nBinarySize);
+	printf("logging to %s\n\n",Logger.GetLogDirectory().c_str());
+
+	unsigned long long nAllocationsBefore = g_nAllocations;
+	unsigned long long nAllocatedBefore = g_nAllocatedBytes;
+	double dfCPUBefore = GetCPUTime();
+	double dfStart = MOOSLocalTime();
+	double dfInMail = 0;
+
+	unsigned long long nSent = 0;
+	int nNextKey = 0;
+	while(nSent<nMessages)
+	{
+		MOOSMSG_LIST Mail;
+		double dfTimeNow = MOOSTime();
+		for(int j = 0;j<nBatch && nSent<nMessages;j++,nSent++)
+		{
+			Mail.push_back(Templates[nNextKey]);
+			Mail.back().m_dfTime = dfTimeNow;
+			nPayload+=Templates[nNextKey].m_sKey.size()+
+				(Templates[nNextKey].IsDouble() ? sizeof(double) : Templates[nNextKey].m_sVal.size());
+			nNextKey = (nNextKey+1)%nKeys;
+		}
+
+		double dfBefore = MOOSLocalTime();
+		Logger.OnNewMail(Mail);
+		dfInMail+=MOOSLocalTime()-dfBefore;
+
+		Logger.Iterate();
+	}
+
+	//closing waits for the writer threads so the time includes getting it all to disk
+	Logger.ShutDown();
+
+	double dfTaken = MOOSLocalTime()-dfStart;
+	double dfCPU = GetCPUTime()-dfCPUBefore;
+	unsigned long long nAllocations = g_nAllocations-nAllocationsBefore;
+	unsigned long long nAllocated = g_nAllocatedBytes-nAllocatedBefore;
+
+	printf("%-22s %12.0f msgs/s  %10.2f MB/s of payload\n","throughput",nSent/dfTaken,nPayload/(1024.0*1024.0)/dfTaken);
+	printf("%-22s %12.3f s       %10.2f us/msg\n","elapsed",dfTaken,dfTaken*1e6/nSent);
+	printf("%-22s %12.3f s       %10.2f us/msg\n","in OnNewMail",dfInMail,dfInMail*1e6/nSent);
+	printf("%-22s %12.3f s       %10.0f %% of one core\n","CPU (all threads)",dfCPU,100.0*dfCPU/dfTaken);
+	printf("%-22s %12llu         %10.2f per msg (%.0f bytes)\n","allocations",nAllocations,
+		(double)nAllocations/nSent,(double)nAllocated/nSent);
+
+	CLoggerStats & Stats = Logger.GetStats();
+	printf("\n%-8s %14s %14s\n","file","entries","MB");
+	for(int f = 0;f<CLoggerStats::NUM_FILES;f++)
+	{
+		CLoggerStats::File eFile = (CLoggerStats::File)f;
+		if(Stats.GetMessages(eFile)==0 && Stats.GetBytes(eFile)==0)
+			continue;
+		printf("%-8s %14llu %14.2f\n",CLoggerStats::GetFileName(eFile),
+			Stats.GetMessages(eFile),Stats.GetBytes(eFile)/(1024.0*1024.0));
+	}
+
+	return 0;
+}
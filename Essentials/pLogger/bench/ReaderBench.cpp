@@ -0,0 +1,141 @@
+/*
+ *  ReaderBench.cpp
+ *  MOOS
+ *
+ *  Measures how fast CAlogReader gets through an alog:
+ *
+ *  pLoggerReaderBench file.alog[.gz] [--var=NAME ...] [--from=s] [--to=s] [--noindex]
+ *
+ *  Every entry which passes the filters is read and its value touched (doubles parsed,
+ *  binary payloads fetched from the blog). Run it twice - the first run measures the disk,
+ *  the second (from the page cache) the parsing.
+ */
+
+#include "AlogReader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+#endif
+
+
+namespace
+{
+	double GetTimeNow()
+	{
+#ifdef _WIN32
+		return GetTickCount()/1000.0;
+#else
+		struct timeval Now;
+		gettimeofday(&Now, NULL);
+		return Now.tv_sec+Now.tv_usec*1e-6;
+#endif
+	}
+
+	unsigned long long GetFileSize(const std::string & sFileName)
+	{
+		struct stat Status;
+		if(stat(sFileName.c_str(), &Status)!=0)
+			return 0;
+		return (unsigned long long)Status.st_size;
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	std::string sFileName;
+	bool bUseIndex = true;
+	double dfFrom = 0;
+	double dfTo = -1;
+	bool bTimeFiltered = false;
+
+	CAlogReader Reader;
+	std::string sVariables;
+	for(int i = 1;i<argc;i++)
+	{
+		std::string sArg = argv[i];
+		if(sArg.find("--var=")==0)
+			sVariables+=(sVariables.empty() ? "" : ",")+sArg.substr(6);
+		else if(sArg.find("--from=")==0)
+		{
+			dfFrom = atof(sArg.substr(7).c_str());
+			bTimeFiltered = true;
+		}
+		else if(sArg.find("--to=")==0)
+		{
+			dfTo = atof(sArg.substr(5).c_str());
+			bTimeFiltered = true;
+		}
+		else if(sArg=="--noindex")
+			bUseIndex = false;
+		else if(sFileName.empty() && sArg[0]!='-')
+			sFileName = sArg;
+		else
+		{
+			std::cerr<<"usage: pLoggerReaderBench file.alog[.gz] [--var=NAME ...] [--from=s] [--to=s] [--noindex]\n";
+			return 1;
+		}
+	}
+
+	if(sFileName.empty())
+	{
+		std::cerr<<"usage: pLoggerReaderBench file.alog[.gz] [--var=NAME ...] [--from=s] [--to=s] [--noindex]\n";
+		return 1;
+	}
+
+	double dfStart = GetTimeNow();
+	if(!Reader.Open(sFileName, bUseIndex))
+		return 1;
+
+	while(!sVariables.empty())
+	{
+		size_t nComma = sVariables.find(',');
+		Reader.AddVariable(sVariables.substr(0, nComma));
+		sVariables = nComma==std::string::npos ? "" : sVariables.substr(nComma+1);
+	}
+	if(bTimeFiltered)
+		Reader.SetTimeRange(dfFrom, dfTo<0 ? 1e300 : dfTo);
+
+	unsigned long long nEntries[3] = {0,0,0};
+	unsigned long long nBinaryBytes = 0;
+	unsigned long long nMissingBinary = 0;
+	double dfSum = 0;
+	for(CAlogReader::iterator q = Reader.begin();q!=Reader.end();++q)
+	{
+		nEntries[q->eType]++;
+		if(q->eType==CAlogReader::DOUBLE)
+		{
+			dfSum+=q->GetDouble();
+		}
+		else if(q->eType==CAlogReader::BINARY)
+		{
+			CAlogReader::View Payload;
+			if(Reader.GetBinary(*q, Payload))
+				nBinaryBytes+=Payload.nSize;
+			else
+				nMissingBinary++;
+		}
+	}
+
+	double dfTaken = GetTimeNow()-dfStart;
+	unsigned long long nTotal = nEntries[0]+nEntries[1]+nEntries[2];
+	unsigned long long nFileSize = GetFileSize(sFileName);
+
+	printf("%s (%s index)\n\n", sFileName.c_str(), Reader.HasIndex() ? "with" : "no");
+	printf("%-16s %14llu (%llu double, %llu string, %llu binary)\n", "entries", nTotal, nEntries[0], nEntries[1], nEntries[2]);
+	printf("%-16s %14.3f s\n", "elapsed", dfTaken);
+	printf("%-16s %14.0f entries/s\n", "rate", dfTaken>0 ? nTotal/dfTaken : 0);
+	printf("%-16s %14.1f MB/s of file\n", "", dfTaken>0 ? nFileSize/(1024.0*1024.0)/dfTaken : 0);
+	printf("%-16s %14.2f MB%s\n", "binary payloads", nBinaryBytes/(1024.0*1024.0),
+		nMissingBinary>0 ? " (some not found in the blog)" : "");
+	printf("%-16s %14g\n", "sum of doubles", dfSum);
+
+	return 0;
+}
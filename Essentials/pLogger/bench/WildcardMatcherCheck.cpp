@@ -0,0 +1,135 @@
+/*
+ *  WildcardMatcherCheck.cpp
+ *  MOOS
+ *
+ *  Checks CWildcardMatcher against MOOSWildCmp (what the logger used to try, a pattern
+ *  at a time) on random pattern sets and names, and times the two:
+ *
+ *  pLoggerWildcardCheck [--sets=N] [--patterns=N] [--names=N] [--seed=N]
+ *
+ *  Patterns and names are drawn from a small alphabet so that prefixes are shared,
+ *  runs of '*' and '?' turn up and plenty of names match - the cases where a trie
+ *  and a glob matcher could disagree with the plain one. Any disagreement is printed
+ *  and the exit status is non zero.
+ */
+
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "WildcardMatcher.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	/** up to nMaxLength characters picked from sAlphabet */
+	std::string RandomString(const char * sAlphabet, int nMaxLength)
+	{
+		std::string sResult;
+		int nLength = rand()%(nMaxLength+1);
+		size_t nAlphabet = strlen(sAlphabet);
+		for(int i = 0;i<nLength;i++)
+			sResult+=sAlphabet[rand()%nAlphabet];
+		return sResult;
+	}
+
+	/** the old way - every pattern in turn */
+	bool AnyWildCmp(const std::vector<std::string> & Patterns, const std::string & sName)
+	{
+		for(size_t i = 0;i<Patterns.size();i++)
+		{
+			if(MOOSWildCmp(Patterns[i],sName))
+				return true;
+		}
+		return false;
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	int nSets = 2000;
+	int nPatterns = 8;
+	int nNames = 500;
+	unsigned int nSeed = 1;
+
+	for(int i = 1;i<argc;i++)
+	{
+		std::string sArg = argv[i];
+		if(sArg.find("--sets=")==0)
+			nSets = atoi(sArg.substr(7).c_str());
+		else if(sArg.find("--patterns=")==0)
+			nPatterns = atoi(sArg.substr(11).c_str());
+		else if(sArg.find("--names=")==0)
+			nNames = atoi(sArg.substr(8).c_str());
+		else if(sArg.find("--seed=")==0)
+			nSeed = (unsigned int)atoi(sArg.substr(7).c_str());
+		else
+		{
+			printf("usage: pLoggerWildcardCheck [--sets=N] [--patterns=N] [--names=N] [--seed=N]\n");
+			return 1;
+		}
+	}
+
+	srand(nSeed);
+
+	unsigned long long nChecked = 0;
+	unsigned long long nMatched = 0;
+	unsigned long long nWrong = 0;
+	double dfOld = 0;
+	double dfNew = 0;
+
+	for(int s = 0;s<nSets;s++)
+	{
+		std::vector<std::string> Patterns;
+		CWildcardMatcher Matcher;
+		int nCount = rand()%(nPatterns+1);
+		for(int i = 0;i<nCount;i++)
+		{
+			Patterns.push_back(RandomString("AB_*?",8));
+			Matcher.Add(Patterns.back());
+		}
+
+		std::vector<std::string> Names;
+		for(int i = 0;i<nNames;i++)
+			Names.push_back(RandomString("AB_C",10));
+
+		std::vector<char> Expected(Names.size());
+		double dfStart = MOOSLocalTime();
+		for(size_t i = 0;i<Names.size();i++)
+			Expected[i] = AnyWildCmp(Patterns,Names[i]);
+		dfOld+=MOOSLocalTime()-dfStart;
+
+		std::vector<char> Found(Names.size());
+		dfStart = MOOSLocalTime();
+		for(size_t i = 0;i<Names.size();i++)
+			Found[i] = Matcher.Matches(Names[i]);
+		dfNew+=MOOSLocalTime()-dfStart;
+
+		for(size_t i = 0;i<Names.size();i++)
+		{
+			nChecked++;
+			if(Expected[i])
+				nMatched++;
+			if(Expected[i]==Found[i])
+				continue;
+
+			//only show the first few - one is enough to go on
+			if(nWrong++<10)
+			{
+				printf("\"%s\" MOOSWildCmp %s, CWildcardMatcher %s - patterns:",
+					Names[i].c_str(), Expected[i] ? "matches" : "doesn't", Found[i] ? "matches" : "doesn't");
+				for(size_t j = 0;j<Patterns.size();j++)
+					printf(" \"%s\"",Patterns[j].c_str());
+				printf("\n");
+			}
+		}
+	}
+
+	printf("%llu names checked (%llu matched), %llu disagreements\n",nChecked,nMatched,nWrong);
+	printf("MOOSWildCmp %.3f s, CWildcardMatcher %.3f s\n",dfOld,dfNew);
+
+	return nWrong==0 ? 0 : 1;
+}
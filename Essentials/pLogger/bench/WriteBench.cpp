@@ -0,0 +1,167 @@
+/*
+ *  WriteBench.cpp
+ *  MOOS
+ *
+ *  Measures how long a log writer waits on each write for every CLogFile backend:
+ *
+ *  pLoggerWriteBench [directory] [--size=MB] [--batch=KB] [--rate=MB/s] [backend ...]
+ *
+ *  Each backend writes size MB of alog-like text in batches (as CLogWriter does, a
+ *  Write() and Flush() per batch) optionally paced to a given rate. The latency of every
+ *  batch is recorded and the median, tail and worst are reported - it is the tail
+ *  (stalls while the filesystem allocates or the page cache is written back) which
+ *  backs up a logger.
+ */
+
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "LogFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	/** a batch of plausible alog lines */
+	std::string MakeBatch(size_t nBytes)
+	{
+		std::string Batch;
+		int nLine = 0;
+		while(Batch.size()<nBytes)
+		{
+			char sLine[128];
+			snprintf(sLine, sizeof(sLine), "%-15.3f %-20s %-15s %-12.5f \n",
+				nLine*0.02, nLine%3 ? "NAV_X" : "DESIRED_HEADING", "pNav", nLine*1.234567);
+			Batch+=sLine;
+			nLine++;
+		}
+		Batch.resize(nBytes);
+		return Batch;
+	}
+
+	double Percentile(const std::vector<double> & Sorted, double dfFraction)
+	{
+		if(Sorted.empty())
+			return 0;
+		size_t nIndex = (size_t)(dfFraction*(Sorted.size()-1));
+		return Sorted[nIndex];
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	std::string sDirectory = ".";
+	std::vector<std::string> Backends;
+	unsigned long long nTotal = 1024ULL*1024*1024;
+	size_t nBatch = 64*1024;
+	double dfRate = 0;
+	bool bDirectorySet = false;
+
+	for(int i = 1;i<argc;i++)
+	{
+		std::string sArg = argv[i];
+		CLogFile::Mode eMode;
+		if(sArg.find("--size=")==0)
+			nTotal = (unsigned long long)atoi(sArg.substr(7).c_str())*1024*1024;
+		else if(sArg.find("--batch=")==0)
+			nBatch = (size_t)atoi(sArg.substr(8).c_str())*1024;
+		else if(sArg.find("--rate=")==0)
+			dfRate = atof(sArg.substr(7).c_str());
+		else if(CLogFile::ParseMode(sArg, eMode))
+			Backends.push_back(sArg);
+		else if(!bDirectorySet && sArg[0]!='-')
+		{
+			sDirectory = sArg;
+			bDirectorySet = true;
+		}
+		else
+		{
+			std::cerr<<"usage: pLoggerWriteBench [directory] [--size=MB] [--batch=KB] [--rate=MB/s] [buffered|preallocate|direct|mmap ...]\n";
+			return 1;
+		}
+	}
+
+	if(nBatch==0 || nTotal==0)
+	{
+		std::cerr<<"size and batch must be more than zero\n";
+		return 1;
+	}
+
+	if(Backends.empty())
+	{
+		Backends.push_back("buffered");
+		Backends.push_back("preallocate");
+		Backends.push_back("direct");
+		Backends.push_back("mmap");
+	}
+
+	std::string Batch = MakeBatch(nBatch);
+
+	printf("%llu MB in batches of %u KB%s\n\n", nTotal/(1024*1024), (unsigned int)(nBatch/1024),
+		dfRate>0 ? MOOSFormat(" at %.1f MB/s",dfRate).c_str() : "");
+	printf("%-12s %10s %10s %10s %10s %10s %10s\n", "backend", "MB/s", "p50 ms", "p99 ms", "p99.9 ms", "max ms", "close ms");
+
+	for(size_t i = 0;i<Backends.size();i++)
+	{
+		CLogFile::Mode eMode = CLogFile::BUFFERED;
+		CLogFile::ParseMode(Backends[i], eMode);
+
+		std::string sFile = sDirectory+"/pLoggerWriteBench.tmp";
+		CLogFile File;
+		if(!File.Open(sFile, eMode))
+		{
+			printf("%-12s cannot open %s\n", Backends[i].c_str(), sFile.c_str());
+			continue;
+		}
+
+		std::vector<double> Latencies;
+		Latencies.reserve((size_t)(nTotal/nBatch)+1);
+
+		double dfStart = MOOSLocalTime();
+		bool bOK = true;
+		for(unsigned long long nDone = 0;nDone<nTotal && bOK;nDone+=nBatch)
+		{
+			//pace the writes as a logger would see them
+			if(dfRate>0)
+			{
+				double dfDue = dfStart+nDone/(dfRate*1024*1024);
+				double dfWait = dfDue-MOOSLocalTime();
+				if(dfWait>0)
+					MOOSPause((int)(dfWait*1000));
+			}
+
+			double dfBefore = MOOSLocalTime();
+			bOK = File.Write(Batch.data(), Batch.size()) && File.Flush();
+			Latencies.push_back((MOOSLocalTime()-dfBefore)*1000.0);
+		}
+
+		double dfBeforeClose = MOOSLocalTime();
+		bOK = File.Close() && bOK;
+		double dfClose = (MOOSLocalTime()-dfBeforeClose)*1000.0;
+		double dfTaken = MOOSLocalTime()-dfStart;
+		remove(sFile.c_str());
+
+		if(!bOK)
+		{
+			printf("%-12s failed\n", Backends[i].c_str());
+			continue;
+		}
+
+		std::sort(Latencies.begin(), Latencies.end());
+		printf("%-12s %10.1f %10.3f %10.3f %10.3f %10.3f %10.3f%s\n",
+			Backends[i].c_str(),
+			nTotal/(1024.0*1024.0)/dfTaken,
+			Percentile(Latencies,0.5),
+			Percentile(Latencies,0.99),
+			Percentile(Latencies,0.999),
+			Latencies.back(),
+			dfClose,
+			File.GetMode()!=eMode ? MOOSFormat(" (ran as %s)",CLogFile::GetModeName(File.GetMode()).c_str()).c_str() : "");
+	}
+
+	return 0;
+}